@@ -2,56 +2,126 @@
 #define AUTONOMICFARM_BENCHMARK_HPP
 
 #include <thread>
+#include <optional>
 #include "FarmAnalytics.hpp"
 #include "utimer.hpp"
 #include "ProgramArgs.hpp"
+#include "loadgenerator.hpp"
+#include "kernels.hpp"
+#include "EventTracer.hpp"
+#include "BufferedFileSink.hpp"
+#include "AdmissionControl.hpp"
+#include "TaskPriority.hpp"
 
 /**
- * Simulate busy work by looping for msec time. The return value is needed by the farm itself since the worker has to
- * produce some new value
- * @param msec how many milliseconds this work will take doing nothing
- * @return the number of milliseconds of this work
- */
-size_t active_wait(size_t& msec) {
-    START(start_time);
-    long elapsed_ms = 0;
-    while(elapsed_ms < msec) {
-        auto now = std::chrono::system_clock::now();
-        elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time).count();
-    }
-    return msec;
-}
-
-/**
- * Run a benchmark of a given farm. Given the stream size, the service and arrival times, the given farm is run and
- * the stream is sent to the farm (according to the given arrival times). To simulate busy work, the work sent to the
- * farm will not compute anything useful, but instead will busy waiting for a given amount of milliseconds (according
- * to the given service times).
+ * Run a benchmark of a given farm. Given the schedule of the stream, the given farm is run and the stream is sent to
+ * the farm by an open-loop generator, which sends each item at its deadline. The work sent to the farm will not
+ * compute anything useful: each item is the nominal service time of a synthetic kernel (see kernel_function).
  * @tparam FarmType the type of farm to benchmark. It must support the wait_and_analytics() method
  * @param farm reference to the farm to benchmark
- * @param stream_size how many items the stream has
- * @param serviceTimes the service times of the stream (milliseconds)
- * @param arrivalTimes the arrival times of the stream (milliseconds)
+ * @param schedule the service times and the arrival deadlines of the stream
  * @return the result of the benchmark
  */
 template <typename FarmType>
-farm_analytics benchmark_farm(FarmType& farm, size_t stream_size,
-                              std::vector<size_t>& serviceTimes, const std::vector<size_t>& arrivalTimes) {
+farm_analytics benchmark_farm(FarmType& farm, const stream_schedule& schedule) {
+    std::vector<std::pair<long, long>> generator_lag;
     farm.run();
-    for (int stream_index = 0; stream_index < stream_size; ++stream_index) {
-        // given the index of the current stream item, compute its service time by applying the proportion
-        auto service_time_index = (serviceTimes.size() * stream_index) / stream_size;
-        // send this work to the farm
-        farm.send(serviceTimes[service_time_index]);
-
-        // given the index of the current stream item, compute its arrival time by applying the proportion
-        auto arrival_time_index = (arrivalTimes.size() * stream_index) / stream_size;
-        // wait some milliseconds before sending the next work
-        std::this_thread::sleep_for(std::chrono::milliseconds(arrivalTimes[arrival_time_index]));
-    }
+    START(generator_start_time);
+    open_loop_generator generator(schedule);
+    generator.run([&farm](size_t& service_time) { farm.send(service_time); }, generator_start_time, generator_lag);
     farm.notify_eos();
     // wait for the farm to end and return the benchmark results
-    return farm.wait_and_analytics();
+    auto analytics = farm.wait_and_analytics();
+    // the lag is timestamped from the start of the generator, the other measures from the start of the farm
+    auto generator_offset = ELAPSED(analytics.farm_start_time, generator_start_time, std::chrono::milliseconds);
+    for (auto &[lag, time]: generator_lag) time += generator_offset;
+    analytics.generator_lag = std::move(generator_lag);
+    return analytics;
+}
+
+/**
+ * Build the sink of the results: a file written by a writer thread if asked by the program arguments, otherwise a sink
+ * dropping them.
+ * @param args the program arguments
+ * @param sink set to the file sink, if any. It must outlive the farm
+ * @return the function to give to the farm as its sink
+ */
+std::function<void(size_t&)> make_output_sink(const program_args &args, std::unique_ptr<BufferedFileSink<size_t>> &sink) {
+    if (args.output_file.empty()) return [](size_t&) { };
+    sink = std::make_unique<BufferedFileSink<size_t>>(args.output_file, 1 << 20, args.output_direct);
+    return sink->sendOut();
+}
+
+/**
+ * Flush the results left in the file sink, if any, and add its statistics to the analytics.
+ * @param sink the file sink
+ * @param analytics the analytics of the farm
+ */
+void close_output_sink(std::unique_ptr<BufferedFileSink<size_t>> &sink, farm_analytics &analytics) {
+    if (!sink) return;
+    sink->close();
+    analytics.output_sink = sink->stats();
+}
+
+/**
+ * Build the admission control asked by the program arguments.
+ * @param args the program arguments
+ * @return the admission control, or an empty optional if the farm must never drop a task
+ */
+std::optional<AdmissionControl> make_admission_control(const program_args &args) {
+    if (args.shed == DEFAULT_SHED_POLICY && args.ttl_ms <= 0) return {};
+    AdmissionControl admission(parse_shed_policy(args.shed), args.max_queue);
+    admission.setDelayTarget(args.delay_target_ms);
+    admission.setTimeToLive(args.ttl_ms);
+    return admission;
+}
+
+/**
+ * The priority of the tasks of the benchmark: the tasks not longer than the threshold of the program arguments are
+ * interactive, class zero, the longer ones are bulk, class one.
+ * @param args the program arguments
+ * @return the function giving the priority of a task from its service time
+ */
+std::function<task_priority(const size_t&)> task_classifier(const program_args &args) {
+    auto threshold = args.priority_below;
+    return [threshold](const size_t &service_time) {
+        return task_priority{ service_time <= threshold ? 0u:1u };
+    };
+}
+
+/**
+ * The tenant of the tasks of the benchmark: the tasks are split among the tenants by the service time bounds of the
+ * program arguments, a task belonging to the tenant k if its service time is above k bounds.
+ * @param args the program arguments
+ * @return the function giving the tenant of a task from its service time
+ */
+std::function<uint32_t(const size_t&)> task_tenant(const program_args &args) {
+    auto bounds = args.tenant_bounds;
+    return [bounds](const size_t &service_time) {
+        return (uint32_t) (std::lower_bound(bounds.begin(), bounds.end(), service_time) - bounds.begin());
+    };
+}
+
+/**
+ * Start tracing the events of the farm, if asked by the program arguments. The trace is also written if the program is
+ * interrupted.
+ * @param args the program arguments
+ */
+void start_event_trace(const program_args &args) {
+    if (args.trace_events_file.empty()) return;
+    EventTracer::enable();
+    // the main thread sends the stream
+    EventTracer::nameThread("source");
+    EventTracer::dumpOnSignal(args.trace_events_file);
+}
+
+/**
+ * Write the events traced, if any, to the file given by the program arguments.
+ * @param args the program arguments
+ */
+void event_trace_to_file(const program_args &args) {
+    if (!EventTracer::enabled()) return;
+    if (!EventTracer::dump(args.trace_events_file)) std::cerr << "cannot write " << args.trace_events_file << std::endl;
 }
 
 /**
@@ -67,6 +137,22 @@ void analytics_to_csv(farm_analytics &analytics, program_args& args) {
     analytics.servicetime_to_file("csv", "service_time", args);
     analytics.servicetime_points_to_file("csv", "service_time_points", args);
     analytics.num_workers_to_file("csv", "num_workers", args);
+    if (!analytics.concurrency.empty()) analytics.concurrency_to_file("csv", "concurrency", args);
+    analytics.generator_lag_to_file("csv", "generator_lag", args);
+    if (args.forecast) analytics.arrival_forecast_to_file("csv", "arrival_forecast", args);
+    if (!analytics.scalability.empty()) analytics.scalability_to_file("csv", "scalability", args);
+    analytics.complete_controller_metrics(args.target_service_time);
+    analytics.controller_metrics_to_file("csv", "controller_metrics", args);
+    analytics.load_changes_to_file("csv", "load_changes", args);
+    if (args.calibration_tasks > 0) analytics.calibration_to_file("csv", "calibration", args);
+    if (args.inline_mode != DEFAULT_INLINE_MODE) analytics.inline_execution_to_file("csv", "inline_execution", args);
+    if (!analytics.workers.empty()) analytics.worker_stats_to_file("csv", "worker_stats", args);
+    if (!analytics.perf_counters.empty()) analytics.perf_counters_to_file("csv", "perf_counters", args);
+    if (!args.output_file.empty()) analytics.output_sink_to_file("csv", "output_sink", args);
+    if (analytics.spill.segments > 0) analytics.spill_to_file("csv", "spill", args);
+    if (args.shed != DEFAULT_SHED_POLICY || args.ttl_ms > 0) analytics.shedding_to_file("csv", "shedding", args);
+    if (!analytics.latency_by_class.empty()) analytics.class_latency_to_file("csv", "class_latency", args);
+    if (!analytics.tenants.empty()) analytics.tenants_to_file("csv", "tenants", args);
 }
 
 #endif //AUTONOMICFARM_BENCHMARK_HPP
@@ -2,14 +2,18 @@
 #define AUTONOMICFARM_FFBENCHMARKUTILS_HPP
 
 #include <thread>
+#include <deque>
 #include "FarmAnalytics.hpp"
 #include "utimer.hpp"
 #include "ProgramArgs.hpp"
+#include "loadgenerator.hpp"
+#include "MappedFileSource.hpp"
 #include "ff/node.hpp"
 
 class FFBenchmarkSource : public ff::ff_node {
 public:
-    explicit FFBenchmarkSource(program_args &args, farm_analytics *analytics) : args(args), analytics(analytics) {}
+    explicit FFBenchmarkSource(program_args &args, farm_analytics *analytics)
+        : generator(stream_schedule::build(args)), analytics(analytics) {}
 
     void * svc(void *) override;
 
@@ -18,27 +22,46 @@ public:
     }
 
 private:
-    program_args args;
+    // the generator owns the service times sent to the farm, so it lives as long as the source node
+    open_loop_generator generator;
     farm_analytics *analytics;
 };
 
 void *FFBenchmarkSource::svc(void *) {
-    for (int stream_index = 0; stream_index < args.stream_size; ++stream_index) {
-        // given the index of the current stream item, compute its service time by applying the proportion
-        auto service_time_index = (args.serviceTimes.size() * stream_index) / args.stream_size;
+    generator.run([this](size_t& service_time) {
         // send this work to the farm
-        this->ff_send_out(&args.serviceTimes[service_time_index]);
+        this->ff_send_out(&service_time);
         // track at which time a new item arrived
         STOP(analytics->farm_start_time, time, std::chrono::milliseconds);
         analytics->arrival_time.emplace_back(time);
+    }, analytics->farm_start_time, analytics->generator_lag);
+    return this->EOS;
+}
+
+/**
+ * A FastFlow source node sending the chunks of records of mapped files, as MappedFileSource does for the farms.
+ */
+class FFMappedFileSource : public ff::ff_node {
+public:
+    FFMappedFileSource(MappedFileSource &source, farm_analytics *analytics) : source(source), analytics(analytics) {}
 
-        // given the index of the current stream item, compute its arrival time by applying the proportion
-        auto arrival_time_index = (args.arrivalTimes.size() * stream_index) / args.stream_size;
-        // wait some milliseconds before sending the next work
-        std::this_thread::sleep_for(std::chrono::milliseconds(args.arrivalTimes[arrival_time_index]));
+    void * svc(void *) override;
+
+private:
+    MappedFileSource &source;
+    // the chunks sent, which only point into the mapping, live as long as the source node
+    std::deque<file_chunk> chunks;
+    farm_analytics *analytics;
+};
+
+void *FFMappedFileSource::svc(void *) {
+    while (auto chunk = source.next()) {
+        chunks.push_back(*chunk);
+        this->ff_send_out(&chunks.back());
+        STOP(analytics->farm_start_time, time, std::chrono::milliseconds);
+        analytics->arrival_time.emplace_back(time);
     }
     return this->EOS;
 }
 
-
 #endif //AUTONOMICFARM_FFBENCHMARKUTILS_HPP
@@ -0,0 +1,272 @@
+#ifndef AUTONOMICFARM_KERNELS_HPP
+#define AUTONOMICFARM_KERNELS_HPP
+
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <numeric>
+#include <functional>
+#include <stdexcept>
+#include <memory>
+#include "utimer.hpp"
+#include "ProgramArgs.hpp"
+#include "AsyncScheduler.hpp"
+
+/**
+ * Synthetic kernels used as the work of a benchmark task. Unlike active_wait, which spins for a given time and therefore
+ * scales perfectly, each kernel executes a fixed amount of work. The amount is calibrated at startup so that, on an idle
+ * machine, a task of N milliseconds takes about N milliseconds. When many workers contend for the memory bandwidth, the
+ * caches or the allocator, the same task takes longer, exposing the diminishing returns of adding workers.
+ */
+class synthetic_kernel {
+public:
+    /**
+     * Build the kernel with the given name.
+     * @param name one of compute, stream, chase, alloc or mixed
+     * @param working_set_kb size of the memory touched by each worker (kilobytes). Zero picks the kernel default
+     */
+    synthetic_kernel(const std::string &name, size_t working_set_kb);
+
+    /**
+     * Measure how many units of work are executed in a millisecond by a single thread.
+     */
+    void calibrate();
+
+    /**
+     * Execute the work of a task that would take the given milliseconds on an idle machine.
+     * @param msec the nominal service time of the task
+     * @return the nominal service time of the task
+     */
+    size_t run(size_t msec) const;
+
+private:
+    enum class kernel_type { compute, stream, chase, alloc, mixed };
+
+    kernel_type type;
+    size_t working_set_bytes;
+    double units_per_ms = 1;
+
+    void run_units(size_t units) const;
+
+    static void compute_unit();
+    void stream_unit() const;
+    void chase_unit() const;
+    static void alloc_unit();
+};
+
+synthetic_kernel::synthetic_kernel(const std::string &name, size_t working_set_kb) {
+    size_t default_kb;
+    if (name == "compute") {
+        type = kernel_type::compute;
+        default_kb = 0;
+    } else if (name == "stream") {
+        // a few workers together exceed the last level cache of common machines, so that the passes go to memory
+        // without every worker holding a buffer that large on its own
+        type = kernel_type::stream;
+        default_kb = 8 * 1024;
+    } else if (name == "chase") {
+        // fits in the private L2 cache of common machines
+        type = kernel_type::chase;
+        default_kb = 256;
+    } else if (name == "alloc") {
+        type = kernel_type::alloc;
+        default_kb = 0;
+    } else if (name == "mixed") {
+        type = kernel_type::mixed;
+        default_kb = 8 * 1024;
+    } else {
+        throw std::invalid_argument("unknown kernel: " + name);
+    }
+    working_set_bytes = (working_set_kb == 0 ? default_kb:working_set_kb) * 1024;
+}
+
+void synthetic_kernel::calibrate() {
+    // warm up the thread local buffers of every kernel used, then double the work until it takes long enough to be measured
+    run_units(4);
+    size_t units = 1;
+    long elapsed_us = 0;
+    while (elapsed_us < 20000) {
+        units *= 2;
+        START(start_time);
+        run_units(units);
+        STOP(start_time, elapsed, std::chrono::microseconds);
+        elapsed_us = elapsed;
+    }
+    // the first measurements may include page faults, keep the fastest of a few repetitions
+    for (int repetition = 0; repetition < 3; ++repetition) {
+        START(start_time);
+        run_units(units);
+        STOP(start_time, elapsed, std::chrono::microseconds);
+        elapsed_us = std::min(elapsed_us, (long) elapsed);
+    }
+    units_per_ms = (double) units * 1000.0 / (double) elapsed_us;
+}
+
+size_t synthetic_kernel::run(size_t msec) const {
+    run_units((size_t) std::max(1.0, (double) msec * units_per_ms));
+    return msec;
+}
+
+void synthetic_kernel::run_units(size_t units) const {
+    for (size_t unit = 0; unit < units; ++unit) {
+        switch (type) {
+            case kernel_type::compute: compute_unit(); break;
+            case kernel_type::stream: stream_unit(); break;
+            case kernel_type::chase: chase_unit(); break;
+            case kernel_type::alloc: alloc_unit(); break;
+            case kernel_type::mixed:
+                // round-robin between the other kernels
+                switch (unit % 4) {
+                    case 0: compute_unit(); break;
+                    case 1: stream_unit(); break;
+                    case 2: chase_unit(); break;
+                    default: alloc_unit(); break;
+                }
+                break;
+        }
+    }
+}
+
+void synthetic_kernel::compute_unit() {
+    // independent multiply-add chains on registers, so that the unit is bound by the arithmetic units only
+    double acc[16];
+    for (int i = 0; i < 16; ++i) acc[i] = 1.0 + i;
+    for (int iteration = 0; iteration < 256; ++iteration) {
+        for (double &value: acc) value = value * 0.999999 + 0.000001;
+    }
+    double sum = std::accumulate(acc, acc + 16, 0.0);
+    asm volatile("" : : "g"(sum) : "memory");
+}
+
+void synthetic_kernel::stream_unit() const {
+    // triad over a 64KB slice of a per-thread buffer. Each call moves to the next slice, so the whole buffer is swept
+    thread_local std::vector<double> a, b, c;
+    thread_local size_t offset = 0;
+    size_t elements = std::max<size_t>(working_set_bytes / (3 * sizeof(double)), 8192);
+    if (a.size() != elements) {
+        a.assign(elements, 1.0);
+        b.assign(elements, 2.0);
+        c.assign(elements, 0.0);
+        offset = 0;
+    }
+    const size_t slice = 8192;
+    if (offset + slice > elements) offset = 0;
+    for (size_t i = offset; i < offset + slice; ++i) {
+        c[i] = a[i] + 0.5 * b[i];
+    }
+    offset += slice;
+    asm volatile("" : : "g"(c.data()) : "memory");
+}
+
+void synthetic_kernel::chase_unit() const {
+    // follow a random cyclic permutation, so every load depends on the previous one and prefetching is useless
+    thread_local std::vector<size_t> next;
+    thread_local size_t position = 0;
+    size_t elements = std::max<size_t>(working_set_bytes / sizeof(size_t), 64);
+    if (next.size() != elements) {
+        std::vector<size_t> order(elements);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin() + 1, order.end(), std::mt19937_64(elements));
+        next.assign(elements, 0);
+        for (size_t i = 0; i < elements; ++i) {
+            next[order[i]] = order[(i + 1) % elements];
+        }
+        position = 0;
+    }
+    for (int step = 0; step < 1024; ++step) {
+        position = next[position];
+    }
+    asm volatile("" : : "g"(position) : "memory");
+}
+
+void synthetic_kernel::alloc_unit() {
+    // allocate and touch blocks of different size, then free them in a different order
+    thread_local std::mt19937 rng(7);
+    std::unique_ptr<char[]> blocks[32];
+    for (auto &block: blocks) {
+        size_t size = 16 + rng() % 4096;
+        block.reset(new char[size]);
+        block[0] = block[size - 1] = 1;
+    }
+    for (int i = 0; i < 32; i += 2) blocks[i].reset();
+    asm volatile("" : : "g"(blocks[1].get()) : "memory");
+}
+
+/**
+ * Simulate busy work by looping for msec time. The return value is needed by the farm itself since the worker has to
+ * produce some new value
+ * @param msec how many milliseconds this work will take doing nothing
+ * @return the number of milliseconds of this work
+ */
+size_t active_wait(size_t& msec) {
+    START(start_time);
+    long elapsed_ms = 0;
+    while(elapsed_ms < msec) {
+        auto now = std::chrono::system_clock::now();
+        elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time).count();
+    }
+    return msec;
+}
+
+/**
+ * Simulate a task waiting for I/O, such as a read from disk or an IPC: it computes for a quarter of msec and blocks the
+ * thread for the rest.
+ * @param msec the nominal service time of the task
+ * @return the number of milliseconds of this work
+ */
+size_t io_wait(size_t& msec) {
+    size_t compute_ms = msec / 4;
+    active_wait(compute_ms);
+    std::this_thread::sleep_for(std::chrono::milliseconds(msec - compute_ms));
+    return msec;
+}
+
+/**
+ * The asynchronous version of io_wait: the task is suspended while it waits, so its worker computes other tasks.
+ * @param msec the nominal service time of the task
+ * @return the number of milliseconds of this work
+ */
+async_task<size_t> async_io_wait(size_t msec) {
+    size_t compute_ms = msec / 4;
+    active_wait(compute_ms);
+    co_await sleep_for(std::chrono::milliseconds(msec - compute_ms));
+    co_return msec;
+}
+
+/**
+ * Run a synchronous kernel as a task that never suspends.
+ */
+async_task<size_t> async_kernel(std::function<size_t(size_t&)> kernel, size_t msec) {
+    co_return kernel(msec);
+}
+
+/**
+ * Build the work function selected by the program arguments. The spin kernel is active_wait, the io kernel is io_wait,
+ * any other kernel is calibrated before being returned.
+ * @param args the program arguments
+ * @return the function computing a task given its nominal service time
+ */
+std::function<size_t(size_t&)> kernel_function(const program_args &args) {
+    if (args.kernel == "spin") return &active_wait;
+    if (args.kernel == "io") return &io_wait;
+
+    auto kernel = std::make_shared<synthetic_kernel>(args.kernel, args.kernel_size_kb);
+    std::cout << "Calibrating " << args.kernel << " kernel..." << std::flush;
+    kernel->calibrate();
+    std::cout << "DONE!" << std::endl;
+    return [kernel](size_t& msec) { return kernel->run(msec); };
+}
+
+/**
+ * Build the work function selected by the program arguments as a coroutine, for the asynchronous workers. Only the io
+ * kernel suspends, the others run as kernel_function does.
+ * @param args the program arguments
+ * @return the coroutine computing a task given its nominal service time
+ */
+std::function<async_task<size_t>(size_t)> async_kernel_function(const program_args &args) {
+    if (args.kernel == "io") return &async_io_wait;
+    auto kernel = kernel_function(args);
+    return [kernel](size_t msec) { return async_kernel(kernel, msec); };
+}
+
+#endif //AUTONOMICFARM_KERNELS_HPP
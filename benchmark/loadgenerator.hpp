@@ -0,0 +1,149 @@
+#ifndef AUTONOMICFARM_LOADGENERATOR_HPP
+#define AUTONOMICFARM_LOADGENERATOR_HPP
+
+#include <random>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <cerrno>
+#include <stdexcept>
+#include "utimer.hpp"
+#include "ProgramArgs.hpp"
+
+/**
+ * The precomputed schedule of a stream: for each item, its service time and the point in time, relative to the
+ * beginning of the stream, when it has to be sent. The schedule is computed before the stream starts, so that drawing
+ * random numbers never delays the sending of an item.
+ */
+struct stream_schedule {
+    // service time of each item of the stream (milliseconds)
+    std::vector<size_t> service_times;
+    // absolute offset of each item from the beginning of the stream
+    std::vector<std::chrono::nanoseconds> arrival_offsets;
+
+    /**
+     * Build the schedule from the program arguments. The values given with --service and --arrival are the mean
+     * values of the distributions, applied by following the same proportions used by the fixed distribution.
+     * @param args the program arguments
+     * @return the schedule of the stream
+     */
+    static stream_schedule build(const program_args &args);
+
+private:
+    static double next_interarrival(const program_args &args, std::mt19937_64 &rng, double mean, double elapsed_ms, bool &bursty);
+    static double next_service_time(const program_args &args, std::mt19937_64 &rng, double mean);
+};
+
+stream_schedule stream_schedule::build(const program_args &args) {
+    stream_schedule schedule;
+    schedule.service_times.reserve(args.stream_size);
+    schedule.arrival_offsets.reserve(args.stream_size);
+
+    // use two independent generators, so that changing one distribution doesn't change the values of the other one
+    std::mt19937_64 arrival_rng(args.seed);
+    std::mt19937_64 service_rng(args.seed + 1);
+    bool bursty = false;
+    double elapsed_ms = 0;
+    for (size_t stream_index = 0; stream_index < args.stream_size; ++stream_index) {
+        // given the index of the current stream item, compute its mean values by applying the proportion
+        auto service_time_index = (args.serviceTimes.size() * stream_index) / args.stream_size;
+        auto arrival_time_index = (args.arrivalTimes.size() * stream_index) / args.stream_size;
+
+        auto service_time = next_service_time(args, service_rng, (double) args.serviceTimes[service_time_index]);
+        schedule.service_times.push_back((size_t) std::llround(service_time));
+        schedule.arrival_offsets.emplace_back((long long) std::llround(elapsed_ms * 1e6));
+        // the arrival time is the time waited after sending this item and before sending the next one
+        elapsed_ms += next_interarrival(args, arrival_rng, (double) args.arrivalTimes[arrival_time_index], elapsed_ms, bursty);
+    }
+    return schedule;
+}
+
+double stream_schedule::next_interarrival(const program_args &args, std::mt19937_64 &rng, double mean,
+                                          double elapsed_ms, bool &bursty) {
+    if (mean <= 0) return 0;
+    if (args.arrival_distribution == "fixed") return mean;
+    if (args.arrival_distribution == "poisson") {
+        return std::exponential_distribution<double>(1.0 / mean)(rng);
+    }
+    if (args.arrival_distribution == "mmpp") {
+        // two states Markov modulated Poisson process. Every arrival the state is kept with probability 0.95, so each
+        // state lasts 20 arrivals on average. Half of the arrivals are in each state, hence the mean is preserved.
+        if (std::bernoulli_distribution(0.05)(rng)) bursty = !bursty;
+        double bursty_mean = 2 * mean / (1 + args.burst_factor);
+        double state_mean = bursty ? bursty_mean:bursty_mean * args.burst_factor;
+        return std::exponential_distribution<double>(1.0 / state_mean)(rng);
+    }
+    if (args.arrival_distribution == "diurnal") {
+        // Poisson arrivals whose rate oscillates by 50% around the mean rate
+        double rate = (1.0 / mean) * (1 + 0.5 * std::sin(2 * M_PI * elapsed_ms / args.period_ms));
+        return std::exponential_distribution<double>(rate)(rng);
+    }
+    throw std::invalid_argument("unknown arrival distribution: " + args.arrival_distribution);
+}
+
+double stream_schedule::next_service_time(const program_args &args, std::mt19937_64 &rng, double mean) {
+    if (mean <= 0) return 0;
+    if (args.service_distribution == "fixed") return mean;
+    if (args.service_distribution == "pareto") {
+        double alpha = args.shape > 1 ? args.shape:2.5;
+        // scale chosen to have the requested mean
+        double scale = mean * (alpha - 1) / alpha;
+        double uniform = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return scale / std::pow(1 - uniform, 1 / alpha);
+    }
+    if (args.service_distribution == "lognormal") {
+        double sigma = args.shape > 0 ? args.shape:0.5;
+        double mu = std::log(mean) - sigma * sigma / 2;
+        return std::lognormal_distribution<double>(mu, sigma)(rng);
+    }
+    throw std::invalid_argument("unknown service distribution: " + args.service_distribution);
+}
+
+/**
+ * Open-loop generator of a stream. Each item is sent at its absolute deadline, computed from the beginning of the
+ * stream, so the time spent by sending an item is never added to the following inter-arrival gaps. The lag between the
+ * deadline and the time the item was really sent is tracked into the analytics.
+ */
+class open_loop_generator {
+public:
+    explicit open_loop_generator(const stream_schedule &schedule) : schedule(schedule) {}
+
+    /**
+     * Send all the items of the schedule. The function blocks until the last item was sent.
+     * @tparam SendFunType function called to send an item. It receives a reference to the item's service time
+     * @param send the function called to send an item
+     * @param start_time the point in time used to timestamp the lag measurements
+     * @param lag where to save the generator lag, as pairs <lag in microseconds, timestamp in milliseconds>
+     */
+    template<typename SendFunType>
+    void run(const SendFunType &send, std::chrono::system_clock::time_point start_time, std::vector<std::pair<long, long>> &lag);
+
+private:
+    stream_schedule schedule;
+};
+
+template<typename SendFunType>
+void open_loop_generator::run(const SendFunType &send, std::chrono::system_clock::time_point start_time,
+                              std::vector<std::pair<long, long>> &lag) {
+    lag.reserve(lag.size() + schedule.service_times.size());
+    timespec start{};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long long start_ns = (long long) start.tv_sec * 1000000000LL + start.tv_nsec;
+    for (size_t stream_index = 0; stream_index < schedule.service_times.size(); ++stream_index) {
+        long long deadline_ns = start_ns + schedule.arrival_offsets[stream_index].count();
+        timespec deadline{ (time_t) (deadline_ns / 1000000000LL), (long) (deadline_ns % 1000000000LL) };
+        // sleep until the absolute deadline, restarting if interrupted by a signal
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR);
+
+        timespec now{};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long lag_ns = (long long) now.tv_sec * 1000000000LL + now.tv_nsec - deadline_ns;
+        send(schedule.service_times[stream_index]);
+        STOP(start_time, time, std::chrono::milliseconds);
+        lag.emplace_back(lag_ns / 1000, time);
+    }
+}
+
+#endif //AUTONOMICFARM_LOADGENERATOR_HPP
@@ -11,16 +11,34 @@ int main(int argc, char *argv[]) {
         return 0;
     }
     std::cout << args << std::endl;
+    start_event_trace(args);
 
+    auto workerfun = kernel_function(args);
     std::cout << "Running autonomic farm..." << std::flush;
     START(farm_start_time);
+    std::unique_ptr<BufferedFileSink<size_t>> output_sink;
     AutonomicFarm<size_t, size_t> autonomicFarm(args.num_workers, args.min_num_workers, args.max_num_workers,
-                                                args.target_service_time, &active_wait, [](auto& ignored) { });
-    auto farm_analytics = benchmark_farm(autonomicFarm, args.stream_size, args.serviceTimes, args.arrivalTimes);
+                                                args.target_service_time, workerfun, make_output_sink(args, output_sink));
+    autonomicFarm.autonomic().setForecasting(args.forecast);
+    if (!args.state_file.empty()) autonomicFarm.autonomic().setStateFile(args.state_file);
+    autonomicFarm.autonomic().setCalibration(args.calibration_tasks);
+    autonomicFarm.setInlineExecution(args.inline_mode != DEFAULT_INLINE_MODE, args.inline_mode == "sink");
+    if (args.async_concurrency > 0) autonomicFarm.setAsyncWorker(async_kernel_function(args), args.async_concurrency);
+    if (args.perf_window_ms > 0) autonomicFarm.setPerfCounters((long) args.perf_window_ms);
+    if (args.spill_threshold > 0) autonomicFarm.setSpill(args.spill_threshold, args.spill_dir);
+    if (auto admission = make_admission_control(args)) autonomicFarm.setAdmission(*admission);
+    if (args.priority_below > 0) {
+        autonomicFarm.setPriorities(task_classifier(args), args.aging_ms);
+        autonomicFarm.autonomic().setPriorityTarget(args.priority_target);
+    }
+    if (!args.tenant_bounds.empty()) autonomicFarm.setTenants(task_tenant(args), args.tenant_weights, args.tenant_caps);
+    auto farm_analytics = benchmark_farm(autonomicFarm, stream_schedule::build(args));
+    close_output_sink(output_sink, farm_analytics);
     STOP(farm_start_time, farm_elapsed, std::chrono::milliseconds);
     std::cout << "took " << farm_elapsed << "msec" << std::endl;
 
     analytics_to_csv(farm_analytics, args);
+    event_trace_to_file(args);
 
     return 0;
 }
\ No newline at end of file
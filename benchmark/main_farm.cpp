@@ -14,17 +14,25 @@ int main(int argc, char *argv[]) {
         return 0;
     }
     std::cout << args << std::endl;
+    start_event_trace(args);
 
+    auto workerfun = kernel_function(args);
     std::cout << "Running farm..." << std::flush;
     START(farm_start_time);
 
-    MonitoredFarm<size_t, size_t> farm(args.num_workers, &active_wait, [](auto& ignored) { });
-    auto farm_analytics = benchmark_farm(farm, args.stream_size, args.serviceTimes, args.arrivalTimes);
+    std::unique_ptr<BufferedFileSink<size_t>> output_sink;
+    MonitoredFarm<size_t, size_t> farm(args.num_workers, workerfun, make_output_sink(args, output_sink));
+    farm.setInlineExecution(args.inline_mode != DEFAULT_INLINE_MODE, args.inline_mode == "sink");
+    farm.setDispatchPolicy(parse_dispatch_policy(args.dispatch), args.dispatch_depth);
+    if (args.perf_window_ms > 0) farm.setPerfCounters((long) args.perf_window_ms);
+    auto farm_analytics = benchmark_farm(farm, stream_schedule::build(args));
+    close_output_sink(output_sink, farm_analytics);
 
     STOP(farm_start_time, farm_elapsed, std::chrono::milliseconds);
     std::cout << "took " << farm_elapsed << "msec" << std::endl;
 
     analytics_to_csv(farm_analytics, args);
+    event_trace_to_file(args);
 
     return 0;
 }
\ No newline at end of file
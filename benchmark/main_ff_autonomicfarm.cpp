@@ -14,9 +14,11 @@ int main(int argc, char *argv[]) {
         return 0;
     }
     std::cout << args << std::endl;
+    start_event_trace(args);
 
-    auto workerfun = [](auto *val) {
-        active_wait(*val);
+    auto kernel = kernel_function(args);
+    auto workerfun = [&kernel](auto *val) {
+        kernel(*val);
         return val;
     };
 
@@ -27,6 +29,16 @@ int main(int argc, char *argv[]) {
     FFAutonomicFarm<size_t, size_t> ff_autonomicFarm(args.num_workers, args.min_num_workers, args.max_num_workers,
         args.target_service_time, workerfun, [](auto* ignored) { }, &analytics);
 
+    ff_autonomicFarm.autonomic().setForecasting(args.forecast);
+    if (!args.state_file.empty()) ff_autonomicFarm.autonomic().setStateFile(args.state_file);
+    ff_autonomicFarm.autonomic().setCalibration(args.calibration_tasks);
+    if (args.perf_window_ms > 0) ff_autonomicFarm.setPerfCounters((long) args.perf_window_ms);
+    if (auto admission = make_admission_control(args)) ff_autonomicFarm.setAdmission(*admission);
+    if (args.priority_below > 0) {
+        ff_autonomicFarm.setPriorities(task_classifier(args), args.aging_ms);
+        ff_autonomicFarm.autonomic().setPriorityTarget(args.priority_target);
+    }
+    if (!args.tenant_bounds.empty()) ff_autonomicFarm.setTenants(task_tenant(args), args.tenant_weights, args.tenant_caps);
     ff_autonomicFarm.run(sourceOfStream);
     ff_autonomicFarm.wait();
 
@@ -34,6 +46,7 @@ int main(int argc, char *argv[]) {
     std::cout << "took " << farm_elapsed << "msec" << std::endl;
 
     analytics_to_csv(analytics, args);
+    event_trace_to_file(args);
 
 
     return 0;
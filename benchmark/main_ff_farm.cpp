@@ -13,9 +13,11 @@ int main(int argc, char *argv[]) {
         return 0;
     }
     std::cout << args << std::endl;
+    start_event_trace(args);
 
-    auto workerfun = [](auto *val) {
-        active_wait(*val);
+    auto kernel = kernel_function(args);
+    auto workerfun = [&kernel](auto *val) {
+        kernel(*val);
         return val;
     };
 
@@ -25,6 +27,7 @@ int main(int argc, char *argv[]) {
     FFBenchmarkSource sourceOfStream(args, &analytics);
     FFMonitoringFarm<size_t, size_t> ff_farm(args.num_workers, workerfun, [](auto* ignored) {}, &analytics);
 
+    if (args.perf_window_ms > 0) ff_farm.setPerfCounters((long) args.perf_window_ms);
     ff_farm.run(sourceOfStream);
     ff_farm.wait();
 
@@ -32,6 +35,7 @@ int main(int argc, char *argv[]) {
     std::cout << "took " << farm_elapsed << "msec" << std::endl;
 
     analytics_to_csv(analytics, args);
+    event_trace_to_file(args);
 
     return 0;
 }
\ No newline at end of file
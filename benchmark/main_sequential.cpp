@@ -11,12 +11,13 @@ int main(int argc, char *argv[]) {
     }
     std::cout << args << std::endl;
 
+    auto schedule = stream_schedule::build(args);
+    auto workerfun = kernel_function(args);
     // Run sequential program
     std::cout << "Running sequential solution..." << std::flush;
     START(seq_start_time);
-    for (int stream_index = 0; stream_index < args.stream_size; ++stream_index) {
-        auto service_time_index = (args.serviceTimes.size() * stream_index) / args.stream_size;
-        active_wait(args.serviceTimes[service_time_index]);
+    for (auto &service_time: schedule.service_times) {
+        workerfun(service_time);
     }
     STOP(seq_start_time, seq_elapsed, std::chrono::milliseconds);
     std::cout << "took " << seq_elapsed << "msec" << std::endl;
@@ -0,0 +1,43 @@
+#include <iostream>
+#include "ProgramArgs.hpp"
+#include "utimer.hpp"
+#include "benchmark.hpp"
+#include "simulation/FarmSimulator.hpp"
+
+int main(int argc, char *argv[]) {
+    program_args args = program_args::build(argc, argv);
+    if (args.help) {
+        program_args::usage(std::cout, argv);
+        std::cout << std::endl;
+        return 0;
+    }
+    std::cout << args << std::endl;
+
+    std::vector<trace_item> trace;
+    if (args.trace_file.empty()) {
+        // simulate the same stream that would be sent to a real farm
+        auto schedule = stream_schedule::build(args);
+        for (size_t i = 0; i < schedule.service_times.size(); ++i) {
+            trace.push_back({ schedule.arrival_offsets[i], (double) schedule.service_times[i] });
+        }
+    } else {
+        trace = load_trace(args.trace_file);
+    }
+
+    std::cout << "Simulating autonomic farm..." << std::flush;
+    START(simulation_start_time);
+    FarmSimulator<> simulator(args.num_workers, args.min_num_workers, args.max_num_workers, args.target_service_time);
+    simulator.configure([&args](Autonomic &policy) {
+        policy.setForecasting(args.forecast);
+        if (!args.state_file.empty()) policy.setStateFile(args.state_file);
+        policy.setCalibration(args.calibration_tasks);
+    });
+    auto farm_analytics = simulator.run(trace);
+    STOP(simulation_start_time, simulation_elapsed, std::chrono::milliseconds);
+    auto simulated_elapsed = farm_analytics.throughput_points.empty() ? 0:(long) farm_analytics.throughput_points.back().second;
+    std::cout << "took " << simulation_elapsed << "msec (simulated " << simulated_elapsed << "msec)" << std::endl;
+
+    analytics_to_csv(farm_analytics, args);
+
+    return 0;
+}
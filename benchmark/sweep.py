@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+"""
+Parameter sweep of the farm executables.
+
+Every scenario of the grid (backend x initial workers x target x stream shape) is run the given number of times. Each
+run is executed into its own temporary directory, so the csv files it writes can be read back without guessing their
+timestamp. The summary metrics of all the runs are written to a single csv file, which can be stored and later passed
+with --baseline to flag the scenarios that got worse.
+
+Example:
+    python3 benchmark/sweep.py --backends farm autonomicfarm --workers 2 4 --targets 0 4 --repetitions 3 \\
+        --out sweep.csv --baseline sweep-baseline.csv
+"""
+
+import argparse
+import bisect
+import csv
+import glob
+import itertools
+import json
+import math
+import os
+import re
+import statistics
+import subprocess
+import sys
+import tempfile
+
+# maximum service time error, the same used by the autonomic controller to decide if the target is met
+MAX_SERVICE_TIME_ERROR = 1.0
+
+# metrics and whether a higher value is better
+METRICS = {
+    "completion_ms": False,
+    "speedup": True,
+    "efficiency": True,
+    "mean_service_time": False,
+    "p99_service_time": False,
+    "worker_seconds": False,
+    "reconfigurations": False,
+    "time_in_target_band": True,
+}
+
+SCENARIO_KEYS = ["backend", "workers", "min_workers", "max_workers", "target", "stream"]
+
+DEFAULT_STREAMS = [
+    {"name": "steady", "args": ["--stream", "300", "--service", "8", "--arrival", "5"]},
+    {"name": "ramp", "args": ["--stream", "500", "--service", "16", "24", "--arrival", "8", "4", "8"]},
+]
+
+
+def read_csv(directory, basename):
+    files = glob.glob(os.path.join(directory, "csv", basename + "-*.csv"))
+    if not files:
+        return []
+    with open(files[0], newline="") as file:
+        return list(csv.DictReader(file))
+
+
+def run_executable(executable, args):
+    with tempfile.TemporaryDirectory(prefix="sweep-") as directory:
+        completed = subprocess.run([executable] + args, cwd=directory, capture_output=True, text=True, check=True)
+        took = re.search(r"took (\d+)msec", completed.stdout)
+        if took is None:
+            raise RuntimeError(f"cannot find the completion time in the output of {executable}")
+        tables = {name: read_csv(directory, name) for name in ["num_workers", "service_time", "service_time_points",
+                                                                "arrival_time"]}
+        return int(took.group(1)), tables
+
+
+def percentile(values, fraction):
+    if not values:
+        return math.nan
+    ordered = sorted(values)
+    index = min(len(ordered) - 1, max(0, math.ceil(fraction * len(ordered)) - 1))
+    return ordered[index]
+
+
+def worker_intervals(num_workers, completion_ms):
+    """Pairs of <number of workers, duration in ms> of the worker count history, up to the completion time."""
+    changes = [(int(row["num_workers"]), int(row["time"])) for row in num_workers]
+    intervals = []
+    for index, (workers, time) in enumerate(changes):
+        end = changes[index + 1][1] if index + 1 < len(changes) else completion_ms
+        intervals.append((workers, max(0, end - time)))
+    return intervals
+
+
+def local_arrival_time(arrivals, time, window=10):
+    """Mean inter-arrival time of the <window> arrivals preceding the given time."""
+    index = bisect.bisect_right(arrivals, time)
+    begin = max(0, index - window)
+    if index - begin < 2:
+        return math.nan
+    return (arrivals[index - 1] - arrivals[begin]) / (index - 1 - begin)
+
+
+def time_in_target_band(service_time, arrivals, target):
+    if len(service_time) < 2:
+        return math.nan
+    inside = total = 0.0
+    for current, following in zip(service_time, service_time[1:]):
+        time = float(current["time"])
+        duration = float(following["time"]) - time
+        row_target = target if target > 0 else local_arrival_time(arrivals, time)
+        if math.isnan(row_target):
+            continue
+        total += duration
+        if abs(float(current["servicetime"]) - row_target) < MAX_SERVICE_TIME_ERROR:
+            inside += duration
+    return inside / total if total > 0 else math.nan
+
+
+def reconfigurations(num_workers):
+    """Changes of the number of workers, not counting the rows that repeat the previous number."""
+    counts = [int(row["num_workers"]) for row in num_workers]
+    return sum(1 for previous, current in zip(counts, counts[1:]) if current != previous)
+
+
+def metrics_of(completion_ms, tables, sequential_ms, target):
+    intervals = worker_intervals(tables["num_workers"], completion_ms)
+    worker_ms = sum(workers * duration for workers, duration in intervals)
+    elapsed = sum(duration for _, duration in intervals)
+    average_workers = worker_ms / elapsed if elapsed > 0 else math.nan
+    speedup = sequential_ms / completion_ms if completion_ms > 0 else math.nan
+    service_times = [float(row["servicetime"]) for row in tables["service_time_points"]]
+    arrivals = [int(row["time"]) for row in tables["arrival_time"]]
+    return {
+        "completion_ms": completion_ms,
+        "speedup": speedup,
+        "efficiency": speedup / average_workers if average_workers > 0 else math.nan,
+        "mean_service_time": statistics.fmean(service_times) if service_times else math.nan,
+        "p99_service_time": percentile(service_times, 0.99),
+        "worker_seconds": worker_ms / 1000,
+        "reconfigurations": reconfigurations(tables["num_workers"]),
+        "time_in_target_band": time_in_target_band(tables["service_time"], arrivals, target),
+    }
+
+
+def load_grid(args):
+    grid = {
+        "backends": args.backends,
+        "workers": args.workers,
+        "min_workers": args.min_workers,
+        "max_workers": args.max_workers,
+        "targets": args.targets,
+        "streams": DEFAULT_STREAMS,
+        "repetitions": args.repetitions,
+    }
+    if args.grid:
+        with open(args.grid) as file:
+            grid.update(json.load(file))
+    return grid
+
+
+def sweep(grid, exe_dir):
+    results = []
+    sequential = {}
+    for stream in grid["streams"]:
+        times = [run_executable(os.path.join(exe_dir, "sequential"), stream["args"])[0]
+                 for _ in range(grid["repetitions"])]
+        sequential[stream["name"]] = statistics.median(times)
+        print(f"sequential {stream['name']}: {sequential[stream['name']]}ms", file=sys.stderr)
+
+    scenarios = itertools.product(grid["backends"], grid["workers"], grid["min_workers"], grid["max_workers"],
+                                  grid["targets"], grid["streams"])
+    for backend, workers, min_workers, max_workers, target, stream in scenarios:
+        if min_workers > max_workers or not (min_workers <= workers <= max_workers):
+            continue
+        args = ["-w", str(workers), "-minw", str(min_workers), "-maxw", str(max_workers),
+                "--target", str(target)] + stream["args"]
+        for repetition in range(grid["repetitions"]):
+            completion_ms, tables = run_executable(os.path.join(exe_dir, backend), args)
+            row = {"backend": backend, "workers": workers, "min_workers": min_workers, "max_workers": max_workers,
+                   "target": target, "stream": stream["name"], "repetition": repetition}
+            row.update(metrics_of(completion_ms, tables, sequential[stream["name"]], float(target)))
+            print(", ".join(f"{key}={value}" for key, value in row.items()), file=sys.stderr)
+            results.append(row)
+    return results
+
+
+def write_results(path, results):
+    with open(path, "w", newline="") as file:
+        writer = csv.DictWriter(file, fieldnames=SCENARIO_KEYS + ["repetition"] + list(METRICS))
+        writer.writeheader()
+        writer.writerows(results)
+
+
+def mean_by_scenario(rows):
+    groups = {}
+    for row in rows:
+        key = tuple(str(row[name]) for name in SCENARIO_KEYS)
+        groups.setdefault(key, []).append(row)
+    means = {}
+    for key, group in groups.items():
+        means[key] = {}
+        for metric in METRICS:
+            values = [float(row[metric]) for row in group if row[metric] not in ("", "nan")]
+            values = [value for value in values if not math.isnan(value)]
+            means[key][metric] = statistics.fmean(values) if values else math.nan
+    return means
+
+
+def compare(results, baseline_path, threshold):
+    with open(baseline_path, newline="") as file:
+        baseline = mean_by_scenario(list(csv.DictReader(file)))
+    current = mean_by_scenario(results)
+    regressions = 0
+    for key, metrics in current.items():
+        if key not in baseline:
+            continue
+        for metric, higher_is_better in METRICS.items():
+            old, new = baseline[key][metric], metrics[metric]
+            if math.isnan(old) or math.isnan(new) or old == 0:
+                continue
+            change = (new - old) / abs(old) * 100
+            if (change < -threshold) if higher_is_better else (change > threshold):
+                regressions += 1
+                print(f"REGRESSION {dict(zip(SCENARIO_KEYS, key))} {metric}: {old:.3f} -> {new:.3f} "
+                      f"({change:+.1f}%)")
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run a grid of farm benchmarks and summarize the results")
+    parser.add_argument("--exe-dir", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "exe"))
+    parser.add_argument("--grid", help="json file overriding the grid dimensions (backends, workers, min_workers, "
+                                       "max_workers, targets, streams, repetitions)")
+    parser.add_argument("--backends", nargs="+", default=["farm", "autonomicfarm", "fffarm", "ffautonomicfarm"])
+    parser.add_argument("--workers", nargs="+", type=int, default=[4])
+    parser.add_argument("--min-workers", nargs="+", type=int, default=[1])
+    parser.add_argument("--max-workers", nargs="+", type=int, default=[8])
+    parser.add_argument("--targets", nargs="+", type=float, default=[0])
+    parser.add_argument("--repetitions", type=int, default=3)
+    parser.add_argument("--out", default="sweep.csv", help="consolidated results file")
+    parser.add_argument("--baseline", help="results file of a previous sweep to compare with")
+    parser.add_argument("--threshold", type=float, default=10, help="percentage change flagged as a regression")
+    args = parser.parse_args()
+
+    results = sweep(load_grid(args), args.exe_dir)
+    write_results(args.out, results)
+    print(f"Written {len(results)} runs to {args.out}")
+    if args.baseline:
+        regressions = compare(results, args.baseline, args.threshold)
+        print(f"{regressions} regressions against {args.baseline}")
+        sys.exit(1 if regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
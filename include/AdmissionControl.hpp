@@ -0,0 +1,207 @@
+#ifndef AUTONOMICFARM_ADMISSIONCONTROL_HPP
+#define AUTONOMICFARM_ADMISSIONCONTROL_HPP
+
+#include <chrono>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+/**
+ * What a farm does with the tasks arriving when its queue is too long.
+ */
+enum class shed_policy {
+    // every task is queued, however long the queue
+    none,
+    // a task arriving at a full queue is dropped
+    drop_newest,
+    // a task arriving at a full queue is queued, and the oldest waiting one is dropped
+    drop_oldest,
+    // a task is dropped with a probability growing with the queue delay, once it stayed above a target for a while
+    early_drop
+};
+
+/**
+ * Parse a shed policy from its name: none, newest, oldest or early.
+ * @param name the name of the policy
+ * @return the shed policy
+ */
+shed_policy parse_shed_policy(const std::string &name) {
+    if (name == "none") return shed_policy::none;
+    if (name == "newest") return shed_policy::drop_newest;
+    if (name == "oldest") return shed_policy::drop_oldest;
+    if (name == "early") return shed_policy::early_drop;
+    throw std::invalid_argument("unknown shed policy: " + name);
+}
+
+/**
+ * Why a task was dropped instead of being computed.
+ */
+enum class shed_reason {
+    // it arrived at a full queue
+    newest,
+    // it was the oldest in a full queue when another one arrived
+    oldest,
+    // it arrived while the queue delay was above the target
+    early,
+    // its deadline passed while it was waiting
+    expired
+};
+
+/**
+ * How many tasks a farm admitted and dropped, and why.
+ */
+struct shed_stats {
+    size_t admitted = 0; // tasks queued
+    size_t dropped_newest = 0; // tasks dropped on arrival at a full queue
+    size_t dropped_oldest = 0; // queued tasks dropped to make room for a newer one
+    size_t dropped_early = 0; // tasks dropped on arrival because of the queue delay
+    size_t expired = 0; // queued tasks dropped before being computed because their deadline passed
+
+    /**
+     * @return the tasks dropped, for any reason
+     */
+    size_t total() const {
+        return dropped_newest + dropped_oldest + dropped_early + expired;
+    }
+
+    void count(shed_reason reason) {
+        switch (reason) {
+            case shed_reason::newest: dropped_newest++; break;
+            case shed_reason::oldest: dropped_oldest++; break;
+            case shed_reason::early: dropped_early++; break;
+            case shed_reason::expired: expired++; break;
+        }
+    }
+};
+
+/**
+ * The admission control at the entry of a farm, which drops tasks when the farm cannot keep up instead of letting the
+ * latency of every task grow with the queue. It decides on each arrival, given the length of the queue and its delay,
+ * and tells whether a waiting task expired before it is computed. Every task gets a deadline, its arrival plus the
+ * time to live, whatever the policy. It is not thread safe: the queue calls it holding its own lock.
+ */
+class AdmissionControl {
+public:
+    /**
+     * @param policy what to do with the tasks arriving when the queue is too long
+     * @param max_queue the length of a full queue, for the drop-newest and drop-oldest policies
+     */
+    explicit AdmissionControl(shed_policy policy = shed_policy::none, size_t max_queue = 0)
+    : policy(policy), max_queue(std::max<size_t>(1, max_queue)) {}
+
+    /**
+     * Set the queue delay of the early drop: once the delay stayed above the target for an interval, the tasks are
+     * dropped with probability 1 - target / delay, which brings the arrivals back to the rate the farm sustains.
+     * @param target_ms the target queue delay (milliseconds)
+     * @param interval_ms how long the delay must stay above the target before dropping (milliseconds)
+     */
+    void setDelayTarget(double target_ms, double interval_ms = 100);
+
+    /**
+     * Set how long a task may wait before being computed: a task whose deadline passed is dropped when taken.
+     * @param ttl_ms the time to live of the tasks (milliseconds), zero for no deadline
+     */
+    void setTimeToLive(double ttl_ms) {
+        ttl = to_duration(ttl_ms);
+    }
+
+    /**
+     * @return true if the tasks have a deadline
+     */
+    bool expires() const {
+        return ttl.count() > 0;
+    }
+
+    /**
+     * Decide about an arriving task.
+     * @param queue_length the number of tasks waiting
+     * @param now the point in time of the arrival
+     * @return empty to queue the task, newest or early to drop it, oldest to queue it and drop the oldest waiting one
+     */
+    std::optional<shed_reason> onArrival(size_t queue_length, std::chrono::steady_clock::time_point now);
+
+    /**
+     * Measure the delay of the queue from a task about to be computed.
+     * @param added the point in time when the task was queued
+     * @param now the point in time when the task is taken
+     */
+    void onDeparture(std::chrono::steady_clock::time_point added, std::chrono::steady_clock::time_point now);
+
+    /**
+     * @param added the point in time when the task was queued
+     * @param now the point in time when the task is taken
+     * @return true if the deadline of the task passed
+     */
+    bool expired(std::chrono::steady_clock::time_point added, std::chrono::steady_clock::time_point now) const {
+        return expires() && now - added > ttl;
+    }
+
+    /**
+     * Count a task dropped.
+     * @param reason why it was dropped
+     */
+    void onShed(shed_reason reason) {
+        statistics.count(reason);
+    }
+
+    const shed_stats& stats() const {
+        return statistics;
+    }
+
+private:
+    shed_policy policy;
+    size_t max_queue;
+    std::chrono::steady_clock::duration target = to_duration(5);
+    std::chrono::steady_clock::duration interval = to_duration(100);
+    std::chrono::steady_clock::duration ttl{0};
+    // delay of the latest task taken, and since when the delay is above the target, if it is
+    std::chrono::steady_clock::duration queue_delay{0};
+    std::optional<std::chrono::steady_clock::time_point> above_since;
+    std::minstd_rand random{ 42 };
+    std::uniform_real_distribution<double> uniform{ 0, 1 };
+    shed_stats statistics;
+
+    static std::chrono::steady_clock::duration to_duration(double ms) {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(ms));
+    }
+};
+
+void AdmissionControl::setDelayTarget(double target_ms, double interval_ms) {
+    target = to_duration(target_ms);
+    interval = to_duration(interval_ms);
+}
+
+std::optional<shed_reason> AdmissionControl::onArrival(size_t queue_length, std::chrono::steady_clock::time_point now) {
+    switch (policy) {
+        case shed_policy::none:
+            break;
+        case shed_policy::drop_newest:
+            if (queue_length >= max_queue) return shed_reason::newest;
+            break;
+        case shed_policy::drop_oldest:
+            if (queue_length >= max_queue) {
+                statistics.admitted++;
+                return shed_reason::oldest;
+            }
+            break;
+        case shed_policy::early_drop:
+            // an empty queue has no delay, whatever the latest task waited
+            if (queue_length > 0 && above_since && now - *above_since >= interval) {
+                double drop_probability = 1 - (double) target.count() / (double) queue_delay.count();
+                if (uniform(random) < drop_probability) return shed_reason::early;
+            }
+            break;
+    }
+    statistics.admitted++;
+    return {};
+}
+
+void AdmissionControl::onDeparture(std::chrono::steady_clock::time_point added, std::chrono::steady_clock::time_point now) {
+    queue_delay = now - added;
+    if (queue_delay <= target) above_since.reset();
+    else if (!above_since) above_since = now;
+}
+
+#endif //AUTONOMICFARM_ADMISSIONCONTROL_HPP
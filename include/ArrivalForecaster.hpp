@@ -0,0 +1,76 @@
+#ifndef AUTONOMICFARM_ARRIVALFORECASTER_HPP
+#define AUTONOMICFARM_ARRIVALFORECASTER_HPP
+
+#include <cmath>
+#include <algorithm>
+
+/**
+ * Forecasts the arrival rate by applying Holt's linear trend method (double exponential smoothing) to a series of rate
+ * observations. Observations may be taken at irregular intervals, hence the trend is kept per millisecond and the
+ * smoothing is weighted by the time elapsed between two observations.
+ */
+class ArrivalForecaster {
+public:
+    /**
+     * @param level_smoothing weight of the newest observation on the level (alpha)
+     * @param trend_smoothing weight of the newest observation on the trend (beta)
+     */
+    explicit ArrivalForecaster(double level_smoothing = 0.5, double trend_smoothing = 0.3)
+    : alpha(level_smoothing), beta(trend_smoothing) {}
+
+    /**
+     * Add a new observation of the arrival rate.
+     * @param rate the arrival rate observed (tasks per millisecond)
+     * @param elapsed_ms time elapsed from the previous observation (milliseconds)
+     * @return the rate that was forecast for this observation, before knowing it. Negative for the first observation
+     */
+    double observe(double rate, double elapsed_ms);
+
+    /**
+     * Forecast the arrival rate after the given time from the last observation.
+     * @param horizon_ms how far in the future (milliseconds)
+     * @return the forecast arrival rate (tasks per millisecond), never negative
+     */
+    [[nodiscard]] double forecast(double horizon_ms) const {
+        return std::max(0.0, level + trend * horizon_ms);
+    }
+
+    /**
+     * @return the trend of the arrival rate (tasks per millisecond, per millisecond)
+     */
+    [[nodiscard]] double getTrend() const {
+        return trend;
+    }
+
+    /**
+     * @return true if at least two observations were given, hence both level and trend are meaningful
+     */
+    [[nodiscard]] bool isReady() const {
+        return observations >= 2;
+    }
+
+private:
+    double alpha;
+    double beta;
+    double level = 0.0;
+    double trend = 0.0;
+    size_t observations = 0;
+};
+
+double ArrivalForecaster::observe(double rate, double elapsed_ms) {
+    observations++;
+    if (observations == 1) {
+        level = rate;
+        return -1;
+    }
+
+    double predicted = forecast(elapsed_ms);
+    double previous_level = level;
+    level = alpha * rate + (1 - alpha) * (level + trend * elapsed_ms);
+    if (elapsed_ms > 0) {
+        trend = beta * (level - previous_level) / elapsed_ms + (1 - beta) * trend;
+    }
+    return predicted;
+}
+
+#endif //AUTONOMICFARM_ARRIVALFORECASTER_HPP
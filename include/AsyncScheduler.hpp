@@ -0,0 +1,411 @@
+#ifndef AUTONOMICFARM_ASYNCSCHEDULER_HPP
+#define AUTONOMICFARM_ASYNCSCHEDULER_HPP
+
+#include <coroutine>
+#include <chrono>
+#include <deque>
+#include <queue>
+#include <vector>
+#include <optional>
+#include <exception>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <thread>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <cerrno>
+#include <iostream>
+#include <unordered_set>
+
+class AsyncScheduler;
+
+/**
+ * The part of the promise of a task that doesn't depend on its result.
+ */
+struct async_promise_base {
+    // coroutine awaiting this task, resumed when it completes
+    std::coroutine_handle<> continuation;
+    // scheduler to notify when this task completes, if spawned as a top-level task
+    AsyncScheduler* scheduler = nullptr;
+    std::exception_ptr exception;
+
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename PromiseType>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> handle) noexcept;
+        void await_resume() noexcept {}
+    };
+
+    // a task runs only once awaited or spawned
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    final_awaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct async_result {
+    std::optional<T> value;
+    void return_value(T result) { value = std::move(result); }
+    T get() { return std::move(*value); }
+};
+
+template <>
+struct async_result<void> {
+    void return_void() {}
+    void get() {}
+};
+
+/**
+ * A coroutine computing a value of the given type, lazily: it starts when it is awaited by another coroutine, or when
+ * it is spawned on a scheduler. A task can await timers and file descriptors (see sleep_for, readable and writable),
+ * suspending until they are ready while its worker computes other tasks.
+ * @tparam T the type of the result
+ */
+template <typename T = void>
+class async_task {
+public:
+    struct promise_type : async_promise_base, async_result<T> {
+        async_task get_return_object() {
+            return async_task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    async_task(async_task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    async_task(const async_task&) = delete;
+    async_task& operator=(const async_task&) = delete;
+
+    ~async_task() {
+        if (handle) handle.destroy();
+    }
+
+    bool await_ready() const noexcept {
+        return handle.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        if (handle.promise().exception) std::rethrow_exception(handle.promise().exception);
+        return handle.promise().get();
+    }
+
+    /**
+     * Give up the ownership of the coroutine.
+     * @return the handle of the coroutine, to be destroyed by the new owner
+     */
+    std::coroutine_handle<promise_type> release() {
+        return std::exchange(handle, nullptr);
+    }
+
+private:
+    explicit async_task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * Runs many tasks on a single thread. A task runs until it awaits a timer or a file descriptor, then the scheduler
+ * runs the other tasks ready and waits with epoll for the file descriptors or the earliest timer. The scheduler must
+ * be created, used and destroyed by the same thread, which is the one its tasks run on.
+ */
+class AsyncScheduler {
+public:
+    AsyncScheduler();
+    ~AsyncScheduler();
+
+    AsyncScheduler(const AsyncScheduler&) = delete;
+    AsyncScheduler& operator=(const AsyncScheduler&) = delete;
+
+    /**
+     * Start a top-level task. It is destroyed by the scheduler once completed, or along with the scheduler if still
+     * suspended. An exception escaping it is logged and counted, see failed().
+     * @param task the task to start
+     */
+    void spawn(async_task<> task);
+
+    /**
+     * Run the tasks ready, then wait for a timer or a file descriptor to be ready and run the tasks awaiting it.
+     * @param max_wait the longest time to wait when no task is ready, negative to wait until a task is ready
+     * @return the number of top-level tasks completed since the last call
+     */
+    size_t poll(std::chrono::microseconds max_wait);
+
+    /**
+     * @return the number of top-level tasks spawned and not completed yet
+     */
+    [[nodiscard]] size_t inFlight() const {
+        return in_flight;
+    }
+
+    /**
+     * @return the number of top-level tasks that ended with an exception
+     */
+    [[nodiscard]] size_t failed() const {
+        return failures;
+    }
+
+    /**
+     * @return the time spent running the tasks (nanoseconds)
+     */
+    [[nodiscard]] long busyTime() const {
+        return busy_ns;
+    }
+
+    /**
+     * @return the time the tasks spent waiting for their timers and file descriptors to be ready, summed over the
+     * tasks (nanoseconds)
+     */
+    [[nodiscard]] long blockedTime() const {
+        return blocked_ns;
+    }
+
+    /**
+     * @return the scheduler of the calling thread, or nullptr if the thread has none
+     */
+    static AsyncScheduler* current() {
+        return current_scheduler;
+    }
+
+    /**
+     * Run a task on a scheduler of the calling thread until it completes.
+     * @param task the task to run
+     * @return the result of the task
+     */
+    template <typename T>
+    static T run(async_task<T> task);
+
+    // awaitable of a point in time
+    struct timer_awaiter {
+        std::chrono::steady_clock::time_point deadline;
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<> handle) const;
+        void await_resume() const {}
+    };
+
+    // awaitable of a file descriptor, giving the epoll events that made it ready
+    struct fd_awaiter {
+        int fd;
+        uint32_t events;
+        uint32_t ready_events = 0;
+        std::coroutine_handle<> handle;
+        std::chrono::steady_clock::time_point suspended;
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle);
+        uint32_t await_resume() const { return ready_events; }
+    };
+
+private:
+    friend struct async_promise_base;
+
+    // pairs <deadline, coroutine>, the earliest first
+    using timer = std::pair<std::chrono::steady_clock::time_point, std::coroutine_handle<>>;
+
+    int epoll_fd;
+    // scheduler of the thread before this one was created
+    AsyncScheduler* previous;
+    std::deque<std::coroutine_handle<>> ready;
+    std::priority_queue<timer, std::vector<timer>, std::greater<>> timers;
+    // file descriptors awaited
+    size_t waiting_fds = 0;
+    size_t in_flight = 0;
+    size_t completed = 0;
+    size_t failures = 0;
+    // frames of the top-level tasks spawned and not completed yet, destroyed with the scheduler
+    std::unordered_set<void*> spawned;
+    long busy_ns = 0;
+    long blocked_ns = 0;
+
+    inline static thread_local AsyncScheduler* current_scheduler = nullptr;
+
+    void onCompleted(std::coroutine_handle<> handle, const std::exception_ptr &exception);
+
+    template <typename T>
+    static async_task<> complete(async_task<T> &task, async_result<T> &result, std::exception_ptr &exception);
+};
+
+/**
+ * Suspend the calling task for the given time.
+ * @param duration the time to wait
+ * @return the awaitable of the timer
+ */
+template <typename Rep, typename Period>
+AsyncScheduler::timer_awaiter sleep_for(std::chrono::duration<Rep, Period> duration) {
+    return { std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration) };
+}
+
+/**
+ * Suspend the calling task until the given file descriptor can be read.
+ * @param fd the file descriptor
+ * @return the awaitable of the file descriptor, resumed with the epoll events
+ */
+AsyncScheduler::fd_awaiter readable(int fd) {
+    return { fd, EPOLLIN, 0, {}, {} };
+}
+
+/**
+ * Suspend the calling task until the given file descriptor can be written.
+ * @param fd the file descriptor
+ * @return the awaitable of the file descriptor, resumed with the epoll events
+ */
+AsyncScheduler::fd_awaiter writable(int fd) {
+    return { fd, EPOLLOUT, 0, {}, {} };
+}
+
+template <typename PromiseType>
+std::coroutine_handle<> async_promise_base::final_awaiter::await_suspend(std::coroutine_handle<PromiseType> handle) noexcept {
+    auto &promise = handle.promise();
+    if (promise.continuation) return promise.continuation;
+    if (promise.scheduler != nullptr) promise.scheduler->onCompleted(handle, promise.exception);
+    return std::noop_coroutine();
+}
+
+AsyncScheduler::AsyncScheduler() : epoll_fd(epoll_create1(EPOLL_CLOEXEC)), previous(current_scheduler) {
+    current_scheduler = this;
+}
+
+AsyncScheduler::~AsyncScheduler() {
+    // the completed tasks not destroyed yet, then the suspended ones along with the tasks they await
+    for (auto handle: ready) {
+        if (handle.done()) handle.destroy();
+    }
+    for (auto address: spawned) std::coroutine_handle<>::from_address(address).destroy();
+    close(epoll_fd);
+    current_scheduler = previous;
+}
+
+void AsyncScheduler::spawn(async_task<> task) {
+    auto handle = task.release();
+    handle.promise().scheduler = this;
+    spawned.insert(handle.address());
+    in_flight++;
+    ready.push_back(handle);
+}
+
+void AsyncScheduler::onCompleted(std::coroutine_handle<> handle, const std::exception_ptr &exception) {
+    in_flight--;
+    completed++;
+    spawned.erase(handle.address());
+    if (exception) {
+        // nobody awaits a top-level task, so its exception would be lost
+        failures++;
+        try {
+            std::rethrow_exception(exception);
+        } catch (const std::exception &e) {
+            std::cerr << "Asynchronous task failed: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Asynchronous task failed" << std::endl;
+        }
+    }
+    // the frame can't be destroyed while it is running, so it is destroyed as a ready coroutine
+    ready.push_back(handle);
+}
+
+size_t AsyncScheduler::poll(std::chrono::microseconds max_wait) {
+    auto run_ready = [this]() {
+        auto start = std::chrono::steady_clock::now();
+        // only the coroutines ready now, the ones they make ready wait for the next round
+        for (size_t count = ready.size(); count > 0; --count) {
+            auto handle = ready.front();
+            ready.pop_front();
+            if (handle.done()) handle.destroy();
+            else handle.resume();
+        }
+        busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+    run_ready();
+
+    if (ready.empty() && (waiting_fds > 0 || !timers.empty() || max_wait.count() >= 0)) {
+        // wait until the earliest timer, at most for max_wait
+        long timeout_ms = max_wait.count() < 0 ? -1:(max_wait.count() + 999) / 1000;
+        if (!timers.empty()) {
+            auto until_timer = std::chrono::ceil<std::chrono::milliseconds>(timers.top().first - std::chrono::steady_clock::now()).count();
+            timeout_ms = timeout_ms < 0 ? std::max(0L, until_timer):std::clamp(until_timer, 0L, timeout_ms);
+        }
+        epoll_event events[64];
+        int num_events = epoll_wait(epoll_fd, events, 64, (int) timeout_ms);
+        auto now = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_events; ++i) {
+            auto awaiter = static_cast<fd_awaiter*>(events[i].data.ptr);
+            awaiter->ready_events = events[i].events;
+            blocked_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(now - awaiter->suspended).count();
+            waiting_fds--;
+            ready.push_back(awaiter->handle);
+        }
+    }
+    auto now = std::chrono::steady_clock::now();
+    while (!timers.empty() && timers.top().first <= now) {
+        ready.push_back(timers.top().second);
+        timers.pop();
+    }
+    run_ready();
+
+    return std::exchange(completed, 0);
+}
+
+bool AsyncScheduler::timer_awaiter::await_ready() const {
+    if (current() != nullptr) return deadline <= std::chrono::steady_clock::now();
+    // without a scheduler the thread blocks
+    std::this_thread::sleep_until(deadline);
+    return true;
+}
+
+template <typename T>
+T AsyncScheduler::run(async_task<T> task) {
+    AsyncScheduler scheduler;
+    async_result<T> result;
+    std::exception_ptr exception;
+    scheduler.spawn(complete(task, result, exception));
+    while (scheduler.inFlight() > 0) scheduler.poll(std::chrono::microseconds(-1));
+    if (exception) std::rethrow_exception(exception);
+    return result.get();
+}
+
+template <typename T>
+async_task<> AsyncScheduler::complete(async_task<T> &task, async_result<T> &result, std::exception_ptr &exception) {
+    try {
+        if constexpr (std::is_void_v<T>) co_await task;
+        else result.return_value(co_await task);
+    } catch (...) {
+        exception = std::current_exception();
+    }
+}
+
+void AsyncScheduler::timer_awaiter::await_suspend(std::coroutine_handle<> handle) const {
+    auto scheduler = current();
+    // the task is blocked until its deadline, even if the scheduler notices it later
+    scheduler->blocked_ns += std::max(0L, (long) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            deadline - std::chrono::steady_clock::now()).count());
+    scheduler->timers.emplace(deadline, handle);
+}
+
+bool AsyncScheduler::fd_awaiter::await_ready() {
+    if (current() != nullptr) return false;
+    // without a scheduler the thread blocks
+    pollfd waiting{ fd, (short) events, 0 };
+    ::poll(&waiting, 1, -1);
+    ready_events = waiting.revents;
+    return true;
+}
+
+void AsyncScheduler::fd_awaiter::await_suspend(std::coroutine_handle<> handle) {
+    auto scheduler = current();
+    this->handle = handle;
+    suspended = std::chrono::steady_clock::now();
+    // one shot: the file descriptor stays registered, disabled, until it is awaited again
+    epoll_event event{ events | EPOLLONESHOT, { .ptr = this } };
+    if (epoll_ctl(scheduler->epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0
+        || (errno == ENOENT && epoll_ctl(scheduler->epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0)) {
+        scheduler->waiting_fds++;
+        return;
+    }
+    // regular files can't be polled and are always ready
+    ready_events = events;
+    scheduler->ready.push_back(handle);
+}
+
+#endif //AUTONOMICFARM_ASYNCSCHEDULER_HPP
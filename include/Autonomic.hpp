@@ -1,7 +1,19 @@
 #ifndef AUTONOMICFARM_AUTONOMIC_HPP
 #define AUTONOMICFARM_AUTONOMIC_HPP
 
+#include <deque>
+#include <map>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <limits>
 #include "utimer.hpp"
+#include "FarmAnalytics.hpp"
+#include "ArrivalForecaster.hpp"
+#include "ScalabilityModel.hpp"
+#include "EventTracer.hpp"
 
 class Autonomic {
 public:
@@ -25,6 +37,60 @@ public:
      */
     virtual int improveServiceTime(double current_service_time, std::chrono::system_clock::time_point now);
 
+    /**
+     * Enable or disable the forecasting of the arrival rate. When enabled, the number of workers is increased ahead
+     * of a predicted rise of the arrival rate, without waiting for the service time to degrade.
+     * @param enabled true to enable the forecasting
+     */
+    void setForecasting(bool enabled) {
+        forecasting = enabled;
+    }
+
+    /**
+     * Enable the calibration of the initial number of workers. The service time of a worker is measured until the
+     * workers complete the first tasks and the arrival rate from the beginning of the farm, then the number of workers
+     * is set analytically in a single step before the regular control loop takes over.
+     * @param tasks how many tasks the workers complete before the number of workers is set, zero to disable the
+     * calibration
+     */
+    void setCalibration(size_t tasks) {
+        calibration_tasks = tasks;
+        analytics->controller.calibration.tasks = tasks;
+    }
+
+    /**
+     * Set the target service time of the most urgent priority class. The pool never gets smaller than the workers
+     * needed to serve that class alone at its target, which its tasks get first, whatever the load of the other
+     * classes. It has no effect unless the tasks have priorities.
+     * @param target_service_time the target service time of the most urgent class, zero to keep up with its arrivals
+     */
+    void setPriorityTarget(double target_service_time) {
+        priority_target_service_time = target_service_time;
+    }
+
+    /**
+     * Load the state learned by a previous run from the given file, and save the state into the same file when the
+     * controller is destroyed. A missing file is not an error: the state is learned from scratch and saved at the end.
+     * @param path the path of the state file
+     */
+    void setStateFile(const std::string &path);
+
+    /**
+     * Save the learned state: the scalability curve and the stable number of workers of each load level.
+     * @param path the path of the state file
+     */
+    void saveState(const std::string &path) const;
+
+    /**
+     * Load a state saved by saveState. The stable numbers of workers are loaded only if they were learned with the
+     * same target service time.
+     * @param path the path of the state file
+     * @return true if the file was loaded
+     */
+    bool loadState(const std::string &path);
+
+    virtual ~Autonomic();
+
 protected:
     farm_analytics* analytics;
 
@@ -44,12 +110,47 @@ protected:
     // sum of all the times in the window
     double window_elapsed_time_sum = 0.0;
 
+    // throughput observed with each number of workers
+    ScalabilityModel scalability;
+
+    // number of workers that met the target, for each level of the arrival time
+    std::map<int, size_t> stable_num_workers;
+    // file where the learned state is saved at the end, empty to not save it
+    std::string state_file;
+    // true until the first decision after loading a state with stable numbers of workers
+    bool warm_start_pending = false;
+
+    // tasks still to measure before the calibration ends, zero when it is disabled or it ended
+    size_t calibration_tasks = 0;
+    // service times notified and worker's service times sampled at each notification during the calibration
+    size_t calibration_notifications = 0;
+    size_t calibration_samples = 0;
+    double calibration_service_time_sum = 0.0;
+    // point in time when the regular control loop would have been able to make its first decision, -1 if not yet
+    long reactive_ready_time = -1;
+
+    // target service time of the most urgent priority class, zero for its arrival time
+    double priority_target_service_time = 0;
+
+    // arrival rate forecasting
+    bool forecasting = false;
+    ArrivalForecaster forecaster;
+    // number of arrivals and point in time of the last observation of the arrival rate
+    size_t forecast_last_arrivals = 0;
+    long forecast_last_time = 0;
+
     // constants
     // minimum time needed to elapse before making a change in the number of workers
     const long reaction_time_ms = 190; // ms
     const size_t service_time_window_size = 6;
     // maximum service time error
     const double max_service_time_error = 1.0;
+    // minimum time between two observations of the arrival rate
+    const long forecast_sample_period_ms = 50;
+    // minimum relative rise of the arrival rate forecast after the reaction time to scale up ahead of it
+    const double forecast_min_rise = 0.1;
+    // time within which the tasks waiting on disk should be drained, besides keeping up with the arrivals
+    const double backlog_drain_time_ms = 1000;
 
     /**
      * Changes the number of workers and unpauses or pauses accordingly. Given the point in time, this function takes
@@ -60,6 +161,68 @@ protected:
      */
     void changeWorkersNumber(size_t new_num_workers, std::chrono::system_clock::time_point now);
 
+    /**
+     * Give the service time of a worker to the scalability model, unless the workers are still settling after the last
+     * change of their number. The observed curve is tracked into the analytics.
+     * @param current_time the time elapsed from the beginning of the farm (milliseconds)
+     */
+    void observeScalability(long current_time);
+
+    /**
+     * Measure the service time of a worker during the calibration and, after enough tasks, set the number of workers
+     * needed by the measured service time and arrival rate.
+     * @param current_time the time elapsed from the beginning of the farm (milliseconds)
+     * @param now the point in time when this method was called
+     */
+    void calibrate(long current_time, std::chrono::system_clock::time_point now);
+
+    /**
+     * Remember the current number of workers as the stable one for the current arrival time.
+     */
+    void rememberStableNumWorkers();
+
+    /**
+     * The load level of an arrival time. Levels are half an octave wide, so that the stable number of workers learned
+     * for an arrival time is reused for similar ones.
+     * @param arrival_time the arrival time (milliseconds)
+     * @return the load level
+     */
+    static int loadLevel(long arrival_time) {
+        return (int) std::floor(2 * std::log2((double) std::max(arrival_time, 0L) + 1));
+    }
+
+    /**
+     * Observe the arrival rate since the previous observation and give it to the forecaster. The forecast error is
+     * tracked into the analytics.
+     * @param current_time the time elapsed from the beginning of the farm (milliseconds)
+     */
+    void observeArrivalRate(long current_time);
+
+    /**
+     * Compute the number of workers needed to sustain the arrival rate forecast after the reaction time.
+     * @return the number of workers needed by the forecast arrival rate or -1 if there is no forecast yet
+     */
+    int forecastNumWorkers();
+
+    /**
+     * Compute the number of workers needed to keep up with the arrivals and drain the tasks waiting on disk.
+     * @return the number of workers needed by the backlog or -1 if there is no backlog
+     */
+    int backlogNumWorkers();
+
+    /**
+     * Compute the number of workers needed to serve the most urgent priority class at its target.
+     * @return the number of workers needed by the most urgent class or -1 if the tasks have no priorities
+     */
+    int priorityNumWorkers();
+
+    /**
+     * @return the most workers worth running, between the minimum and the maximum number of workers
+     */
+    int usefulNumWorkers() {
+        return (int) std::clamp(getUsefulNumWorkers(), min_num_workers, max_num_workers);
+    }
+
     virtual void pauseWorkers(size_t fromIndex, size_t toIndex) = 0;
 
     virtual void unpauseWorkers(size_t fromIndex, size_t toIndex) = 0;
@@ -67,12 +230,74 @@ protected:
     virtual long getArrivalTime() = 0;
 
     virtual long getWorkerServiceTime() = 0;
+
+    /**
+     * @return the total number of tasks arrived from the beginning of the farm
+     */
+    virtual size_t getNumArrivals() = 0;
+
+    /**
+     * @return the total number of tasks completed by the workers from the beginning of the farm
+     */
+    virtual size_t getNumCompleted() = 0;
+
+    /**
+     * @return the number of tasks spilled to disk because the farm fell behind the arrivals
+     */
+    virtual size_t getBacklog() {
+        return 0;
+    }
+
+    /**
+     * @return the average time between two arrivals of the most urgent priority class (milliseconds), -1 if the tasks
+     * have no priorities or none of that class arrived yet
+     */
+    virtual double getPriorityArrivalTime() {
+        return -1;
+    }
+
+    /**
+     * @return the most workers the waiting tasks can keep busy, for example when the tenants sending them are capped,
+     * the maximum value of size_t if unbounded
+     */
+    virtual size_t getUsefulNumWorkers() {
+        return std::numeric_limits<size_t>::max();
+    }
+
+    /**
+     * The current point in time, used to timestamp every decision. It can be overridden to run the controller against
+     * a virtual clock.
+     * @return the current point in time
+     */
+    virtual std::chrono::system_clock::time_point currentTime() {
+        return std::chrono::system_clock::now();
+    }
 };
 
 void Autonomic::onNewServiceTime(double current_service_time) {
     // update the window
-    START(now);
+    auto now = currentTime();
     auto current_time = ELAPSED(analytics->farm_start_time, now, std::chrono::milliseconds);
+    if (forecasting) observeArrivalRate(current_time);
+    observeScalability(current_time);
+    // during the calibration the number of workers is chosen only once, from the measures of the first tasks
+    if (calibration_tasks > 0) {
+        calibrate(current_time, now);
+        return;
+    }
+    // the first decision of a warm started controller is the number of workers that was stable at the same load
+    if (warm_start_pending && getNumArrivals() > 1) {
+        warm_start_pending = false;
+        auto stable = stable_num_workers.find(loadLevel(getArrivalTime()));
+        if (stable != stable_num_workers.end()) {
+            // the bounds may have changed since the state was saved
+            auto stable_num = std::clamp(stable->second, min_num_workers, max_num_workers);
+            if (stable_num != num_workers) {
+                changeWorkersNumber(stable_num, now);
+                return;
+            }
+        }
+    }
     service_time_window.emplace_back(current_service_time, current_time);
     window_service_time_sum += current_service_time;
     window_elapsed_time_sum += (double) current_time;
@@ -87,6 +312,31 @@ void Autonomic::onNewServiceTime(double current_service_time) {
     // check if at least <reaction_time_ms> elapsed from the last time we had a correct number of workers
     if (ELAPSED(last_change, now, std::chrono::milliseconds) <= reaction_time_ms) return;
 
+    // workers beyond the useful ones would stay idle, whatever the service time says
+    int useful_num_workers = usefulNumWorkers();
+
+    // scale up ahead of a predicted rise of the arrival rate
+    int forecast_num_workers = forecasting ? std::min(forecastNumWorkers(), useful_num_workers):-1;
+    bool rising = forecaster.forecast((double) reaction_time_ms) > (1 + forecast_min_rise) * forecaster.forecast(0);
+    if (forecast_num_workers > (int) num_workers && rising) {
+        changeWorkersNumber(forecast_num_workers, now);
+        return;
+    }
+
+    // tasks spilled to disk mean that the farm is behind, whatever its service time says
+    int backlog_num_workers = std::min(backlogNumWorkers(), useful_num_workers);
+    if (backlog_num_workers > (int) num_workers) {
+        changeWorkersNumber(backlog_num_workers, now);
+        return;
+    }
+
+    // the most urgent class must meet its target even if the service time of the whole stream is fine
+    int priority_num_workers = std::min(priorityNumWorkers(), useful_num_workers);
+    if (priority_num_workers > (int) num_workers) {
+        changeWorkersNumber(priority_num_workers, now);
+        return;
+    }
+
     int new_num_workers;
     long arrival_time = getArrivalTime();
     if (target_best_service_time && std::abs(current_service_time - arrival_time) < max_service_time_error) {
@@ -96,11 +346,15 @@ void Autonomic::onNewServiceTime(double current_service_time) {
         new_num_workers = improveServiceTime(current_service_time, now);
     }
     if (new_num_workers == -1) return;
+    // never go below the number of workers needed by the forecast arrival rate, or the next ramp would undo it
+    new_num_workers = std::max({ new_num_workers, forecast_num_workers, backlog_num_workers, priority_num_workers });
+    new_num_workers = std::min(new_num_workers, useful_num_workers);
 
     // if the new optimal number of workers is equal to the current number, we don't make any change, but we have to
     // remember the point in time when we had the last correct number of workers
     if (new_num_workers == num_workers) {
         last_change = now;
+        rememberStableNumWorkers();
         return;
     }
 
@@ -113,6 +367,7 @@ int Autonomic::improveServiceTime(double current_service_time, std::chrono::syst
     // of workers can be considered correct. Abort any change
     if (current_service_time > target_service_time - max_service_time_error && current_service_time < target_service_time + max_service_time_error) {
         last_change = now;
+        rememberStableNumWorkers();
         return -1;
     }
 
@@ -139,13 +394,20 @@ int Autonomic::improveServiceTime(double current_service_time, std::chrono::syst
 
     // if we are here it means that we need to change the number of workers according to the current service time.
 
-    // the optimal number of nodes is worker's service time over the target service time
+    // the optimal number of nodes is worker's service time over the target service time, if the workers scale linearly
     double curr_workers_service_time = current_service_time * (double) num_workers;
-    return std::clamp(
+    auto linear_num_workers = std::clamp(
             (size_t) std::round(curr_workers_service_time / target_service_time),
             min_num_workers,
             max_num_workers
     );
+    // more workers are useful only as long as the learned scalability curve keeps growing. The throughput needed is
+    // the current one scaled as the linear estimate does, so the curve only lowers the estimate when it flattens
+    if (linear_num_workers > num_workers && scalability.isReady()) {
+        double needed_throughput = scalability.throughput(num_workers) * current_service_time / target_service_time;
+        return (int) std::min(linear_num_workers, scalability.workersFor(needed_throughput, min_num_workers, max_num_workers));
+    }
+    return (int) linear_num_workers;
 }
 
 void Autonomic::changeWorkersNumber(size_t new_num_workers, std::chrono::system_clock::time_point now) {
@@ -157,21 +419,203 @@ void Autonomic::changeWorkersNumber(size_t new_num_workers, std::chrono::system_
         // to decrease the number of nodes, pause the not needed ones
         pauseWorkers(new_num_workers, num_workers - 1);
     }
+    // update the controller metrics with the time spent with the old number of workers
+    auto global_elapsed = ELAPSED(analytics->farm_start_time, now, std::chrono::milliseconds);
+    long previous_change = analytics->num_workers.empty() ? 0:analytics->num_workers.back().second;
+    analytics->controller.onReconfiguration(num_workers, new_num_workers, global_elapsed - previous_change);
+
     // change the number of workers
     num_workers = new_num_workers;
 
     // update the analytics with the newest number of workers
-    auto global_elapsed = ELAPSED(analytics->farm_start_time, now, std::chrono::milliseconds);
     analytics->num_workers.emplace_back(num_workers, global_elapsed);
+    EventTracer::record(trace_event::decision, (int32_t) num_workers);
 
     // remember the point in time when we had the last correct number of workers
     last_change = now;
 }
 
+void Autonomic::calibrate(long current_time, std::chrono::system_clock::time_point now) {
+    calibration_notifications++;
+    // the regular loop decides once its window is full and the reaction time elapsed
+    if (reactive_ready_time < 0 && calibration_notifications > service_time_window_size
+        && ELAPSED(last_change, now, std::chrono::milliseconds) > reaction_time_ms) {
+        reactive_ready_time = current_time;
+    }
+    long worker_service_time = getWorkerServiceTime();
+    if (worker_service_time > 0) {
+        calibration_service_time_sum += (double) worker_service_time;
+        calibration_samples++;
+    }
+    auto arrivals = getNumArrivals();
+    // the samples repeat the same measures until the workers complete more tasks, so the tasks are counted instead
+    if (getNumCompleted() < calibration_tasks || calibration_samples == 0 || arrivals == 0 || current_time <= 0) return;
+
+    double service_time = calibration_service_time_sum / (double) calibration_samples;
+    double arrival_time = (double) current_time / (double) arrivals;
+    // the farm should be as fast as the arrivals, or as the target if there is one
+    double needed_service_time = target_best_service_time ? arrival_time:target_service_time;
+    size_t new_num_workers = scalability.isReady()
+            ? scalability.workersFor(1.0 / needed_service_time, min_num_workers, max_num_workers)
+            : std::clamp((size_t) std::ceil(service_time / needed_service_time), min_num_workers, max_num_workers);
+
+    auto &report = analytics->controller.calibration;
+    report.end_time = current_time;
+    report.worker_service_time = service_time;
+    report.arrival_time = arrival_time;
+    report.num_workers = new_num_workers;
+    // the regular loop would have needed at least until its first decision to move from the initial number of workers
+    long reactive_decision_time = reactive_ready_time < 0
+            ? std::max((long) reaction_time_ms, current_time + 1):reactive_ready_time;
+    // a calibration ending after the regular loop could have decided saved nothing
+    report.saved_time = std::max(0L, reactive_decision_time - current_time);
+
+    calibration_tasks = 0;
+    warm_start_pending = false;
+    if (new_num_workers != num_workers) changeWorkersNumber(new_num_workers, now);
+    else last_change = now;
+}
+
+void Autonomic::rememberStableNumWorkers() {
+    stable_num_workers[loadLevel(getArrivalTime())] = num_workers;
+}
+
+void Autonomic::observeScalability(long current_time) {
+    long last_reconfiguration = analytics->num_workers.empty() ? 0:analytics->num_workers.back().second;
+    if (current_time - last_reconfiguration <= reaction_time_ms) return;
+
+    scalability.observe(num_workers, (double) getWorkerServiceTime());
+    if (analytics->scalability.size() < max_num_workers) analytics->scalability.resize(max_num_workers);
+    analytics->scalability[num_workers - 1] = { num_workers, scalability.observedThroughput(num_workers), scalability.samples(num_workers) };
+}
+
+void Autonomic::observeArrivalRate(long current_time) {
+    auto elapsed = current_time - forecast_last_time;
+    if (elapsed < forecast_sample_period_ms) return;
+
+    auto arrivals = getNumArrivals();
+    double rate = (double) (arrivals - forecast_last_arrivals) / (double) elapsed;
+    double predicted = forecaster.observe(rate, (double) elapsed);
+    if (predicted >= 0) analytics->arrival_forecast.emplace_back(rate, predicted, current_time);
+    forecast_last_arrivals = arrivals;
+    forecast_last_time = current_time;
+}
+
+int Autonomic::forecastNumWorkers() {
+    long worker_service_time = getWorkerServiceTime();
+    if (!forecaster.isReady() || worker_service_time <= 0) return -1;
+
+    double forecast_rate = forecaster.forecast((double) reaction_time_ms);
+    if (forecast_rate <= 0) return -1;
+    // the farm can't be faster than the arrivals, so the service time needed is the slowest between the target and
+    // the forecast arrival time
+    double needed_service_time = 1.0 / forecast_rate;
+    if (!target_best_service_time) needed_service_time = std::max(needed_service_time, target_service_time);
+    if (scalability.isReady()) {
+        return (int) scalability.workersFor(1.0 / needed_service_time, min_num_workers, max_num_workers);
+    }
+    return (int) std::clamp(
+            (size_t) std::ceil((double) worker_service_time / needed_service_time),
+            min_num_workers,
+            max_num_workers
+    );
+}
+
+int Autonomic::backlogNumWorkers() {
+    size_t backlog = getBacklog();
+    long worker_service_time = getWorkerServiceTime();
+    if (backlog == 0 || worker_service_time <= 0) return -1;
+
+    long arrival_time = getArrivalTime();
+    double needed_rate = (arrival_time > 0 ? 1.0 / (double) arrival_time:0) + (double) backlog / backlog_drain_time_ms;
+    return (int) std::clamp(
+            (size_t) std::ceil((double) worker_service_time * needed_rate),
+            min_num_workers,
+            max_num_workers
+    );
+}
+
+int Autonomic::priorityNumWorkers() {
+    double priority_arrival_time = getPriorityArrivalTime();
+    if (priority_arrival_time < 0) return -1;
+    double target = priority_target_service_time > 0 ? priority_target_service_time:priority_arrival_time;
+    long worker_service_time = getWorkerServiceTime();
+    if (target <= 0 || worker_service_time <= 0) return -1;
+    return (int) std::clamp(
+            (size_t) std::ceil((double) worker_service_time / target),
+            min_num_workers,
+            max_num_workers
+    );
+}
+
+void Autonomic::setStateFile(const std::string &path) {
+    state_file = path;
+    loadState(path);
+}
+
+void Autonomic::saveState(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Cannot save the controller state to " << path << std::endl;
+        return;
+    }
+    file << "autonomic-state 1" << std::endl;
+    file << "target " << (target_best_service_time ? 0:target_service_time) << std::endl;
+    for (size_t n = 1; n <= max_num_workers; ++n) {
+        if (scalability.samples(n) == 0) continue;
+        file << "scalability " << n << " " << scalability.observedThroughput(n) << " " << scalability.samples(n) << std::endl;
+    }
+    for (auto &[level, stable]: stable_num_workers) {
+        file << "stable " << level << " " << stable << std::endl;
+    }
+}
+
+bool Autonomic::loadState(const std::string &path) {
+    std::ifstream file(path);
+    std::string header;
+    if (!file.is_open() || !std::getline(file, header)) return false;
+    if (header != "autonomic-state 1") {
+        std::cerr << "Ignoring the controller state in " << path << ": unknown format" << std::endl;
+        return false;
+    }
+
+    std::map<int, size_t> loaded_stable_num_workers;
+    double saved_target = -1;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream row(line);
+        std::string key;
+        row >> key;
+        if (key == "target") {
+            row >> saved_target;
+        } else if (key == "scalability") {
+            size_t n = 0, samples = 0;
+            double throughput = 0;
+            if (row >> n >> throughput >> samples) scalability.restore(n, throughput, samples);
+        } else if (key == "stable") {
+            int level;
+            size_t stable;
+            if (row >> level >> stable) loaded_stable_num_workers[level] = stable;
+        }
+    }
+    // with a different target the same load needs a different number of workers
+    if (saved_target == (target_best_service_time ? 0:target_service_time)) {
+        stable_num_workers = std::move(loaded_stable_num_workers);
+        warm_start_pending = !stable_num_workers.empty();
+    }
+    return true;
+}
+
+Autonomic::~Autonomic() {
+    if (!state_file.empty()) saveState(state_file);
+}
+
 Autonomic::Autonomic(farm_analytics *analytics, size_t numWorkers, size_t minNumWorkers, size_t maxNumWorkers,
                      double targetServiceTime) : analytics(analytics), num_workers(numWorkers),
                      min_num_workers(minNumWorkers), max_num_workers(maxNumWorkers), target_service_time(targetServiceTime),
-                     target_best_service_time(target_service_time == 0) {}
+                     target_best_service_time(target_service_time == 0), scalability(maxNumWorkers) {
+    analytics->controller.max_error = max_service_time_error;
+}
 
 
 #endif //AUTONOMICFARM_AUTONOMIC_HPP
@@ -12,25 +12,139 @@ class AutonomicFarm : public MonitoredFarm<InputType, OutputType> {
 public:
     using WorkerFunType = MonitoredFarm<InputType, OutputType>::WorkerFunType;
     using SendOutFunType = MonitoredFarm<InputType, OutputType>::SendOutFunType;
+    using AsyncWorkerFunType = std::function<async_task<OutputType>(InputType)>;
 
     AutonomicFarm(size_t num_workers, size_t minNumWorkers, size_t maxNumWorkers, double target_service_time,
                   const WorkerFunType &fun, const SendOutFunType &sendOutFun);
+
+    /**
+     * @return the controller which changes the number of workers of this farm, to configure it before running the farm
+     */
+    Autonomic& autonomic() {
+        return *autonomic_pool;
+    }
+
+    /**
+     * Compute the items with a coroutine instead of the worker function, for tasks that wait on timers or file
+     * descriptors: each worker keeps many items in flight, and the controller chooses how many along with the number
+     * of workers. The inline execution is disabled. It must be called before running the farm.
+     * @param fun the coroutine computing an item
+     * @param max_concurrency the maximum number of items in flight per worker
+     */
+    void setAsyncWorker(const AsyncWorkerFunType &fun, size_t max_concurrency) {
+        async_worker_fun = fun;
+        this->inline_execution = false;
+        autonomic_pool->setAsync([this](InputType value) {
+            // the coroutine is created by the worker right after taking the item, so the tag is the item's one
+            return computeAsync(std::move(value), ThreadedNode<InputType>::currentTag());
+        }, max_concurrency);
+    }
+
+    /**
+     * Keep at most the given number of waiting items in memory, spilling the following ones to disk and reading them
+     * back in order as the workers catch up. The items must be trivially copyable. It must be called before running
+     * the farm.
+     * @param max_in_memory the maximum number of waiting items kept in memory
+     * @param directory the directory of the spill files
+     */
+    void setSpill(size_t max_in_memory, const std::string &directory) {
+        autonomic_pool->enableSpill(max_in_memory, directory);
+    }
+
+    /**
+     * Dispatch the items earliest virtual deadline first instead of in FIFO order, so that the urgent items don't wait
+     * behind a burst of bulk ones: an item with a deadline is due at its arrival plus its deadline, one without at its
+     * arrival plus the aging period times its class. The latency of the items is recorded by class, and the pool is
+     * kept large enough for the most urgent class to meet its target, see Autonomic::setPriorityTarget. It must be
+     * called before running the farm.
+     * @param classify the function giving the priority of an item
+     * @param aging_ms the aging period of the classes (milliseconds)
+     */
+    void setPriorities(const typename AutonomicWorkerPool<InputType>::ClassifyFunType &classify, double aging_ms) {
+        autonomic_pool->enablePriorities(classify, aging_ms);
+    }
+
+    /**
+     * Share the farm among the tenants sending the items: each tenant has a sub-queue of its own, and the workers take
+     * the items by weighted deficit round robin over them, so that the tenants get the computing time in proportion to
+     * their weights and a noisy tenant only makes its own items wait. A tenant may be capped to some workers at once,
+     * and then the pool never grows beyond the workers the tenants with items can use. What each tenant got is in the
+     * analytics. It must be called before running the farm.
+     * @param tenant_of the function giving the tenant of an item, numbered from zero
+     * @param weights the weight of each tenant, one for the missing ones
+     * @param caps the most workers of each tenant at once, zero or missing for no cap
+     */
+    void setTenants(const typename AutonomicWorkerPool<InputType>::TenantFunType &tenant_of,
+                    const std::vector<double> &weights = {}, const std::vector<size_t> &caps = {}) {
+        autonomic_pool->enableTenants(tenant_of);
+        for (size_t i = 0; i < weights.size(); ++i) autonomic_pool->setTenantWeight(i, weights[i]);
+        for (size_t i = 0; i < caps.size(); ++i) autonomic_pool->setTenantCap(i, caps[i]);
+    }
+
+    /**
+     * Drop the items the farm cannot keep up with, as decided by the given admission control, instead of letting the
+     * latency of every item grow with the queue. The futures of the submitted items dropped fail. It must be called
+     * before running the farm.
+     * @param admission the admission control
+     */
+    void setAdmission(const AdmissionControl &admission) {
+        autonomic_pool->enableAdmission(admission, [this](InputType&, uint32_t tag) { this->drop(tag); });
+    }
+
+protected:
+    void onInlineArrival() override {
+        autonomic_pool->notifyArrival();
+    }
+
+    void tagItems() override {
+        autonomic_pool->enableTags();
+    }
+
+    std::vector<ThreadedNode<InputType>*> workerNodes() override {
+        std::vector<ThreadedNode<InputType>*> workers;
+        for (auto &node: autonomic_pool->getNodes()) workers.push_back(&node);
+        return workers;
+    }
+
+private:
+    AutonomicWorkerPool<InputType>* autonomic_pool;
+    AsyncWorkerFunType async_worker_fun;
+
+    /**
+     * Compute an item with the asynchronous worker function and send the result to the gatherer.
+     * @param value the item to compute
+     * @param tag the tag of the item, to write its result into its future if it was submitted
+     */
+    async_task<> computeAsync(InputType value, uint32_t tag);
 };
 
+template<typename InputType, typename OutputType>
+async_task<> AutonomicFarm<InputType, OutputType>::computeAsync(InputType value, uint32_t tag) {
+    auto res = co_await async_worker_fun(std::move(value));
+    this->complete(res, tag);
+    this->gatherer->send(res);
+}
+
 template<typename InputType, typename OutputType>
 AutonomicFarm<InputType, OutputType>::AutonomicFarm(size_t num_workers, size_t minNumWorkers, size_t maxNumWorkers,
     double target_service_time, const WorkerFunType &fun, const SendOutFunType &sendOutFun) {
-    auto workerfun = [&fun, this](auto val) {
-        auto res = fun(val);
+    this->worker_fun = fun;
+    this->send_out_fun = sendOutFun;
+    auto workerfun = [this](auto val) {
+        auto res = this->compute(val);
+        this->complete(res, ThreadedNode<InputType>::currentTag());
         this->gatherer->send(res);
     };
-    auto autonomic_pool = new AutonomicWorkerPool<InputType>(num_workers, workerfun,
+    autonomic_pool = new AutonomicWorkerPool<InputType>(num_workers, workerfun,
         minNumWorkers, maxNumWorkers, target_service_time, &this->analytics
     );
-    this->gatherer = new AutonomicGatherer<InputType, OutputType>(sendOutFun, &this->analytics, autonomic_pool);
+    autonomic_pool->enableStats();
+    this->monitoring_gatherer = new AutonomicGatherer<InputType, OutputType>([this](auto &res) { this->sendOut(res); },
+        &this->analytics, autonomic_pool);
+    this->monitoring_gatherer->setName("gatherer");
+    this->gatherer = this->monitoring_gatherer;
     this->workers_pool = autonomic_pool;
-    // we already know the current number of workers
-    this->analytics.num_workers.emplace_back(num_workers, 0);
+    // the initial number of workers is recorded by the pool when it runs
 }
 
 
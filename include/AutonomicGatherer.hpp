@@ -35,7 +35,8 @@ void AutonomicGatherer<InputType, OutputType>::onValue(OutputType &value) {
     if (this->analytics->service_time.size() == prev_size) return;
 
     // notify the newest service time to the workers. The gatherer thread will execute all the code needed by the
-    // workers pool to change the number of workers.
+    // workers pool to change the number of workers, or the sending thread for the results of the inline tasks sunk
+    // there, see MonitoredFarm::setInlineExecution.
     auto current_service_time = this->analytics->service_time.back();
     workers_pool->onNewServiceTime(current_service_time.first);
 }
@@ -4,6 +4,9 @@
 
 #include <chrono>
 #include "ThreadedNode.hpp"
+#include "AsyncScheduler.hpp"
+#include "TaskPriority.hpp"
+#include "FairQueue.hpp"
 #include "trace.hpp"
 
 template <typename InputType>
@@ -11,6 +14,7 @@ class AutonomicWorker : public ThreadedNode<InputType> {
 public:
     using WorkerFunType = ThreadedNode<InputType>::OnValueFun;
     using OnExitFunType = std::function<void(void)>;
+    using AsyncFunType = std::function<async_task<>(InputType)>;
 
     AutonomicWorker(const WorkerFunType &onValueFun, Stream<InputType>* main_stream, const OnExitFunType& onExitFun)
     : ThreadedNode<InputType>(onValueFun), main_stream(main_stream), onExitFun(onExitFun) {}
@@ -20,23 +24,113 @@ public:
     void notify_eos() override;
     void pause();
     void unpause();
-    void setAsReference(std::atomic<double> *atomic_worker_service_time);
+
+    /**
+     * Compute the items with a coroutine instead of the worker function, so that many items are in flight at once:
+     * while an item waits for a timer or a file descriptor, the worker takes and computes the next ones. It must be
+     * called before running.
+     * @param fun the coroutine computing an item
+     * @param concurrency the maximum number of items in flight, that can be changed while running
+     */
+    void setAsync(const AsyncFunType &fun, const std::atomic<size_t>* concurrency) {
+        async_fun = fun;
+        this->concurrency = concurrency;
+    }
+
+    /**
+     * Record the latency of every item, from its arrival to the end of its computation, by priority class. The
+     * statistics must be enabled. It must be called before running.
+     */
+    void enableClassLatency() {
+        record_latencies = true;
+    }
+
+    /**
+     * @return the latencies of the items computed by this worker, by priority class, complete once it ended
+     */
+    const std::vector<class_latency>& classLatencies() const {
+        return latencies;
+    }
+
+    /**
+     * Record what each tenant got from this worker, and tell the input stream when each item is done, so that its
+     * tenant may have another one in flight. The statistics must be enabled. It must be called before running.
+     */
+    void enableTenants() {
+        record_tenants = true;
+    }
+
+    /**
+     * @return the items computed by this worker for each tenant, complete once it ended
+     */
+    const std::vector<tenant_stats>& tenantStats() const {
+        return tenants;
+    }
+
+    /**
+     * @return the moving average of the time an item runs on the thread of this worker (milliseconds), -1 if unknown
+     */
+    double asyncRunTime() const {
+        return async_run_ms;
+    }
+
+    /**
+     * @return the moving average of the time an item waits for its timers and file descriptors (milliseconds), -1 if
+     * unknown
+     */
+    double asyncBlockedTime() const {
+        return async_blocked_ms;
+    }
 
 protected:
     void node_fun() override;
 
+    /**
+     * Thread function of the asynchronous worker: take items while fewer than the concurrency are in flight, and run
+     * the ones that are ready.
+     */
+    void async_node_fun();
+
+    /**
+     * Compute an item with a coroutine, then free the place of its tenant in the input stream once the item completed,
+     * failed, or was abandoned along with the scheduler.
+     * @param task the coroutine computing the item
+     * @param tenant the tenant of the item
+     */
+    async_task<> computeForTenant(async_task<> task, uint32_t tenant);
+
+    /**
+     * Wait while this worker is paused.
+     * @param idle_from the point in time when the worker became idle, moved to the end of the pause
+     */
+    void waitUnpaused(std::chrono::steady_clock::time_point &idle_from);
+
     Stream<InputType>* main_stream;
     std::condition_variable cond_pause;
     std::mutex pause_mutex;
     bool is_paused = false;
     OnExitFunType onExitFun;
-    std::atomic<double> *atomic_worker_service_time = nullptr;
-};
 
-template<typename InputType>
-void AutonomicWorker<InputType>::setAsReference(std::atomic<double> *new_atomic_worker_service_time) {
-    this->atomic_worker_service_time = new_atomic_worker_service_time;
-}
+    // asynchronous execution, if enabled
+    AsyncFunType async_fun;
+    const std::atomic<size_t>* concurrency = nullptr;
+
+    // latencies of the items by priority class, if enabled
+    bool record_latencies = false;
+    std::vector<class_latency> latencies;
+    // items computed for each tenant, if enabled
+    bool record_tenants = false;
+    std::vector<tenant_stats> tenants;
+    // moving averages of the time run and blocked by an item, written by this worker's thread
+    std::atomic<double> async_run_ms = -1;
+    std::atomic<double> async_blocked_ms = -1;
+
+    // constants
+    // longest wait for the items in flight before checking the input stream again, while more items can be taken
+    const std::chrono::microseconds stream_poll_interval = std::chrono::microseconds(500);
+    // weight of the newest item on the moving averages
+    const double async_smoothing = 0.2;
+};
 
 /**
  * Function to send a value to an autonomic worker. However, this function won't send anything to the worker since the
@@ -66,28 +160,137 @@ void AutonomicWorker<InputType>::unpause() {
     cond_pause.notify_one();
 }
 
+template<typename InputType>
+void AutonomicWorker<InputType>::waitUnpaused(std::chrono::steady_clock::time_point &idle_from) {
+    std::unique_lock<std::mutex> lock(pause_mutex);
+    // the time before pausing is idle, the time paused is not
+    bool pausing = is_paused;
+    if (pausing) EventTracer::record(trace_event::pause);
+    if (pausing && this->collect_stats) idle_from = worker_stats::lap(this->stats.idle_ns, idle_from);
+    cond_pause.wait(lock, [this](){ return !is_paused; });
+    if (pausing && this->collect_stats) idle_from = worker_stats::lap(this->stats.paused_ns, idle_from);
+    if (pausing) EventTracer::record(trace_event::unpause);
+}
+
 template<typename InputType>
 void AutonomicWorker<InputType>::node_fun() {
+    EventTracer::nameThread(this->name);
+    if (async_fun) {
+        async_node_fun();
+        this->onExitFun();
+        return;
+    }
+    std::chrono::steady_clock::time_point idle_from, added;
+    uint32_t priority_class = 0, tenant = 0;
+    if (this->collect_stats) idle_from = std::chrono::steady_clock::now();
+    if (this->perf) this->perf->open();
     while (true) {
-        {
-            std::unique_lock<std::mutex> lock(pause_mutex);
-            cond_pause.wait(lock, [this](){ return !is_paused; });
-        }
+        waitUnpaused(idle_from);
 
-        auto next_opt = main_stream->next();
+        auto next_opt = main_stream->next(&added, &this->current_tag, &priority_class, &tenant);
         if (next_opt.has_value()) {
-            START(start_time);
-            this->onValue(next_opt.value());
-            START(end_time);
-            if (atomic_worker_service_time != nullptr) {
-                *atomic_worker_service_time = ELAPSED(start_time, end_time, std::chrono::milliseconds);
+            EventTracer::record(trace_event::dequeue);
+            auto taken = this->timed() ? std::chrono::steady_clock::now():idle_from;
+            idle_from = this->process(next_opt.value(), taken, added, idle_from);
+            // the items are timed, so the item ended when the worker became idle again
+            if (record_latencies) class_latency::record(latencies, priority_class, std::chrono::duration<double, std::milli>(idle_from - added).count());
+            if (record_tenants) {
+                double busy_ms = std::chrono::duration<double, std::milli>(idle_from - taken).count();
+                tenant_stats::record(tenants, tenant, busy_ms, std::chrono::duration<double, std::milli>(idle_from - added).count());
+                main_stream->done(tenant, busy_ms);
             }
         } else {
+            EventTracer::record(trace_event::eos);
             break;
         }
     }
+    if (this->collect_stats) worker_stats::lap(this->stats.idle_ns, idle_from);
     this->onExitFun();
 }
 
+template<typename InputType>
+void AutonomicWorker<InputType>::async_node_fun() {
+    AsyncScheduler scheduler;
+    auto start = std::chrono::steady_clock::now();
+    auto idle_from = start;
+    bool eos = false;
+    // run and blocked time of the scheduler at the last completion
+    long last_busy_ns = 0, last_blocked_ns = 0;
+    while (true) {
+        // a paused worker completes the items in flight before stopping
+        if (scheduler.inFlight() == 0) waitUnpaused(idle_from);
+        bool paused;
+        {
+            std::unique_lock<std::mutex> lock(pause_mutex);
+            paused = is_paused;
+        }
+
+        while (!eos && !paused && scheduler.inFlight() < std::max<size_t>(1, *concurrency)) {
+            std::optional<InputType> next_opt;
+            uint32_t tenant = 0;
+            if (scheduler.inFlight() == 0) {
+                // nothing to run, so wait for the next item
+                std::chrono::steady_clock::time_point added;
+                next_opt = main_stream->next(&added, &this->current_tag, nullptr, &tenant);
+                eos = !next_opt.has_value();
+            } else {
+                next_opt = main_stream->next(&eos, &this->current_tag, nullptr, &tenant);
+                if (!next_opt.has_value()) break;
+            }
+            if (eos) break;
+            EventTracer::record(trace_event::dequeue);
+            EventTracer::record(trace_event::task_start, (int32_t) this->processed_items.load(std::memory_order_relaxed));
+            auto task = async_fun(std::move(next_opt.value()));
+            // the item keeps its tenant's place until it completes
+            if (record_tenants) scheduler.spawn(computeForTenant(std::move(task), tenant));
+            else scheduler.spawn(std::move(task));
+        }
+        if (scheduler.inFlight() == 0) {
+            if (eos) break;
+            continue;
+        }
+
+        // while more items can be taken, the input stream is checked again soon
+        bool can_take = !eos && !paused && scheduler.inFlight() < *concurrency;
+        auto completed = scheduler.poll(can_take ? stream_poll_interval:std::chrono::microseconds(-1));
+        if (completed == 0) continue;
+
+        // the run and blocked time since the last completion is shared by the items completed
+        double run_ms = (double) (scheduler.busyTime() - last_busy_ns) / 1e6 / (double) completed;
+        double blocked_ms = (double) (scheduler.blockedTime() - last_blocked_ns) / 1e6 / (double) completed;
+        last_busy_ns = scheduler.busyTime();
+        last_blocked_ns = scheduler.blockedTime();
+        async_run_ms = async_run_ms < 0 ? run_ms:async_smoothing * run_ms + (1 - async_smoothing) * async_run_ms;
+        async_blocked_ms = async_blocked_ms < 0 ? blocked_ms:async_smoothing * blocked_ms + (1 - async_smoothing) * async_blocked_ms;
+        for (size_t i = 0; i < completed; ++i) EventTracer::record(trace_event::task_end);
+        this->completed(completed);
+        if (this->collect_stats) this->stats.tasks += completed;
+        if (this->speeds != nullptr) {
+            // with the given items in flight, the worker completes one every run time, or every run and blocked time
+            // over the items in flight, whichever is longer
+            double service_ms = std::max((double) async_run_ms, (async_run_ms + async_blocked_ms) / (double) std::max<size_t>(1, *concurrency));
+            this->speeds->observe(this->speed_index, service_ms);
+        }
+    }
+    if (this->collect_stats) {
+        // the worker is busy while running the items, idle when neither running nor paused
+        long elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        this->stats.busy_ns = scheduler.busyTime();
+        this->stats.idle_ns = std::max(0L, elapsed_ns - this->stats.busy_ns - this->stats.paused_ns);
+    }
+}
+
+template<typename InputType>
+async_task<> AutonomicWorker<InputType>::computeForTenant(async_task<> task, uint32_t tenant) {
+    // destroyed with the frame, however the item ended
+    struct tenant_place {
+        Stream<InputType>* stream;
+        uint32_t tenant;
+        ~tenant_place() {
+            stream->done(tenant, -1);
+        }
+    } place{ main_stream, tenant };
+    co_await task;
+}
 
 #endif //AUTONOMICFARM_AUTONOMICWORKER_HPP
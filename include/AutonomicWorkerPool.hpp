@@ -18,6 +18,11 @@
 template <typename InputType>
 class AutonomicWorkerPool : public NodePool<InputType, AutonomicWorker<InputType>>, public Autonomic {
 public:
+    // function giving the priority of an item
+    using ClassifyFunType = std::function<task_priority(const InputType&)>;
+    // function giving the tenant of an item
+    using TenantFunType = typename Stream<InputType>::TenantFunType;
+
     template <typename... Args, typename WorkerFunType>
     explicit AutonomicWorkerPool(size_t num_workers, const WorkerFunType &workerFun,
        size_t min_num_workers, size_t max_num_workers, double target_service_time, farm_analytics* analytics);
@@ -34,11 +39,117 @@ public:
      */
     void send(InputType &value) override;
 
+    void sendTagged(InputType &value, uint32_t tag) override;
+
+    /**
+     * Track a new arrival, to compute the arrival time. It is called by send, or directly when an item is computed
+     * without reaching the workers.
+     */
+    void notifyArrival();
+
     /**
      * Send end-of-stream to the autonomic worker pool's input stream.
      */
     void notify_eos() override;
 
+    /**
+     * Collect the statistics of every worker, including how long the items waited in the input stream.
+     */
+    void enableStats() {
+        main_stream.enableTimestamps();
+        NodePool<InputType, AutonomicWorker<InputType>>::enableStats();
+    }
+
+    /**
+     * Keep the tags of the items sent. It must be called before sending any item.
+     */
+    void enableTags() {
+        main_stream.enableTags();
+    }
+
+    /**
+     * Keep at most the given number of items in the input stream's memory, spilling the following ones to disk. The
+     * number of items on disk drives the controller to add workers. It must be called before running.
+     * @param max_in_memory the maximum number of items kept in memory
+     * @param directory the directory of the spill files
+     */
+    void enableSpill(size_t max_in_memory, const std::string &directory) {
+        main_stream.enableSpill(max_in_memory, directory);
+        spilling = true;
+    }
+
+    /**
+     * Dispatch the items earliest virtual deadline first, as given by their priority, instead of in FIFO order. The
+     * latency of the items is recorded by priority class, and the arrivals of the most urgent class drive the number
+     * of workers along with the whole stream. It must be called before running.
+     * @param classify the function giving the priority of an item
+     * @param aging_ms the aging period of the classes (milliseconds)
+     */
+    void enablePriorities(const ClassifyFunType &classify, double aging_ms) {
+        this->classify = classify;
+        main_stream.enablePriorities(aging_ms);
+        for (auto &node: this->nodes) node.enableClassLatency();
+    }
+
+    /**
+     * Let the given admission control drop items on arrival or once expired, instead of queueing every item. It must
+     * be called before running.
+     * @param admission the admission control
+     * @param on_shed the function called with every item dropped, along with its tag
+     */
+    void enableAdmission(const AdmissionControl &admission, const typename Stream<InputType>::ShedFunType &on_shed) {
+        main_stream.enableAdmission(admission, on_shed);
+        shedding = true;
+    }
+
+    /**
+     * Share the workers among the tenants sending the items, by weighted deficit round robin over a sub-queue per
+     * tenant, instead of in arrival order: a tenant flooding the farm lengthens its own sub-queue, not the latency of
+     * the others. A tenant may be capped to some workers at once, and the controller never runs more workers than the
+     * tenants with items can use. The statistics must be enabled. It must be called before running.
+     * @param tenant_of the function giving the tenant of an item, numbered from zero
+     */
+    void enableTenants(const TenantFunType &tenant_of) {
+        main_stream.enableTenants(tenant_of);
+        for (auto &node: this->nodes) node.enableTenants();
+        tenants = true;
+    }
+
+    /**
+     * Set the share of the workers given to a tenant, one by default. The tenants must be enabled.
+     */
+    void setTenantWeight(uint32_t tenant, double weight) {
+        main_stream.setTenantWeight(tenant, weight);
+    }
+
+    /**
+     * Cap the workers computing the items of a tenant at once, zero for no cap. The tenants must be enabled.
+     */
+    void setTenantCap(uint32_t tenant, size_t max_workers) {
+        main_stream.setTenantCap(tenant, max_workers);
+    }
+
+    /**
+     * Wait for the workers, then collect how the input stream spilled to disk and dropped items, the latencies of the
+     * priority classes and what each tenant got.
+     */
+    void wait() override;
+
+    /**
+     * Compute the items with a coroutine on every worker, each one keeping many items in flight. The number of items
+     * in flight per worker is chosen along with the number of workers: enough items to keep a worker's thread busy
+     * while the others wait for their timers and file descriptors. It must be called before running.
+     * @param fun the coroutine computing an item
+     * @param max_concurrency the maximum number of items in flight per worker
+     */
+    void setAsync(const typename AutonomicWorker<InputType>::AsyncFunType &fun, size_t max_concurrency);
+
+    /**
+     * Update the number of items in flight per worker, then the number of workers.
+     * @param current_service_time the newest service time
+     */
+    void onNewServiceTime(double current_service_time) override;
+
     void pauseWorkers(size_t fromIndex, size_t toIndex) override;
 
     void unpauseWorkers(size_t fromIndex, size_t toIndex) override;
@@ -47,15 +158,58 @@ public:
 
     long getWorkerServiceTime() override;
 
+    size_t getNumArrivals() override;
+
+    size_t getNumCompleted() override;
+
+    size_t getBacklog() override {
+        return main_stream.spilled();
+    }
+
+    double getPriorityArrivalTime() override {
+        return atomic_priority_arrival_time;
+    }
+
+    size_t getUsefulNumWorkers() override {
+        return main_stream.usefulWorkers();
+    }
+
 private:
     // input stream of this node pool
     Stream<InputType> main_stream;
 
     // arrival time computation
     std::atomic<long> atomic_arrival_time;
+    std::atomic<size_t> atomic_num_arrivals = 0;
     std::chrono::system_clock::time_point last_arrival_timepoint;
 
-    std::atomic<double> atomic_worker_service_time;
+    bool spilling = false;
+    bool shedding = false;
+    bool tenants = false;
+
+    // priorities of the items, if enabled
+    ClassifyFunType classify;
+    // moving average of the arrival time of the most urgent class, -1 until known
+    std::atomic<double> atomic_priority_arrival_time = -1;
+    std::chrono::system_clock::time_point last_priority_arrival_timepoint;
+
+    // constants
+    // weight of the newest arrival on the arrival time of the most urgent class
+    const double priority_arrival_smoothing = 0.2;
+
+    /**
+     * Track a new arrival of the most urgent class, to compute its arrival time.
+     */
+    void notifyPriorityArrival();
+
+    // items in flight per worker, if the workers are asynchronous
+    std::atomic<size_t> concurrency = 1;
+    size_t max_concurrency = 1;
+
+    /**
+     * Choose the number of items in flight per worker from the time the items run and wait on the running workers.
+     */
+    void adjustConcurrency();
 };
 
 template<typename InputType>
@@ -65,20 +219,69 @@ long AutonomicWorkerPool<InputType>::getArrivalTime() {
 
 template<typename InputType>
 long AutonomicWorkerPool<InputType>::getWorkerServiceTime() {
-    return atomic_worker_service_time;
+    // the running workers may have different speeds, so their service times are combined
+    return std::max(0L, std::lround(this->speeds.combinedServiceTime(num_workers)));
+}
+
+template<typename InputType>
+size_t AutonomicWorkerPool<InputType>::getNumArrivals() {
+    return atomic_num_arrivals;
+}
+
+template<typename InputType>
+size_t AutonomicWorkerPool<InputType>::getNumCompleted() {
+    size_t completed = 0;
+    for (auto &node: this->nodes) completed += node.processed();
+    return completed;
+}
+
+template<typename InputType>
+void AutonomicWorkerPool<InputType>::setAsync(const typename AutonomicWorker<InputType>::AsyncFunType &fun,
+                                              size_t max_concurrency) {
+    this->max_concurrency = std::max<size_t>(1, max_concurrency);
+    for (auto &node: this->nodes) node.setAsync(fun, &concurrency);
+}
+
+template<typename InputType>
+void AutonomicWorkerPool<InputType>::onNewServiceTime(double current_service_time) {
+    if (max_concurrency > 1) adjustConcurrency();
+    Autonomic::onNewServiceTime(current_service_time);
+}
+
+template<typename InputType>
+void AutonomicWorkerPool<InputType>::adjustConcurrency() {
+    double run_ms = 0, blocked_ms = 0;
+    size_t measured = 0;
+    for (size_t i = 0; i < num_workers; ++i) {
+        auto &node = this->nodes[this->speeds.at(i)];
+        if (node.asyncRunTime() < 0) continue;
+        run_ms += node.asyncRunTime();
+        blocked_ms += node.asyncBlockedTime();
+        measured++;
+    }
+    if (measured == 0 || run_ms <= 0) return;
+    // while an item waits, the others fill the thread: one item running and the ones covering its waiting time
+    auto new_concurrency = std::clamp<size_t>((size_t) std::ceil((run_ms + blocked_ms) / run_ms), 1, max_concurrency);
+    if (new_concurrency == concurrency) return;
+    concurrency = new_concurrency;
+    analytics->concurrency.emplace_back(new_concurrency, ELAPSED(analytics->farm_start_time, currentTime(), std::chrono::milliseconds));
 }
 
 template<typename InputType>
 void AutonomicWorkerPool<InputType>::unpauseWorkers(size_t fromIndex, size_t toIndex) {
+    // the fastest paused workers are unpaused first
+    this->speeds.reorder(num_workers);
     for (size_t i = fromIndex; i <= toIndex; ++i) {
-        this->nodes[i].unpause();
+        this->nodes[this->speeds.at(i)].unpause();
     }
 }
 
 template<typename InputType>
 void AutonomicWorkerPool<InputType>::pauseWorkers(size_t fromIndex, size_t toIndex) {
+    // the slowest running workers are paused first
+    this->speeds.reorder(num_workers);
     for (size_t i = fromIndex; i <= toIndex; ++i) {
-        this->nodes[i].pause();
+        this->nodes[this->speeds.at(i)].pause();
     }
 }
 
@@ -93,24 +296,54 @@ AutonomicWorkerPool<InputType>::AutonomicWorkerPool(size_t num_workers, const Wo
         }
     };
     this->init(max_num_workers, workerFun, &main_stream, onExit);
-    this->nodes[0].setAsReference(&atomic_worker_service_time);
+    this->trackSpeeds();
 }
 
 template<typename InputType>
 void AutonomicWorkerPool<InputType>::run() {
+    // only the initial number of workers pulls items, the others wait to be unpaused
+    if (this->num_workers < max_num_workers) pauseWorkers(this->num_workers, max_num_workers - 1);
     NodePool<InputType, AutonomicWorker<InputType>>::run();
 
     analytics->num_workers.emplace_back(this->num_workers, 0);
+    if (max_concurrency > 1) analytics->concurrency.emplace_back(concurrency, 0);
     // initialize the arrival time
     last_change = analytics->farm_start_time;
     last_arrival_timepoint = analytics->farm_start_time;
+    last_priority_arrival_timepoint = analytics->farm_start_time;
 }
 
 template<typename InputType>
 void AutonomicWorkerPool<InputType>::send(InputType &value) {
+    sendTagged(value, 0);
+}
+
+template<typename InputType>
+void AutonomicWorkerPool<InputType>::sendTagged(InputType &value, uint32_t tag) {
+    if (classify) {
+        // the item is moved into the stream, so it is classified before
+        auto priority = classify(value);
+        main_stream.add(value, tag, priority);
+        if (priority.priority_class == 0) notifyPriorityArrival();
+    } else {
+        main_stream.add(value, tag);
+    }
+    notifyArrival();
+}
+
+template<typename InputType>
+void AutonomicWorkerPool<InputType>::notifyPriorityArrival() {
     START(now);
+    auto elapsed = (double) ELAPSED(last_priority_arrival_timepoint, now, std::chrono::milliseconds);
+    double previous = atomic_priority_arrival_time;
+    atomic_priority_arrival_time = previous < 0 ? elapsed:priority_arrival_smoothing * elapsed + (1 - priority_arrival_smoothing) * previous;
+    last_priority_arrival_timepoint = now;
+}
 
-    main_stream.add(value);
+template<typename InputType>
+void AutonomicWorkerPool<InputType>::notifyArrival() {
+    START(now);
+    atomic_num_arrivals++;
 
     auto elapsed = ELAPSED(last_arrival_timepoint, now, std::chrono::milliseconds);
     atomic_arrival_time = elapsed;
@@ -118,6 +351,20 @@ void AutonomicWorkerPool<InputType>::send(InputType &value) {
     last_arrival_timepoint = now;
 }
 
+template<typename InputType>
+void AutonomicWorkerPool<InputType>::wait() {
+    NodePool<InputType, AutonomicWorker<InputType>>::wait();
+    if (spilling) analytics->spill = main_stream.spillStats();
+    if (shedding) analytics->shedding = main_stream.shedStats();
+    if (classify) {
+        for (auto &node: this->nodes) class_latency::merge(analytics->latency_by_class, node.classLatencies());
+    }
+    if (tenants) {
+        tenant_stats::merge(analytics->tenants, main_stream.tenantStats());
+        for (auto &node: this->nodes) tenant_stats::merge(analytics->tenants, node.tenantStats());
+    }
+}
+
 template<typename InputType>
 void AutonomicWorkerPool<InputType>::notify_eos() {
     main_stream.eos();
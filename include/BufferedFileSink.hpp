@@ -0,0 +1,315 @@
+#ifndef AUTONOMICFARM_BUFFEREDFILESINK_HPP
+#define AUTONOMICFARM_BUFFEREDFILESINK_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * How a sink wrote the results to its file.
+ */
+struct sink_stats {
+    size_t bytes = 0; // bytes written
+    size_t writes = 0; // write calls of the writer thread
+    long write_ns = 0; // time spent writing by the writer thread
+    size_t stalls = 0; // times the gatherer found both buffers full and waited for the writer
+    long stall_ns = 0; // time the gatherer waited for the writer
+    bool direct = false; // true if the file was written bypassing the page cache
+
+    /**
+     * @return the write throughput, in megabytes per second of writing
+     */
+    double write_mb_per_s() const {
+        return write_ns > 0 ? (double) bytes / 1e6 / ((double) write_ns / 1e9):0;
+    }
+};
+
+/**
+ * A sink writing the results of a farm to a file without blocking the gatherer on the disk. The gatherer serializes
+ * every result into one of two buffers, and when it is full hands it to a writer thread, which writes it with a single
+ * large sequential write while the gatherer fills the other buffer. The gatherer waits only when the writer is still
+ * writing the other buffer. With the direct mode the file is opened with O_DIRECT, bypassing the page cache, and the
+ * buffers are written in whole blocks.
+ * @tparam T the type of the results
+ */
+template<typename T>
+class BufferedFileSink {
+public:
+    // write the serialized result into the given room and return its size, which is more than the room if it doesn't fit
+    using SerializeFunType = std::function<size_t(const T&, char*, size_t)>;
+
+    /**
+     * Open the file and start the writer thread.
+     * @param path the path of the file, truncated if it exists
+     * @param buffer_size the size of each of the two buffers, rounded up to whole blocks, at least two with the direct
+     * mode
+     * @param direct true to bypass the page cache, if the file system supports it
+     * @param serialize the serialization of a result, by default a line of text for the arithmetic types
+     * @throws std::runtime_error if the file cannot be opened
+     * @throws std::bad_alloc if the buffers cannot be allocated
+     */
+    explicit BufferedFileSink(const std::string &path, size_t buffer_size = 1 << 20, bool direct = false,
+                              const SerializeFunType &serialize = SerializeFunType());
+
+    BufferedFileSink(const BufferedFileSink&) = delete;
+    BufferedFileSink& operator=(const BufferedFileSink&) = delete;
+
+    ~BufferedFileSink();
+
+    /**
+     * Serialize a result into the current buffer, handing the buffer to the writer once it is full. A result larger
+     * than a buffer is serialized apart and spans as many buffers as needed, since the gatherer calling this cannot
+     * handle an exception.
+     * @param value the result
+     */
+    void write(const T &value);
+
+    /**
+     * @return the function to give to a farm as its sink. The sink must outlive the farm's gatherer
+     */
+    std::function<void(T&)> sendOut() {
+        return [this](T &value) { write(value); };
+    }
+
+    /**
+     * Write the results left in the buffers and close the file. It must be called once the farm finished.
+     * @throws std::runtime_error if a write failed
+     */
+    void close();
+
+    /**
+     * @return how the results were written, complete once closed
+     */
+    const sink_stats& stats() const {
+        return statistics;
+    }
+
+private:
+    // size of the blocks of O_DIRECT writes, and alignment of the buffers
+    static constexpr size_t block_size = 4096;
+
+    struct free_deleter {
+        void operator()(char* buffer) const {
+            std::free(buffer);
+        }
+    };
+
+    int fd = -1;
+    size_t capacity;
+    SerializeFunType serialize;
+    std::unique_ptr<char, free_deleter> buffers[2];
+    // buffer filled by the gatherer, and bytes in it
+    char* current;
+    size_t used = 0;
+    // buffer handed to the writer, if writing
+    char* pending = nullptr;
+    size_t pending_size = 0;
+    bool writing = false;
+    bool closing = false;
+    std::string error;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread writer;
+    sink_stats statistics;
+
+    /**
+     * Hand the current buffer to the writer, once it is done with the other one, and go on with the other one.
+     */
+    void flip();
+
+    void writer_fun();
+
+    /**
+     * Copy the given bytes into the buffers, handing each one filled to the writer.
+     */
+    void append(const char* data, size_t size);
+
+    /**
+     * Write a whole buffer to the file, retrying the partial writes.
+     * @return false if the write failed
+     */
+    bool writeAll(const char* data, size_t size);
+
+    /**
+     * Write a result as a line of text.
+     */
+    static size_t textLine(const T &value, char* out, size_t room);
+};
+
+template<typename T>
+BufferedFileSink<T>::BufferedFileSink(const std::string &path, size_t buffer_size, bool direct,
+                                      const SerializeFunType &serialize)
+: capacity(std::max<size_t>(direct ? 2 * block_size:block_size, (buffer_size + block_size - 1) / block_size * block_size)),
+  serialize(serialize ? serialize:SerializeFunType(&BufferedFileSink::textLine)) {
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    if (direct) {
+        fd = open(path.c_str(), flags | O_DIRECT, 0644);
+        // not every file system supports it: write through the page cache then
+        statistics.direct = fd >= 0;
+    }
+    if (fd < 0) fd = open(path.c_str(), flags, 0644);
+    if (fd < 0) throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+
+    for (auto &buffer: buffers) {
+        buffer.reset(static_cast<char*>(std::aligned_alloc(block_size, capacity)));
+        if (!buffer) {
+            ::close(fd);
+            throw std::bad_alloc();
+        }
+    }
+    current = buffers[0].get();
+    writer = std::thread(&BufferedFileSink::writer_fun, this);
+}
+
+template<typename T>
+BufferedFileSink<T>::~BufferedFileSink() {
+    try {
+        close();
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+template<typename T>
+void BufferedFileSink<T>::write(const T &value) {
+    size_t size = serialize(value, current + used, capacity - used);
+    if (size > capacity - used) {
+        flip();
+        size = serialize(value, current + used, capacity - used);
+        if (size > capacity - used) {
+            std::vector<char> large(size);
+            serialize(value, large.data(), size);
+            append(large.data(), size);
+            return;
+        }
+    }
+    used += size;
+}
+
+template<typename T>
+void BufferedFileSink<T>::append(const char* data, size_t size) {
+    while (size > 0) {
+        if (used == capacity) flip();
+        size_t copied = std::min(size, capacity - used);
+        std::memcpy(current + used, data, copied);
+        used += copied;
+        data += copied;
+        size -= copied;
+    }
+}
+
+template<typename T>
+void BufferedFileSink<T>::flip() {
+    {
+        std::unique_lock lock(mutex);
+        if (writing) {
+            auto stall_from = std::chrono::steady_clock::now();
+            cond.wait(lock, [this]() { return !writing; });
+            statistics.stalls++;
+            statistics.stall_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - stall_from).count();
+        }
+        char* other = current == buffers[0].get() ? buffers[1].get():buffers[0].get();
+        // direct writes are made of whole blocks: the partial block left goes at the beginning of the other buffer
+        size_t carry = statistics.direct ? used % block_size:0;
+        std::memcpy(other, current + used - carry, carry);
+        pending = current;
+        pending_size = used - carry;
+        writing = pending_size > 0;
+        current = other;
+        used = carry;
+    }
+    cond.notify_all();
+}
+
+template<typename T>
+void BufferedFileSink<T>::writer_fun() {
+    std::unique_lock lock(mutex);
+    while (true) {
+        cond.wait(lock, [this]() { return writing || closing; });
+        if (!writing) break;
+        auto data = pending;
+        auto size = pending_size;
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        bool written = writeAll(data, size);
+        long elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        lock.lock();
+        statistics.write_ns += elapsed;
+        if (!written && error.empty()) error = std::strerror(errno);
+        writing = false;
+        cond.notify_all();
+    }
+}
+
+template<typename T>
+bool BufferedFileSink<T>::writeAll(const char* data, size_t size) {
+    while (size > 0) {
+        auto written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+        statistics.bytes += written;
+        statistics.writes++;
+    }
+    return true;
+}
+
+template<typename T>
+void BufferedFileSink<T>::close() {
+    if (fd < 0) return;
+    {
+        std::unique_lock lock(mutex);
+        // the writer writes what it was given, then stops
+        cond.wait(lock, [this]() { return !writing; });
+        closing = true;
+    }
+    cond.notify_all();
+    writer.join();
+
+    if (used > 0) {
+        // the last partial block can't be written directly
+        if (statistics.direct) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+        auto start = std::chrono::steady_clock::now();
+        if (!writeAll(current, used) && error.empty()) error = std::strerror(errno);
+        statistics.write_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        used = 0;
+    }
+    ::close(fd);
+    fd = -1;
+    if (!error.empty()) throw std::runtime_error("cannot write the results: " + error);
+}
+
+template<typename T>
+size_t BufferedFileSink<T>::textLine(const T &value, char* out, size_t room) {
+    if constexpr (std::is_arithmetic_v<T>) {
+        auto [end, ec] = std::to_chars(out, out + room, value);
+        // a number is never longer than this
+        if (ec != std::errc() || end == out + room) return room + 64;
+        *end = '\n';
+        return end - out + 1;
+    } else {
+        throw std::invalid_argument("the results have no default serialization, give one to the sink");
+    }
+}
+
+#endif //AUTONOMICFARM_BUFFEREDFILESINK_HPP
@@ -0,0 +1,266 @@
+#ifndef AUTONOMICFARM_COMPLETION_HPP
+#define AUTONOMICFARM_COMPLETION_HPP
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <span>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+
+/**
+ * A fixed set of slots, each one holding the result of a task submitted to a farm until the submitter takes it. The
+ * slots are allocated once: submitting a task takes a free slot, the worker computing the task writes the result into
+ * it and wakes the submitter up through the slot's atomic state, without any lock or allocation. When every slot is in
+ * use, submitting waits for a result to be taken.
+ * @tparam T the type of the results
+ */
+template <typename T>
+class CompletionSlots {
+public:
+    /**
+     * @param capacity the maximum number of tasks in flight
+     */
+    explicit CompletionSlots(size_t capacity);
+
+    /**
+     * Take a free slot, waiting for one if all are in use.
+     * @return the index of the slot
+     */
+    uint32_t acquire();
+
+    /**
+     * Write the result of a task into its slot and wake up the submitter.
+     * @param index the index of the slot
+     * @param value the result of the task
+     */
+    void complete(uint32_t index, const T &value);
+
+    /**
+     * Tell the submitter that the task of a slot was dropped and will have no result.
+     * @param index the index of the slot
+     */
+    void drop(uint32_t index);
+
+    /**
+     * @param index the index of the slot
+     * @return true if the result of the slot was written, or the task was dropped
+     */
+    [[nodiscard]] bool ready(uint32_t index) const {
+        auto state = slots[index].state.load(std::memory_order_acquire);
+        return state == completed || state == dropped;
+    }
+
+    /**
+     * Wait for the result of a slot, then free the slot.
+     * @param index the index of the slot
+     * @return the result of the task
+     * @throws std::runtime_error if the task was dropped
+     */
+    T take(uint32_t index);
+
+    /**
+     * Give up the result of a slot: the slot is freed once the result is written, or now if it was written already.
+     * @param index the index of the slot
+     */
+    void abandon(uint32_t index);
+
+    /**
+     * Wait until a result of the given slots is written.
+     * @param indexes the indexes of the slots
+     * @return the position in indexes of a slot whose result was written
+     */
+    size_t waitAny(std::span<const uint32_t> indexes);
+
+    [[nodiscard]] size_t capacity() const {
+        return num_slots;
+    }
+
+private:
+    enum slot_state : uint32_t { empty, pending, completed, abandoned, dropped };
+
+    struct alignas(64) slot {
+        std::atomic<uint32_t> state = empty;
+        std::optional<T> value;
+    };
+
+    std::unique_ptr<slot[]> slots;
+    size_t num_slots;
+    // where the search for a free slot begins, to use the slots in turn
+    std::atomic<size_t> cursor = 0;
+    // incremented on every result written and every slot freed, to wait for any of them
+    std::atomic<uint32_t> completions = 0;
+    std::atomic<uint32_t> releases = 0;
+
+    void release(uint32_t index);
+};
+
+/**
+ * The result of a task submitted to a farm, to be taken once.
+ * @tparam T the type of the result
+ */
+template <typename T>
+class completion_future {
+public:
+    completion_future() = default;
+    completion_future(CompletionSlots<T>* slots, uint32_t index) : slots(slots), index(index) {}
+    completion_future(completion_future &&other) noexcept : slots(std::exchange(other.slots, nullptr)), index(other.index) {}
+    completion_future& operator=(completion_future &&other) noexcept {
+        if (this != &other) {
+            reset();
+            slots = std::exchange(other.slots, nullptr);
+            index = other.index;
+        }
+        return *this;
+    }
+    completion_future(const completion_future&) = delete;
+    completion_future& operator=(const completion_future&) = delete;
+
+    ~completion_future() {
+        reset();
+    }
+
+    /**
+     * @return true if the result is available, hence get() doesn't wait
+     */
+    [[nodiscard]] bool ready() const {
+        return slots != nullptr && slots->ready(index);
+    }
+
+    /**
+     * @return true if the result can still be taken
+     */
+    [[nodiscard]] bool valid() const {
+        return slots != nullptr;
+    }
+
+    /**
+     * Wait for the result and take it. The future is not valid anymore.
+     * @return the result of the task
+     * @throws std::runtime_error if the task was dropped by the admission control of the farm
+     */
+    T get() {
+        if (slots == nullptr) throw std::logic_error("the result was already taken");
+        return std::exchange(slots, nullptr)->take(index);
+    }
+
+    /**
+     * Wait until one of the given futures has its result available. The futures must come from the same farm, and be
+     * at most 64.
+     * @param futures the futures to wait for
+     * @return the position of a ready future, or futures.size() if none of them is valid
+     */
+    static size_t waitAny(std::span<completion_future> futures);
+
+private:
+    CompletionSlots<T>* slots = nullptr;
+    uint32_t index = 0;
+
+    void reset() {
+        if (slots != nullptr) std::exchange(slots, nullptr)->abandon(index);
+    }
+};
+
+template <typename T>
+CompletionSlots<T>::CompletionSlots(size_t capacity)
+: slots(std::make_unique<slot[]>(std::max<size_t>(1, capacity))), num_slots(std::max<size_t>(1, capacity)) {}
+
+template <typename T>
+uint32_t CompletionSlots<T>::acquire() {
+    while (true) {
+        auto seen_releases = releases.load(std::memory_order_acquire);
+        size_t start = cursor.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < num_slots; ++i) {
+            auto index = (uint32_t) ((start + i) % num_slots);
+            uint32_t expected = empty;
+            if (slots[index].state.compare_exchange_strong(expected, pending, std::memory_order_acquire)) return index;
+        }
+        // every slot is in use: wait for one to be freed
+        releases.wait(seen_releases, std::memory_order_acquire);
+    }
+}
+
+template <typename T>
+void CompletionSlots<T>::complete(uint32_t index, const T &value) {
+    auto &completing = slots[index];
+    completing.value = value;
+    if (completing.state.exchange(completed, std::memory_order_acq_rel) == abandoned) {
+        // nobody will take the result
+        release(index);
+        return;
+    }
+    completing.state.notify_all();
+    completions.fetch_add(1, std::memory_order_release);
+    completions.notify_all();
+}
+
+template <typename T>
+void CompletionSlots<T>::drop(uint32_t index) {
+    auto &dropping = slots[index];
+    if (dropping.state.exchange(dropped, std::memory_order_acq_rel) == abandoned) {
+        release(index);
+        return;
+    }
+    dropping.state.notify_all();
+    completions.fetch_add(1, std::memory_order_release);
+    completions.notify_all();
+}
+
+template <typename T>
+T CompletionSlots<T>::take(uint32_t index) {
+    auto &taken = slots[index];
+    taken.state.wait(pending, std::memory_order_acquire);
+    if (taken.state.load(std::memory_order_acquire) == dropped) {
+        release(index);
+        throw std::runtime_error("the task was dropped before being computed");
+    }
+    T value = std::move(*taken.value);
+    release(index);
+    return value;
+}
+
+template <typename T>
+void CompletionSlots<T>::abandon(uint32_t index) {
+    uint32_t expected = pending;
+    if (!slots[index].state.compare_exchange_strong(expected, abandoned, std::memory_order_acq_rel)) release(index);
+}
+
+template <typename T>
+void CompletionSlots<T>::release(uint32_t index) {
+    slots[index].value.reset();
+    slots[index].state.store(empty, std::memory_order_release);
+    releases.fetch_add(1, std::memory_order_release);
+    releases.notify_all();
+}
+
+template <typename T>
+size_t CompletionSlots<T>::waitAny(std::span<const uint32_t> indexes) {
+    while (true) {
+        auto seen_completions = completions.load(std::memory_order_acquire);
+        for (size_t i = 0; i < indexes.size(); ++i) {
+            if (ready(indexes[i])) return i;
+        }
+        completions.wait(seen_completions, std::memory_order_acquire);
+    }
+}
+
+template <typename T>
+size_t completion_future<T>::waitAny(std::span<completion_future> futures) {
+    // the indexes of the valid futures, and their position
+    uint32_t indexes[64];
+    size_t positions[64];
+    size_t count = 0;
+    CompletionSlots<T>* slots = nullptr;
+    for (size_t i = 0; i < futures.size() && count < 64; ++i) {
+        if (!futures[i].valid()) continue;
+        slots = futures[i].slots;
+        indexes[count] = futures[i].index;
+        positions[count++] = i;
+    }
+    if (count == 0) return futures.size();
+    return positions[slots->waitAny(std::span<const uint32_t>(indexes, count))];
+}
+
+#endif //AUTONOMICFARM_COMPLETION_HPP
@@ -0,0 +1,243 @@
+#ifndef AUTONOMICFARM_CONTROLLERMETRICS_HPP
+#define AUTONOMICFARM_CONTROLLERMETRICS_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * How a load change was handled by the controller: how long the service time took to settle into the target band and
+ * how far it went from the target meanwhile.
+ */
+struct load_change {
+    // point in time of the change, relative to the beginning of the farm (milliseconds). The first change is the start
+    long time = 0;
+    // mean arrival time after the change (milliseconds)
+    double arrival_time = 0;
+    // time from the change until the service time entered the target band for the last time. Negative if it never did
+    long settling_time = -1;
+    // largest distance of the service time below the band (the farm faster than needed: too many workers)
+    double overshoot = 0;
+    // largest distance of the service time above the band (the farm slower than needed: too few workers)
+    double undershoot = 0;
+};
+
+/**
+ * Outcome of the calibration of the initial number of workers.
+ */
+struct calibration_report {
+    // tasks measured, zero if the calibration was disabled
+    size_t tasks = 0;
+    // point in time when the calibration set the number of workers (milliseconds), -1 if it didn't end
+    long end_time = -1;
+    // mean service time of a worker measured (milliseconds)
+    double worker_service_time = 0;
+    // mean arrival time measured (milliseconds)
+    double arrival_time = 0;
+    // number of workers set by the calibration
+    size_t num_workers = 0;
+    // time between the calibration and the earliest decision of the regular control loop (milliseconds). It is a lower
+    // bound of the convergence time saved, since the regular loop may need more decisions to converge. Zero when the
+    // calibration ended after that decision
+    long saved_time = 0;
+};
+
+/**
+ * Summary of how well the autonomic controller behaved. The counters are updated by the controller while the farm runs,
+ * the rest is computed at the end of the run from the analytics.
+ */
+struct controller_metrics {
+    // updated live by the controller
+    size_t reconfigurations = 0;
+    // number of times the number of workers changed direction, from increasing to decreasing or vice versa
+    size_t oscillations = 0;
+    // worker-seconds consumed up to the last reconfiguration
+    double worker_seconds = 0.0;
+    // direction of the last reconfiguration: 1 increase, -1 decrease, 0 none yet
+    int last_direction = 0;
+    // maximum distance of the service time from the target to be inside the band (milliseconds)
+    double max_error = 1.0;
+    calibration_report calibration;
+
+    // computed at the end of the run
+    // time spent with the service time outside the target band (milliseconds)
+    long time_outside_band = 0;
+    // time covered by the service time measurements (milliseconds)
+    long monitored_time = 0;
+    double overshoot = 0;
+    double undershoot = 0;
+    std::vector<load_change> load_changes;
+
+    /**
+     * Update the live counters with a new number of workers.
+     * @param old_num_workers the number of workers before the change
+     * @param new_num_workers the number of workers after the change
+     * @param elapsed_ms the time spent with the old number of workers (milliseconds)
+     */
+    void onReconfiguration(size_t old_num_workers, size_t new_num_workers, long elapsed_ms);
+
+    /**
+     * Complete the metrics at the end of the run.
+     * @param service_time the moving average of the service time, pairs <service time, timestamp>
+     * @param num_workers the history of the number of workers, pairs <number of workers, timestamp>
+     * @param arrival_time the timestamps of the arrivals
+     * @param target_service_time the target service time, zero if the target is the arrival time
+     * @param end_time the end of the run, relative to the beginning of the farm (milliseconds)
+     */
+    void complete(const std::vector<std::pair<double, long>> &service_time,
+                  const std::vector<std::pair<size_t, long>> &num_workers, const std::vector<long> &arrival_time,
+                  double target_service_time, long end_time);
+
+    /**
+     * Find the points in time when the arrival rate changes, by comparing the mean arrival time of consecutive windows
+     * of arrivals with the mean of the current level. A change must be confirmed by two consecutive windows, so that the
+     * noise of random arrivals isn't taken for a change.
+     * @param arrival_time the timestamps of the arrivals
+     * @return the load changes found, starting from the beginning of the run
+     */
+    static std::vector<load_change> findLoadChanges(const std::vector<long> &arrival_time);
+
+    /**
+     * Find where the arrival rate changes between two arrivals.
+     * @param arrival_time the timestamps of the arrivals
+     * @param begin the index of the first arrival to consider
+     * @param end the index of the last arrival to consider
+     * @return the index of the first arrival of the new load
+     */
+    static size_t splitLoad(const std::vector<long> &arrival_time, size_t begin, size_t end);
+
+    /**
+     * Mean arrival time of the arrivals preceding the given point in time.
+     */
+    static double localArrivalTime(const std::vector<long> &arrival_time, long time);
+
+    // number of arrivals of a window used to detect the load changes
+    static constexpr size_t load_window_size = 64;
+    // relative change of the mean arrival time considered a load change
+    static constexpr double load_change_ratio = 1.25;
+};
+
+void controller_metrics::onReconfiguration(size_t old_num_workers, size_t new_num_workers, long elapsed_ms) {
+    if (new_num_workers == old_num_workers) return;
+    reconfigurations++;
+    int direction = new_num_workers > old_num_workers ? 1:-1;
+    if (last_direction != 0 && direction != last_direction) oscillations++;
+    last_direction = direction;
+    worker_seconds += (double) old_num_workers * (double) elapsed_ms / 1000.0;
+}
+
+void controller_metrics::complete(const std::vector<std::pair<double, long>> &service_time,
+                                  const std::vector<std::pair<size_t, long>> &num_workers,
+                                  const std::vector<long> &arrival_time, double target_service_time, long end_time) {
+    // the workers consumed after the last reconfiguration
+    if (!num_workers.empty()) {
+        worker_seconds += (double) num_workers.back().first * (double) std::max(0L, end_time - num_workers.back().second) / 1000.0;
+    }
+
+    load_changes = findLoadChanges(arrival_time);
+    time_outside_band = monitored_time = 0;
+    overshoot = undershoot = 0;
+    size_t change_index = 0;
+    // point in time when the service time last entered the band within the current load
+    long entered_band = -1;
+    for (size_t i = 0; i < service_time.size(); ++i) {
+        auto [value, time] = service_time[i];
+        while (change_index + 1 < load_changes.size() && load_changes[change_index + 1].time <= time) {
+            change_index++;
+            entered_band = -1;
+        }
+        auto &change = load_changes[change_index];
+        double target = target_service_time > 0 ? target_service_time:localArrivalTime(arrival_time, time);
+        if (std::isnan(target)) continue;
+
+        bool inside = std::abs(value - target) < max_error;
+        if (inside && entered_band < 0) entered_band = time;
+        if (!inside) entered_band = -1;
+        change.settling_time = entered_band < 0 ? -1:std::max(0L, entered_band - change.time);
+        change.overshoot = std::max(change.overshoot, target - max_error - value);
+        change.undershoot = std::max(change.undershoot, value - target - max_error);
+
+        // each measurement lasts until the next one
+        long duration = (i + 1 < service_time.size() ? service_time[i + 1].second:end_time) - time;
+        monitored_time += std::max(0L, duration);
+        if (!inside) time_outside_band += std::max(0L, duration);
+    }
+    for (auto &change: load_changes) {
+        overshoot = std::max(overshoot, change.overshoot);
+        undershoot = std::max(undershoot, change.undershoot);
+    }
+}
+
+std::vector<load_change> controller_metrics::findLoadChanges(const std::vector<long> &arrival_time) {
+    std::vector<load_change> changes;
+    changes.push_back(load_change());
+    if (arrival_time.size() < 2 * load_window_size) return changes;
+
+    // sum and count of the windows of the current load, and the first window of a change not confirmed yet
+    double level_sum = 0;
+    size_t level_windows = 0;
+    long pending_begin = -1;
+    double pending_mean = 0;
+    for (size_t begin = 0; begin + load_window_size < arrival_time.size(); begin += load_window_size) {
+        double mean = (double) (arrival_time[begin + load_window_size] - arrival_time[begin]) / load_window_size;
+        double level = level_windows == 0 ? mean:level_sum / (double) level_windows;
+        bool changed = level > 0 && (mean > level * load_change_ratio || mean < level / load_change_ratio);
+        if (!changed) {
+            pending_begin = -1;
+            level_sum += mean;
+            level_windows++;
+        } else if (pending_begin < 0) {
+            pending_begin = (long) begin;
+            pending_mean = mean;
+        } else {
+            // confirmed: the new load begins around the first window that changed
+            load_change change;
+            change.time = arrival_time[splitLoad(arrival_time, std::max(0L, pending_begin - (long) load_window_size),
+                                                 begin + load_window_size)];
+            changes.push_back(change);
+            level_sum = pending_mean + mean;
+            level_windows = 2;
+            pending_begin = -1;
+        }
+    }
+    // the mean arrival time of each load
+    for (size_t i = 0; i < changes.size(); ++i) {
+        long end = i + 1 < changes.size() ? changes[i + 1].time:arrival_time.back();
+        auto first = std::lower_bound(arrival_time.begin(), arrival_time.end(), changes[i].time);
+        auto last = std::upper_bound(arrival_time.begin(), arrival_time.end(), end);
+        auto count = std::distance(first, last);
+        changes[i].arrival_time = count > 1 ? (double) (*(last - 1) - *first) / (double) (count - 1):0;
+    }
+    return changes;
+}
+
+size_t controller_metrics::splitLoad(const std::vector<long> &arrival_time, size_t begin, size_t end) {
+    // the split minimizes the squared error of the arrival times around the mean of their side
+    size_t best = begin + 1;
+    double best_error = INFINITY;
+    for (size_t split = begin + 1; split < end; ++split) {
+        double error = 0;
+        for (auto [from, to]: { std::pair(begin, split), std::pair(split, end) }) {
+            double mean = (double) (arrival_time[to] - arrival_time[from]) / (double) (to - from);
+            for (size_t i = from; i < to; ++i) {
+                double gap = (double) (arrival_time[i + 1] - arrival_time[i]) - mean;
+                error += gap * gap;
+            }
+        }
+        if (error < best_error) {
+            best_error = error;
+            best = split;
+        }
+    }
+    return best;
+}
+
+double controller_metrics::localArrivalTime(const std::vector<long> &arrival_time, long time) {
+    const long window = 10;
+    long index = std::upper_bound(arrival_time.begin(), arrival_time.end(), time) - arrival_time.begin();
+    long begin = std::max(0L, index - window);
+    if (index - begin < 2) return NAN;
+    return (double) (arrival_time[index - 1] - arrival_time[begin]) / (double) (index - 1 - begin);
+}
+
+#endif //AUTONOMICFARM_CONTROLLERMETRICS_HPP
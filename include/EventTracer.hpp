@@ -0,0 +1,346 @@
+#ifndef AUTONOMICFARM_EVENTTRACER_HPP
+#define AUTONOMICFARM_EVENTTRACER_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * The typed events recorded by the tracer.
+ */
+enum class trace_event : uint32_t {
+    // an item entered the farm, the value is its index
+    enqueue,
+    // a node took an item from its input stream
+    dequeue,
+    // a node began and finished computing an item, the value is the number of items it computed before
+    task_start,
+    task_end,
+    // a worker was paused and unpaused by the autonomic controller
+    pause,
+    unpause,
+    // the autonomic controller changed the number of workers, the value is the new number of workers
+    decision,
+    // a node reached the end-of-stream
+    eos
+};
+
+/**
+ * Records typed events into a ring buffer owned by each thread, cheap enough to leave in the hot paths of the farm:
+ * when the tracer is disabled an event costs a relaxed load, when it is enabled a timestamp counter read and a store
+ * into the ring of the calling thread, without any lock or shared write. Once the ring of a thread is full, the newest
+ * events overwrite the oldest ones. The rings are dumped at the end of the run as a Chrome trace (JSON), to be opened
+ * with Perfetto or chrome://tracing and look at the workers and the reconfigurations on a timeline. The slices whose
+ * beginning was overwritten, or whose end was not recorded yet, are left out of the dump.
+ */
+class EventTracer {
+public:
+    /**
+     * Start recording the events.
+     * @param capacity_per_thread the number of events kept by each thread, rounded up to a power of two
+     */
+    static void enable(size_t capacity_per_thread = 1 << 16);
+
+    /**
+     * Stop recording the events. The events already recorded are kept.
+     */
+    static void disable() {
+        active = false;
+    }
+
+    /**
+     * @return true if the events are being recorded
+     */
+    static bool enabled() {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Record an event of the calling thread, if the tracer is enabled.
+     * @param event the type of the event
+     * @param value the value of the event, whose meaning depends on the type
+     */
+    static void record(trace_event event, int32_t value = 0) {
+        if (!enabled()) return;
+        auto ring = thread_ring != nullptr ? thread_ring:registerThread();
+        // either the dump sees the ring busy and waits for the write, or the write sees the tracer disabled
+        ring->busy.store(true, std::memory_order_seq_cst);
+        if (active.load(std::memory_order_seq_cst)) {
+            auto head = ring->head.load(std::memory_order_relaxed);
+            ring->records[head & ring->mask] = { ticks(), event, value };
+            ring->head.store(head + 1, std::memory_order_release);
+        }
+        ring->busy.store(false, std::memory_order_release);
+    }
+
+    /**
+     * Give a name to the calling thread, shown on its timeline.
+     * @param name the name of the thread
+     */
+    static void nameThread(const std::string &name);
+
+    /**
+     * Stop recording the events, wait for the events being recorded, then write the events recorded so far as a Chrome
+     * trace.
+     * @param path the path of the JSON file
+     * @return true if the file was written
+     */
+    static bool dump(const std::string &path);
+
+    /**
+     * Dump the events when the process is interrupted by SIGINT or SIGTERM, then terminate it. The signal handler only
+     * writes the signal into a pipe, and a thread of the tracer reads it and writes the dump, since the dump locks and
+     * allocates, which is not safe inside a signal handler.
+     * @param path the path of the JSON file
+     */
+    static void dumpOnSignal(const std::string &path);
+
+private:
+    struct record_type {
+        uint64_t ticks;
+        trace_event event;
+        int32_t value;
+    };
+
+    struct ring_type {
+        std::unique_ptr<record_type[]> records;
+        size_t mask;
+        std::atomic<uint64_t> head = 0;
+        // true while the thread writes an event
+        std::atomic<bool> busy = false;
+        std::string name;
+    };
+
+    inline static std::atomic<bool> active = false;
+    inline static size_t capacity = 0;
+    // the rings outlive their threads, to be dumped at the end
+    inline static std::mutex rings_mutex;
+    inline static std::vector<std::unique_ptr<ring_type>> rings;
+    inline static thread_local ring_type* thread_ring = nullptr;
+    // the timestamp counter and the clock when the tracer was enabled, to convert the counter into time
+    inline static uint64_t start_ticks = 0;
+    inline static std::chrono::steady_clock::time_point start_time;
+    inline static std::string signal_dump_path;
+    // written by the signal handler, read by the thread dumping the events
+    inline static int signal_pipe[2] = { -1, -1 };
+
+    /**
+     * @return the current value of the timestamp counter, or of a nanoseconds clock where there is none
+     */
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static ring_type* registerThread();
+
+    /**
+     * @return the events of a ring to dump: the slices missing their beginning or their end are left out
+     */
+    static std::vector<record_type> matchedRecords(const ring_type &ring);
+
+    /**
+     * Write a string as a JSON string, quoted and escaped.
+     */
+    static void writeJsonString(std::ostream &os, const std::string &text);
+
+    static void onSignal(int signal);
+
+    /**
+     * Wait for a signal written into the pipe, then dump the events and terminate the process.
+     */
+    static void dumpWhenSignaled();
+};
+
+void EventTracer::enable(size_t capacity_per_thread) {
+    std::lock_guard lock(rings_mutex);
+    capacity = 1;
+    while (capacity < capacity_per_thread) capacity <<= 1;
+    start_time = std::chrono::steady_clock::now();
+    start_ticks = ticks();
+    active = true;
+}
+
+EventTracer::ring_type* EventTracer::registerThread() {
+    std::lock_guard lock(rings_mutex);
+    auto ring = std::make_unique<ring_type>();
+    ring->records = std::make_unique<record_type[]>(capacity);
+    ring->mask = capacity - 1;
+    ring->name = "thread " + std::to_string(rings.size());
+    thread_ring = ring.get();
+    rings.push_back(std::move(ring));
+    return thread_ring;
+}
+
+void EventTracer::nameThread(const std::string &name) {
+    if (!enabled()) return;
+    auto ring = thread_ring != nullptr ? thread_ring:registerThread();
+    std::lock_guard lock(rings_mutex);
+    ring->name = name;
+}
+
+std::vector<EventTracer::record_type> EventTracer::matchedRecords(const ring_type &ring) {
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    uint64_t first = head > ring.mask + 1 ? head - ring.mask - 1:0;
+    std::vector<record_type> records;
+    records.reserve(head - first);
+    // position in records of the beginning of the open task and pause slices, -1 if none is open
+    long open_task = -1, open_pause = -1;
+    std::vector<char> keep;
+    keep.reserve(head - first);
+    for (uint64_t i = first; i < head; ++i) {
+        auto &record = ring.records[i & ring.mask];
+        bool kept = true;
+        switch (record.event) {
+            case trace_event::task_start: open_task = (long) records.size(); break;
+            case trace_event::pause: open_pause = (long) records.size(); break;
+            case trace_event::task_end: kept = open_task >= 0; open_task = -1; break;
+            case trace_event::unpause: kept = open_pause >= 0; open_pause = -1; break;
+            default: break;
+        }
+        records.push_back(record);
+        keep.push_back(kept);
+    }
+    if (open_task >= 0) keep[open_task] = false;
+    if (open_pause >= 0) keep[open_pause] = false;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (keep[i]) records[kept++] = records[i];
+    }
+    records.resize(kept);
+    return records;
+}
+
+void EventTracer::writeJsonString(std::ostream &os, const std::string &text) {
+    os << '"';
+    for (char c: text) {
+        switch (c) {
+            case '"': os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            case '\t': os << "\\t"; break;
+            default:
+                if ((unsigned char) c < 0x20) {
+                    char escaped[7];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned) (unsigned char) c);
+                    os << escaped;
+                } else {
+                    os << c;
+                }
+        }
+    }
+    os << '"';
+}
+
+bool EventTracer::dump(const std::string &path) {
+    disable();
+    // wait for the events being written, so that the rings are not changed while they are read
+    {
+        std::lock_guard lock(rings_mutex);
+        for (auto &ring: rings) {
+            while (ring->busy.load(std::memory_order_acquire)) std::this_thread::yield();
+        }
+    }
+
+    std::ofstream file(path);
+    if (!file.is_open()) return false;
+
+    std::lock_guard lock(rings_mutex);
+    // the timestamp counter runs at a constant rate, measured over the whole trace
+    double elapsed_ns = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_time).count();
+    double elapsed_ticks = (double) (ticks() - start_ticks);
+    double ns_per_tick = elapsed_ticks > 0 ? elapsed_ns / elapsed_ticks:1.0;
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::endl;
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"farm\"}}";
+    for (size_t tid = 0; tid < rings.size(); ++tid) {
+        auto &ring = *rings[tid];
+        file << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid;
+        file << ",\"args\":{\"name\":";
+        writeJsonString(file, ring.name);
+        file << "}}";
+
+        for (auto &record: matchedRecords(ring)) {
+            // Chrome traces are in microseconds
+            double ts = (double) (int64_t) (record.ticks - start_ticks) * ns_per_tick / 1000.0;
+            file << "," << std::endl << "{\"pid\":1,\"tid\":" << tid << ",\"ts\":" << std::fixed << ts << ",";
+            switch (record.event) {
+                case trace_event::enqueue:
+                    file << "\"ph\":\"i\",\"s\":\"t\",\"name\":\"enqueue\",\"args\":{\"item\":" << record.value << "}}";
+                    break;
+                case trace_event::dequeue:
+                    file << "\"ph\":\"i\",\"s\":\"t\",\"name\":\"dequeue\"}";
+                    break;
+                case trace_event::task_start:
+                    file << "\"ph\":\"B\",\"name\":\"task\",\"args\":{\"computed\":" << record.value << "}}";
+                    break;
+                case trace_event::task_end:
+                    file << "\"ph\":\"E\",\"name\":\"task\"}";
+                    break;
+                case trace_event::pause:
+                    file << "\"ph\":\"B\",\"name\":\"paused\"}";
+                    break;
+                case trace_event::unpause:
+                    file << "\"ph\":\"E\",\"name\":\"paused\"}";
+                    break;
+                case trace_event::decision:
+                    file << "\"ph\":\"C\",\"name\":\"num_workers\",\"args\":{\"workers\":" << record.value << "}}";
+                    break;
+                case trace_event::eos:
+                    file << "\"ph\":\"i\",\"s\":\"t\",\"name\":\"eos\"}";
+                    break;
+            }
+        }
+    }
+    file << std::endl << "]}" << std::endl;
+    return file.good();
+}
+
+void EventTracer::dumpOnSignal(const std::string &path) {
+    signal_dump_path = path;
+    if (signal_pipe[0] < 0) {
+        if (pipe(signal_pipe) != 0) throw std::system_error(errno, std::generic_category(), "Cannot create the signal pipe");
+        std::thread(dumpWhenSignaled).detach();
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+}
+
+void EventTracer::onSignal(int signal) {
+    // only async-signal-safe calls here
+    auto number = static_cast<unsigned char>(signal);
+    [[maybe_unused]] auto written = write(signal_pipe[1], &number, 1);
+}
+
+void EventTracer::dumpWhenSignaled() {
+    unsigned char signal;
+    ssize_t bytes;
+    do {
+        bytes = read(signal_pipe[0], &signal, 1);
+    } while (bytes < 0 && errno == EINTR);
+    if (bytes != 1) return;
+    disable();
+    dump(signal_dump_path);
+    _exit(128 + signal);
+}
+
+#endif //AUTONOMICFARM_EVENTTRACER_HPP
@@ -0,0 +1,299 @@
+#ifndef AUTONOMICFARM_FAIRQUEUE_HPP
+#define AUTONOMICFARM_FAIRQUEUE_HPP
+
+#include <deque>
+#include <optional>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include "TaskPriority.hpp"
+
+/**
+ * What a tenant got from a farm shared with other tenants.
+ */
+struct tenant_stats {
+    size_t tasks = 0; // tasks completed
+    double busy_ms = 0; // time the workers spent computing them
+    size_t max_waiting = 0; // most tasks waiting at once
+    size_t max_in_flight = 0; // most tasks computed at once
+    class_latency latency; // latencies from the arrival to the end of the computation
+
+    /**
+     * Add what each tenant got from a worker, or from a queue, to what it got from the farm.
+     * @param tenants the statistics of each tenant of the farm
+     * @param others the statistics of each tenant of the worker or of the queue
+     */
+    static void merge(std::vector<tenant_stats> &tenants, const std::vector<tenant_stats> &others) {
+        if (tenants.size() < others.size()) tenants.resize(others.size());
+        for (size_t i = 0; i < others.size(); ++i) {
+            tenants[i].tasks += others[i].tasks;
+            tenants[i].busy_ms += others[i].busy_ms;
+            tenants[i].max_waiting = std::max(tenants[i].max_waiting, others[i].max_waiting);
+            tenants[i].max_in_flight = std::max(tenants[i].max_in_flight, others[i].max_in_flight);
+            tenants[i].latency.merge(others[i].latency);
+        }
+    }
+
+    /**
+     * Record a task of a tenant completed by a worker, adding the tenants up to it if missing.
+     * @param tenants the statistics of each tenant of the worker
+     * @param tenant the tenant of the task
+     * @param busy_ms the time the worker computed the task
+     * @param latency_ms the time from the arrival of the task to the end of its computation
+     */
+    static void record(std::vector<tenant_stats> &tenants, uint32_t tenant, double busy_ms, double latency_ms) {
+        if (tenants.size() <= tenant) tenants.resize(tenant + 1);
+        tenants[tenant].tasks++;
+        tenants[tenant].busy_ms += busy_ms;
+        tenants[tenant].latency.add(latency_ms);
+    }
+};
+
+/**
+ * A queue shared by many tenants, each one with its own sub-queue ordered by due time, FIFO among the elements due at
+ * the same time, from which the elements are taken with deficit round robin. The cost of an element is the time the
+ * workers spend on an element of its tenant, so that the tenants share the time of the workers in proportion to their
+ * weights, whatever the size of their tasks: a tenant flooding the queue only lengthens its own sub-queue. A tenant can
+ * also be capped to a number of elements in flight, and its elements wait while it has that many. The tenants are
+ * numbered from zero. It is not thread safe.
+ * @tparam T the type of the elements
+ */
+template<typename T>
+class FairQueue {
+public:
+    /**
+     * Set the share of a tenant.
+     * @param tenant the tenant
+     * @param weight the weight of the tenant, one by default
+     */
+    void setWeight(uint32_t tenant, double weight) {
+        at(tenant).weight = std::max(weight, 1e-3);
+    }
+
+    /**
+     * Cap the elements of a tenant taken and not done yet.
+     * @param tenant the tenant
+     * @param max_in_flight the maximum number of elements in flight, zero for no cap
+     */
+    void setCap(uint32_t tenant, size_t max_in_flight) {
+        at(tenant).cap = max_in_flight;
+    }
+
+    /**
+     * Add an element to the sub-queue of its tenant, after the elements due before it or at the same time.
+     * @param tenant the tenant
+     * @param value the element, moved
+     * @param due the point in time by which the element should be taken, the same for every element for FIFO order
+     */
+    void push(uint32_t tenant, T &value, std::chrono::steady_clock::time_point due = {});
+
+    /**
+     * Take the next element, by deficit round robin among the tenants below their cap. The element is in flight until
+     * done or released.
+     * @param tenant set to the tenant of the element, if any
+     * @return the element, or an empty optional if no tenant below its cap has elements waiting
+     */
+    std::optional<T> pop(uint32_t &tenant);
+
+    /**
+     * Take an element of the tenant with the most elements waiting, to drop it: the tenant flooding the queue pays for
+     * the room made. The element is not in flight.
+     * @param tenant set to the tenant of the element, if any
+     * @param due_last true to take the element due last, false for the first one
+     * @return the element, or an empty optional if no element waits
+     */
+    std::optional<T> popLongest(uint32_t &tenant, bool due_last = false);
+
+    /**
+     * Tell that an element of a tenant was computed.
+     * @param tenant the tenant
+     * @param cost the time spent computing the element (milliseconds), negative if unknown
+     */
+    void done(uint32_t tenant, double cost);
+
+    /**
+     * Tell that an element of a tenant left without being computed.
+     * @param tenant the tenant
+     */
+    void release(uint32_t tenant) {
+        auto &state = tenants[tenant];
+        if (state.in_flight > 0) state.in_flight--;
+    }
+
+    size_t size() const {
+        return items;
+    }
+
+    bool empty() const {
+        return items == 0;
+    }
+
+    /**
+     * @return the most workers the tenants with elements waiting or in flight can use, given their caps: the maximum
+     * value of size_t if any of them is not capped
+     */
+    size_t usefulWorkers() const;
+
+    /**
+     * @return the most elements waiting and in flight at once of each tenant
+     */
+    std::vector<tenant_stats> stats() const;
+
+private:
+    struct tenant_state {
+        // elements waiting, ordered by due time
+        std::deque<std::pair<std::chrono::steady_clock::time_point, T>> waiting;
+        double weight = 1;
+        size_t cap = 0;
+        size_t in_flight = 0;
+        // cost the tenant can still spend in its turn, and whether its turn began
+        double deficit = 0;
+        bool in_turn = false;
+        // moving average of the cost of its elements, -1 until known
+        double cost = -1;
+        bool in_round = false;
+        size_t max_waiting = 0;
+        size_t max_in_flight = 0;
+    };
+
+    std::vector<tenant_state> tenants;
+    // tenants with elements waiting, the first one is having its turn
+    std::deque<uint32_t> round;
+    size_t items = 0;
+    // cost given to a tenant of weight one at each turn: the largest cost of an element, so that every turn takes one
+    double quantum = 1;
+
+    // constants
+    // weight of the newest element on the cost of a tenant
+    const double cost_smoothing = 0.2;
+
+    tenant_state& at(uint32_t tenant) {
+        if (tenants.size() <= tenant) tenants.resize(tenant + 1);
+        return tenants[tenant];
+    }
+
+    bool capped(const tenant_state &state) const {
+        return state.cap > 0 && state.in_flight >= state.cap;
+    }
+
+    void nextTurn() {
+        round.push_back(round.front());
+        round.pop_front();
+    }
+
+    /**
+     * Take the first element of a tenant, or the last one, and take the tenant out of the round if it has no more.
+     */
+    T take(uint32_t tenant, bool last = false);
+};
+
+template<typename T>
+void FairQueue<T>::push(uint32_t tenant, T &value, std::chrono::steady_clock::time_point due) {
+    auto &state = at(tenant);
+    // after the elements due at the same time, to keep their order
+    auto position = std::upper_bound(state.waiting.begin(), state.waiting.end(), due,
+                                     [](auto time, const auto &element) { return time < element.first; });
+    state.waiting.emplace(position, due, std::move(value));
+    state.max_waiting = std::max(state.max_waiting, state.waiting.size());
+    items++;
+    if (!state.in_round) {
+        state.in_round = true;
+        round.push_back(tenant);
+    }
+}
+
+template<typename T>
+T FairQueue<T>::take(uint32_t tenant, bool last) {
+    auto &state = tenants[tenant];
+    T value = std::move(last ? state.waiting.back().second:state.waiting.front().second);
+    if (last) state.waiting.pop_back();
+    else state.waiting.pop_front();
+    items--;
+    if (state.waiting.empty()) {
+        // an idle tenant doesn't save up for later
+        state.in_round = false;
+        state.in_turn = false;
+        state.deficit = 0;
+        round.erase(std::find(round.begin(), round.end(), tenant));
+    }
+    return value;
+}
+
+template<typename T>
+std::optional<T> FairQueue<T>::pop(uint32_t &tenant) {
+    // capped tenants met in a row: when every tenant of the round is capped, nothing can be taken
+    size_t capped_in_row = 0;
+    while (!round.empty() && capped_in_row < round.size()) {
+        auto id = round.front();
+        auto &state = tenants[id];
+        if (capped(state)) {
+            // its turn is skipped, without gaining any cost
+            state.in_turn = false;
+            nextTurn();
+            capped_in_row++;
+            continue;
+        }
+        capped_in_row = 0;
+        if (!state.in_turn) {
+            state.in_turn = true;
+            state.deficit += quantum * state.weight;
+        }
+        double cost = state.cost > 0 ? state.cost:quantum;
+        if (state.deficit < cost) {
+            // the cost of its turn was spent: the deficit left goes to its next turn
+            state.in_turn = false;
+            nextTurn();
+            continue;
+        }
+        state.deficit -= cost;
+        state.in_flight++;
+        state.max_in_flight = std::max(state.max_in_flight, state.in_flight);
+        tenant = id;
+        return take(id);
+    }
+    return {};
+}
+
+template<typename T>
+std::optional<T> FairQueue<T>::popLongest(uint32_t &tenant, bool due_last) {
+    if (round.empty()) return {};
+    tenant = *std::max_element(round.begin(), round.end(), [this](uint32_t a, uint32_t b) {
+        return tenants[a].waiting.size() < tenants[b].waiting.size();
+    });
+    return take(tenant, due_last);
+}
+
+template<typename T>
+void FairQueue<T>::done(uint32_t tenant, double cost) {
+    auto &state = tenants[tenant];
+    if (state.in_flight > 0) state.in_flight--;
+    if (cost < 0) return;
+    state.cost = state.cost < 0 ? cost:cost_smoothing * cost + (1 - cost_smoothing) * state.cost;
+    quantum = 0;
+    for (auto &other: tenants) quantum = std::max(quantum, other.cost);
+}
+
+template<typename T>
+size_t FairQueue<T>::usefulWorkers() const {
+    size_t useful = 0;
+    for (auto &state: tenants) {
+        if (state.waiting.empty() && state.in_flight == 0) continue;
+        if (state.cap == 0) return std::numeric_limits<size_t>::max();
+        useful += state.cap;
+    }
+    return useful;
+}
+
+template<typename T>
+std::vector<tenant_stats> FairQueue<T>::stats() const {
+    std::vector<tenant_stats> result(tenants.size());
+    for (size_t i = 0; i < tenants.size(); ++i) {
+        result[i].max_waiting = tenants[i].max_waiting;
+        result[i].max_in_flight = tenants[i].max_in_flight;
+    }
+    return result;
+}
+
+#endif //AUTONOMICFARM_FAIRQUEUE_HPP
@@ -5,6 +5,8 @@
 #include "ThreadedNode.hpp"
 #include "trace.hpp"
 #include "NodePool.hpp"
+#include "Completion.hpp"
+#include "ResultQueue.hpp"
 
 template <typename InputType, typename OutputType>
 class Farm : public Node<InputType> {
@@ -20,6 +22,55 @@ public:
     void wait() override;
     void notify_eos() override;
     void send(InputType& value) override;
+    void sendTagged(InputType& value, uint32_t tag) override;
+
+    /**
+     * Allow to submit items and wait for their results through futures, along with the results reaching the sink
+     * function. It must be called before running the farm.
+     * @param capacity the maximum number of submitted items whose result was not taken yet: submitting more waits
+     */
+    void setSubmitCapacity(size_t capacity);
+
+    /**
+     * Send an item to the farm and get a future of its result. The result is written into the future by the worker
+     * computing the item, and still reaches the sink function.
+     * @param value the reference to the item to send
+     * @return the future of the result
+     */
+    completion_future<OutputType> submit(InputType& value);
+
+    /**
+     * Submit many items, writing a future for each one.
+     * @tparam InputIt the iterator to iterate through the items to submit
+     * @tparam OutputIt the iterator where the futures are written
+     * @param begin iterator pointing to the first item to be submitted
+     * @param end iterator pointing to the item after the last item to be submitted
+     * @param futures iterator where the futures are written, in the same order of the items
+     */
+    template<typename InputIt, typename OutputIt>
+    void submit(InputIt begin, InputIt end, OutputIt futures);
+
+    /**
+     * Let the consumer pull the results from a bounded queue instead of calling the sink function on the gatherer.
+     * The results must be taken by a thread other than the one waiting for the farm, which closes the queue at the
+     * end. It must be called before running the farm.
+     * @param capacity the maximum number of results waiting for the consumer, and for the gatherer: a slower consumer
+     * holds the gatherer, then the workers
+     */
+    void setResultsCapacity(size_t capacity);
+
+    /**
+     * @return the queue of the results, to iterate or to pop them
+     */
+    ResultQueue<OutputType>& results();
+
+    /**
+     * Set how the items are dispatched to the workers. It has no effect on farms whose workers pull the items from a
+     * shared stream.
+     * @param policy the dispatch policy
+     * @param max_pending the maximum number of pending items of a worker, only for the on-demand policy
+     */
+    void setDispatchPolicy(dispatch_policy policy, size_t max_pending = 1);
 
     virtual ~Farm();
 
@@ -28,14 +79,62 @@ protected:
 
     Node<InputType>* workers_pool;
     Node<OutputType>* gatherer;
+    // the function computed by the workers, owned by the farm so that it outlives the caller's one
+    WorkerFunType worker_fun;
+    // the function receiving the results, unless they are pulled from the queue of the results
+    SendOutFunType send_out_fun;
+    // slots of the results of the submitted items, if enabled
+    std::unique_ptr<CompletionSlots<OutputType>> completions;
+    // queue of the results pulled by the consumer, if enabled
+    std::unique_ptr<ResultQueue<OutputType>> result_queue;
+
+    /**
+     * Output a result from the gatherer, to the queue of the results or to the sink function.
+     * @param res the result
+     */
+    void sendOut(OutputType &res) {
+        if (result_queue) result_queue->push(res);
+        else send_out_fun(res);
+    }
+
+    /**
+     * Write the result of an item into its future, if the item was submitted.
+     * @param res the result of the item
+     * @param tag the tag of the item, zero if it was sent and not submitted
+     */
+    void complete(const OutputType &res, uint32_t tag) {
+        if (tag != 0 && completions) completions->complete(tag - 1, res);
+    }
+
+    /**
+     * Fail the future of an item dropped before being computed, if the item was submitted.
+     * @param tag the tag of the item, zero if it was sent and not submitted
+     */
+    void drop(uint32_t tag) {
+        if (tag != 0 && completions) completions->drop(tag - 1);
+    }
+
+    /**
+     * Make the workers keep the tags of the items, which tell the slots of the submitted ones.
+     */
+    virtual void tagItems();
+
+    /**
+     * Called when the results are pulled from a queue, to adapt the gatherer to a consumer that may be slow.
+     */
+    virtual void pullResults() {}
 };
 
 template<typename InputType, typename OutputType>
-Farm<InputType, OutputType>::Farm(size_t num_workers, const WorkerFunType &fun, const SendOutFunType &sendOutFun) {
-    gatherer = new ThreadedNode<OutputType>(sendOutFun);
-    workers_pool = new NodePool(num_workers, [this, &fun](auto val) { 
-        auto res = fun(val);
-        gatherer->send(res); 
+Farm<InputType, OutputType>::Farm(size_t num_workers, const WorkerFunType &fun, const SendOutFunType &sendOutFun)
+: worker_fun(fun), send_out_fun(sendOutFun) {
+    auto threaded_gatherer = new ThreadedNode<OutputType>([this](auto &res) { sendOut(res); });
+    threaded_gatherer->setName("gatherer");
+    gatherer = threaded_gatherer;
+    workers_pool = new NodePool<InputType, ThreadedNode<InputType>>(num_workers, [this](auto val) {
+        auto res = worker_fun(val);
+        complete(res, ThreadedNode<InputType>::currentTag());
+        gatherer->send(res);
     });
 }
 
@@ -50,6 +149,7 @@ void Farm<InputType, OutputType>::wait() {
     workers_pool->wait();
     gatherer->notify_eos();
     gatherer->wait();
+    if (result_queue) result_queue->close();
 }
 
 template<typename InputType, typename OutputType>
@@ -62,6 +162,60 @@ void Farm<InputType, OutputType>::send(InputType& value) {
     workers_pool->send(value);
 }
 
+template<typename InputType, typename OutputType>
+void Farm<InputType, OutputType>::sendTagged(InputType& value, uint32_t tag) {
+    workers_pool->sendTagged(value, tag);
+}
+
+template<typename InputType, typename OutputType>
+void Farm<InputType, OutputType>::setSubmitCapacity(size_t capacity) {
+    completions = std::make_unique<CompletionSlots<OutputType>>(capacity);
+    tagItems();
+}
+
+template<typename InputType, typename OutputType>
+completion_future<OutputType> Farm<InputType, OutputType>::submit(InputType& value) {
+    if (!completions) throw std::logic_error("submit is not enabled, call setSubmitCapacity before running the farm");
+    auto index = completions->acquire();
+    // the tag zero is left to the items sent without a future
+    sendTagged(value, index + 1);
+    return completion_future<OutputType>(completions.get(), index);
+}
+
+template<typename InputType, typename OutputType>
+template<typename InputIt, typename OutputIt>
+void Farm<InputType, OutputType>::submit(InputIt begin, InputIt end, OutputIt futures) {
+    for (; begin != end; ++begin) {
+        *futures++ = submit(*begin);
+    }
+}
+
+template<typename InputType, typename OutputType>
+void Farm<InputType, OutputType>::setResultsCapacity(size_t capacity) {
+    result_queue = std::make_unique<ResultQueue<OutputType>>(capacity);
+    auto threaded_gatherer = dynamic_cast<ThreadedNode<OutputType>*>(gatherer);
+    if (threaded_gatherer != nullptr) threaded_gatherer->setCapacity(capacity);
+    pullResults();
+}
+
+template<typename InputType, typename OutputType>
+ResultQueue<OutputType>& Farm<InputType, OutputType>::results() {
+    if (!result_queue) throw std::logic_error("the results are not pulled, call setResultsCapacity before running the farm");
+    return *result_queue;
+}
+
+template<typename InputType, typename OutputType>
+void Farm<InputType, OutputType>::tagItems() {
+    auto pool = dynamic_cast<NodePool<InputType, ThreadedNode<InputType>>*>(workers_pool);
+    if (pool != nullptr) pool->enableTags();
+}
+
+template<typename InputType, typename OutputType>
+void Farm<InputType, OutputType>::setDispatchPolicy(dispatch_policy policy, size_t max_pending) {
+    auto pool = dynamic_cast<NodePool<InputType, ThreadedNode<InputType>>*>(workers_pool);
+    if (pool != nullptr) pool->setDispatchPolicy(policy, max_pending);
+}
+
 template<typename InputType, typename OutputType>
 Farm<InputType, OutputType>::~Farm() {
     delete workers_pool;
@@ -5,9 +5,18 @@
 #include <vector>
 #include <chrono>
 #include <fstream>
+#include <tuple>
 #include <iostream>
 #include <sys/stat.h>
 #include "ProgramArgs.hpp"
+#include "ControllerMetrics.hpp"
+#include "WorkerStats.hpp"
+#include "PerfCounters.hpp"
+#include "BufferedFileSink.hpp"
+#include "SpillQueue.hpp"
+#include "AdmissionControl.hpp"
+#include "TaskPriority.hpp"
+#include "FairQueue.hpp"
 
 #define CSV_DELIMITER ","
 
@@ -19,7 +28,44 @@ public:
     std::vector<std::pair<double, long>> service_time; // pair <moving average service time value, timestamp>
     std::vector<std::pair<double, long>> service_time_points; // pair <service time value, timestamp>
     std::vector<std::pair<size_t, long>> num_workers; // pair <number of nodes, timestamp>
+    std::vector<std::pair<size_t, long>> concurrency; // pair <items in flight per asynchronous worker, timestamp>
     std::vector<long> arrival_time;
+    std::vector<std::pair<long, long>> generator_lag; // pair <delay of the send from its deadline (usec), timestamp>
+    std::vector<std::tuple<double, double, long>> arrival_forecast; // tuple <observed arrival rate, forecast arrival rate, timestamp>
+    std::vector<std::tuple<size_t, double, size_t>> scalability; // tuple <number of workers, throughput (tasks/ms), samples>
+    controller_metrics controller; // how well the autonomic controller behaved
+    size_t inline_tasks = 0; // tasks computed by the sending thread
+    size_t inline_mode_switches = 0; // switches between the inline and the threaded execution
+    double consumer_blocked_ms = 0; // time the gatherer waited for the consumer to pull the results, if pulled
+    sink_stats output_sink; // how the results were written to a file, if they were
+    spill_stats spill; // how the waiting tasks were spilled to disk, if they were
+    shed_stats shedding; // how many tasks the admission control admitted and dropped, if enabled
+    std::vector<class_latency> latency_by_class; // latencies of the tasks of each priority class, if enabled
+    std::vector<tenant_stats> tenants; // tasks, computing time and latencies of each tenant, if enabled
+    std::vector<worker_stats> workers; // statistics of each worker, collected at the end of the run
+    std::vector<perf_window> perf_counters; // hardware events of the workers, summed per window of time
+    perf_source perf_counters_source = perf_source::none; // weakest source of the counters of the workers
+
+    /**
+     * Add the counters of a worker to the counters of the farm.
+     * @param counters the counters of the worker
+     * @param start_ms the beginning of the farm since the epoch of the system clock (milliseconds)
+     */
+    void add_perf_counters(const PerfCounters &counters, long start_ms) {
+        PerfCounters::merge(perf_counters, counters.windows(), start_ms);
+        if (perf_counters_source == perf_source::none || counters.source() > perf_counters_source) {
+            perf_counters_source = counters.source();
+        }
+    }
+
+    /**
+     * Complete the controller metrics at the end of the run, from the collected analytics.
+     * @param target_service_time the target service time, zero if the target is the arrival time
+     */
+    void complete_controller_metrics(double target_service_time) {
+        long end_time = service_time_points.empty() ? 0:service_time_points.back().second;
+        controller.complete(service_time, num_workers, arrival_time, target_service_time, end_time);
+    }
 
     void throughput_to_file(const char* root_dir, const char* basename, program_args &args) {
         long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
@@ -105,6 +151,267 @@ public:
         std::cout << "DONE!" << std::endl;
     }
 
+    void concurrency_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing concurrency data to " << file_name << "..." << std::flush;
+        file << "concurrency" << CSV_DELIMITER << "time" << std::endl;
+        for(auto& items: concurrency) {
+            file << items.first << CSV_DELIMITER << items.second << std::endl;
+        }
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void generator_lag_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing generator lag data to " << file_name << "..." << std::flush;
+        file << "lag_us" << CSV_DELIMITER << "time" << std::endl;
+        for(auto& lag: generator_lag) {
+            file << lag.first << CSV_DELIMITER << lag.second << std::endl;
+        }
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void arrival_forecast_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing arrival rate forecast data to " << file_name << "..." << std::flush;
+        file << "arrival_rate" << CSV_DELIMITER << "forecast" << CSV_DELIMITER << "abs_error" << CSV_DELIMITER << "time" << std::endl;
+        for(auto& [observed, forecast, time]: arrival_forecast) {
+            file << observed << CSV_DELIMITER << forecast << CSV_DELIMITER << std::abs(observed - forecast) << CSV_DELIMITER << time << std::endl;
+        }
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void scalability_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing scalability curve data to " << file_name << "..." << std::flush;
+        file << "num_workers" << CSV_DELIMITER << "throughput" << CSV_DELIMITER << "samples" << std::endl;
+        for(auto& [workers, throughput, samples]: scalability) {
+            if (samples == 0) continue;
+            file << workers << CSV_DELIMITER << throughput << CSV_DELIMITER << samples << std::endl;
+        }
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void controller_metrics_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing controller metrics data to " << file_name << "..." << std::flush;
+        size_t unsettled = 0;
+        double settling_sum = 0;
+        for (auto &change: controller.load_changes) {
+            if (change.settling_time < 0) unsettled++;
+            else settling_sum += (double) change.settling_time;
+        }
+        auto settled = controller.load_changes.size() - unsettled;
+        file << "reconfigurations" << CSV_DELIMITER << "oscillations" << CSV_DELIMITER << "worker_seconds" << CSV_DELIMITER;
+        file << "time_outside_band" << CSV_DELIMITER << "monitored_time" << CSV_DELIMITER << "overshoot" << CSV_DELIMITER;
+        file << "undershoot" << CSV_DELIMITER << "load_changes" << CSV_DELIMITER << "mean_settling_time" << CSV_DELIMITER << "unsettled" << std::endl;
+        file << controller.reconfigurations << CSV_DELIMITER << controller.oscillations << CSV_DELIMITER << controller.worker_seconds << CSV_DELIMITER;
+        file << controller.time_outside_band << CSV_DELIMITER << controller.monitored_time << CSV_DELIMITER << controller.overshoot << CSV_DELIMITER;
+        file << controller.undershoot << CSV_DELIMITER << controller.load_changes.size() << CSV_DELIMITER;
+        file << (settled == 0 ? -1:settling_sum / (double) settled) << CSV_DELIMITER << unsettled << std::endl;
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void load_changes_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing load changes data to " << file_name << "..." << std::flush;
+        file << "time" << CSV_DELIMITER << "arrival_time" << CSV_DELIMITER << "settling_time" << CSV_DELIMITER;
+        file << "overshoot" << CSV_DELIMITER << "undershoot" << std::endl;
+        for(auto& change: controller.load_changes) {
+            file << change.time << CSV_DELIMITER << change.arrival_time << CSV_DELIMITER << change.settling_time << CSV_DELIMITER;
+            file << change.overshoot << CSV_DELIMITER << change.undershoot << std::endl;
+        }
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void inline_execution_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing inline execution data to " << file_name << "..." << std::flush;
+        file << "inline_tasks" << CSV_DELIMITER << "threaded_tasks" << CSV_DELIMITER << "mode_switches" << std::endl;
+        file << inline_tasks << CSV_DELIMITER << arrival_time.size() - inline_tasks << CSV_DELIMITER << inline_mode_switches << std::endl;
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void output_sink_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing output sink data to " << file_name << "..." << std::flush;
+        file << "bytes" << CSV_DELIMITER << "writes" << CSV_DELIMITER << "write_ms" << CSV_DELIMITER << "write_mb_per_s";
+        file << CSV_DELIMITER << "stalls" << CSV_DELIMITER << "stall_ms" << CSV_DELIMITER << "direct" << std::endl;
+        file << output_sink.bytes << CSV_DELIMITER << output_sink.writes << CSV_DELIMITER << (double) output_sink.write_ns / 1e6;
+        file << CSV_DELIMITER << output_sink.write_mb_per_s() << CSV_DELIMITER << output_sink.stalls << CSV_DELIMITER;
+        file << (double) output_sink.stall_ns / 1e6 << CSV_DELIMITER << output_sink.direct << std::endl;
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void spill_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing spill data to " << file_name << "..." << std::flush;
+        file << "items" << CSV_DELIMITER << "max_backlog" << CSV_DELIMITER << "segments" << CSV_DELIMITER;
+        file << "bytes_written" << CSV_DELIMITER << "copy_in_mb_per_s" << CSV_DELIMITER;
+        file << "bytes_read" << CSV_DELIMITER << "copy_out_mb_per_s" << std::endl;
+        file << spill.items_written << CSV_DELIMITER << spill.max_backlog << CSV_DELIMITER << spill.segments << CSV_DELIMITER;
+        file << spill.bytes_written << CSV_DELIMITER << spill.copy_in_mb_per_s() << CSV_DELIMITER;
+        file << spill.bytes_read << CSV_DELIMITER << spill.copy_out_mb_per_s() << std::endl;
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void shedding_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing shedding data to " << file_name << "..." << std::flush;
+        file << "admitted" << CSV_DELIMITER << "dropped_newest" << CSV_DELIMITER << "dropped_oldest" << CSV_DELIMITER;
+        file << "dropped_early" << CSV_DELIMITER << "expired" << CSV_DELIMITER << "dropped" << std::endl;
+        file << shedding.admitted << CSV_DELIMITER << shedding.dropped_newest << CSV_DELIMITER << shedding.dropped_oldest << CSV_DELIMITER;
+        file << shedding.dropped_early << CSV_DELIMITER << shedding.expired << CSV_DELIMITER << shedding.total() << std::endl;
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void class_latency_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing class latency data to " << file_name << "..." << std::flush;
+        file << "class" << CSV_DELIMITER << "tasks" << CSV_DELIMITER << "mean_ms" << CSV_DELIMITER << "p50_ms" << CSV_DELIMITER;
+        file << "p95_ms" << CSV_DELIMITER << "p99_ms" << CSV_DELIMITER << "max_ms" << std::endl;
+        for (size_t i = 0; i < latency_by_class.size(); ++i) {
+            auto &latency = latency_by_class[i];
+            file << i << CSV_DELIMITER << latency.tasks() << CSV_DELIMITER << latency.mean() << CSV_DELIMITER;
+            file << latency.percentile(50) << CSV_DELIMITER << latency.percentile(95) << CSV_DELIMITER;
+            file << latency.percentile(99) << CSV_DELIMITER << latency.percentile(100) << std::endl;
+        }
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void tenants_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing tenant data to " << file_name << "..." << std::flush;
+        // the throughput of each tenant is over the whole run, up to the latest service time measured
+        long elapsed_ms = service_time_points.empty() ? 0:service_time_points.back().second;
+        double busy_sum = 0;
+        for (auto &tenant: tenants) busy_sum += tenant.busy_ms;
+        file << "tenant" << CSV_DELIMITER << "tasks" << CSV_DELIMITER << "throughput" << CSV_DELIMITER;
+        file << "busy_ms" << CSV_DELIMITER << "busy_share" << CSV_DELIMITER << "max_waiting" << CSV_DELIMITER;
+        file << "max_in_flight" << CSV_DELIMITER << "mean_ms" << CSV_DELIMITER << "p50_ms" << CSV_DELIMITER;
+        file << "p95_ms" << CSV_DELIMITER << "p99_ms" << CSV_DELIMITER << "max_ms" << std::endl;
+        for (size_t i = 0; i < tenants.size(); ++i) {
+            auto &tenant = tenants[i];
+            file << i << CSV_DELIMITER << tenant.tasks << CSV_DELIMITER;
+            file << (elapsed_ms > 0 ? (double) tenant.tasks / (double) elapsed_ms:0) << CSV_DELIMITER;
+            file << tenant.busy_ms << CSV_DELIMITER << (busy_sum > 0 ? tenant.busy_ms / busy_sum:0) << CSV_DELIMITER;
+            file << tenant.max_waiting << CSV_DELIMITER << tenant.max_in_flight << CSV_DELIMITER;
+            file << tenant.latency.mean() << CSV_DELIMITER << tenant.latency.percentile(50) << CSV_DELIMITER;
+            file << tenant.latency.percentile(95) << CSV_DELIMITER << tenant.latency.percentile(99) << CSV_DELIMITER;
+            file << tenant.latency.percentile(100) << std::endl;
+        }
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void perf_counters_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing performance counters to " << file_name << "..." << std::flush;
+        // the events that the source can't count are left empty
+        bool hardware = perf_counters_source == perf_source::hardware;
+        const char* source_names[] = { "none", "hardware", "software", "rusage" };
+        file << "time" << CSV_DELIMITER << "workers" << CSV_DELIMITER << "cycles" << CSV_DELIMITER << "instructions" << CSV_DELIMITER;
+        file << "ipc" << CSV_DELIMITER << "llc_misses" << CSV_DELIMITER << "context_switches" << CSV_DELIMITER;
+        file << "task_clock_ms" << CSV_DELIMITER << "source" << std::endl;
+        for (auto &window: perf_counters) {
+            file << window.time << CSV_DELIMITER << window.workers << CSV_DELIMITER;
+            if (hardware) {
+                file << window.cycles << CSV_DELIMITER << window.instructions << CSV_DELIMITER;
+                file << (window.cycles > 0 ? (double) window.instructions / (double) window.cycles:0) << CSV_DELIMITER;
+                file << window.llc_misses << CSV_DELIMITER;
+            } else {
+                file << CSV_DELIMITER << CSV_DELIMITER << CSV_DELIMITER << CSV_DELIMITER;
+            }
+            file << window.context_switches << CSV_DELIMITER << (double) window.task_clock_ns / 1e6 << CSV_DELIMITER;
+            file << source_names[(int) perf_counters_source] << std::endl;
+        }
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void worker_stats_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing worker statistics to " << file_name << "..." << std::flush;
+        file << "worker" << CSV_DELIMITER << "tasks" << CSV_DELIMITER << "busy_ms" << CSV_DELIMITER << "idle_ms" << CSV_DELIMITER;
+        file << "paused_ms" << CSV_DELIMITER << "queue_wait_ms" << CSV_DELIMITER << "utilization" << std::endl;
+        for (size_t i = 0; i < workers.size(); ++i) {
+            auto &stats = workers[i];
+            file << i << CSV_DELIMITER << stats.tasks << CSV_DELIMITER << (double) stats.busy_ns / 1e6 << CSV_DELIMITER;
+            file << (double) stats.idle_ns / 1e6 << CSV_DELIMITER << (double) stats.paused_ns / 1e6 << CSV_DELIMITER;
+            file << (double) stats.queue_wait_ns / 1e6 << CSV_DELIMITER << stats.utilization() << std::endl;
+        }
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
+    void calibration_to_file(const char* root_dir, const char* basename, program_args &args) {
+        long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
+        std::ofstream file;
+        auto file_name = open(file, root_dir, basename, args, epoch_ms);
+
+        std::cout << "Writing calibration data to " << file_name << "..." << std::flush;
+        auto &calibration = controller.calibration;
+        file << "tasks" << CSV_DELIMITER << "end_time" << CSV_DELIMITER << "worker_service_time" << CSV_DELIMITER;
+        file << "arrival_time" << CSV_DELIMITER << "num_workers" << CSV_DELIMITER << "saved_time" << std::endl;
+        file << calibration.tasks << CSV_DELIMITER << calibration.end_time << CSV_DELIMITER << calibration.worker_service_time << CSV_DELIMITER;
+        file << calibration.arrival_time << CSV_DELIMITER << calibration.num_workers << CSV_DELIMITER << calibration.saved_time << std::endl;
+        file.close();
+        std::cout << "DONE!" << std::endl;
+    }
+
     void metadata_to_file(const char* root_dir, const char* basename, program_args &args) {
         long epoch_ms = std::chrono::duration_cast<std::chrono::milliseconds>(farm_start_time.time_since_epoch()).count();
         std::ofstream file;
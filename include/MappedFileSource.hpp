@@ -0,0 +1,219 @@
+#ifndef AUTONOMICFARM_MAPPEDFILESOURCE_HPP
+#define AUTONOMICFARM_MAPPEDFILESOURCE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Node.hpp"
+
+/**
+ * How the records of an input file are delimited.
+ */
+enum class record_format {
+    // every record ends with a newline
+    newline,
+    // every record has the same size
+    fixed
+};
+
+/**
+ * A chunk of whole records of an input file: a view into the file's mapping, valid as long as the source lives.
+ */
+struct file_chunk {
+    const char* data = nullptr;
+    size_t size = 0;
+    // index of the file, in the order given to the source
+    size_t file = 0;
+    // offset of the chunk in the file
+    size_t offset = 0;
+
+    std::string_view view() const {
+        return { data, size };
+    }
+};
+
+/**
+ * A read-only memory mapping of a whole file, unmapped when destroyed.
+ */
+class MappedFile {
+public:
+    /**
+     * Map the given file.
+     * @param path the path of the file
+     * @throws std::runtime_error if the file cannot be opened or mapped
+     */
+    explicit MappedFile(const std::string &path);
+    MappedFile(MappedFile &&other) noexcept
+    : address(std::exchange(other.address, nullptr)), length(std::exchange(other.length, 0)) {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const {
+        return static_cast<const char*>(address);
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    /**
+     * Give the kernel an advice about a range of the file, widened to whole pages.
+     * @param offset the beginning of the range
+     * @param size the length of the range
+     * @param advice the madvise advice
+     */
+    void advise(size_t offset, size_t size, int advice) const;
+
+private:
+    void* address = nullptr;
+    size_t length = 0;
+};
+
+/**
+ * A source streaming the records of a set of files to a farm without copying them: the files are mapped in memory and
+ * split into chunks of whole records, and every item sent is a view into the mapping, so the workers read the records
+ * straight from the page cache. The pages ahead of the chunk being sent are prefetched with madvise.
+ */
+class MappedFileSource {
+public:
+    /**
+     * Map the given files.
+     * @param paths the paths of the files, whose chunks are sent in this order
+     * @param format how the records are delimited
+     * @param chunk_size the size of a chunk: a chunk of newline records ends at the first newline after it, a chunk of
+     * fixed records holds as many records as fit into it, at least one
+     * @param record_size the size of a record, only for fixed records
+     * @throws std::runtime_error if a file cannot be opened or mapped
+     */
+    MappedFileSource(const std::vector<std::string> &paths, record_format format, size_t chunk_size, size_t record_size = 0);
+
+    /**
+     * Set how many bytes after the chunk being sent are prefetched.
+     * @param bytes the length of the readahead, zero to leave it to the kernel
+     */
+    void setReadahead(size_t bytes) {
+        readahead = bytes;
+    }
+
+    /**
+     * Take the next chunk. It must be called by a single thread.
+     * @return the next chunk, or an empty optional once every file was split
+     */
+    std::optional<file_chunk> next();
+
+    /**
+     * Send every remaining chunk to the given node, without notifying the end-of-stream.
+     * @param node the node, usually a farm
+     * @return the number of chunks sent
+     */
+    size_t sendTo(Node<file_chunk> &node);
+
+private:
+    std::vector<MappedFile> files;
+    record_format format;
+    size_t chunk_size;
+    size_t record_size;
+    size_t readahead;
+    // position of the next chunk
+    size_t file_index = 0;
+    size_t offset = 0;
+    // end of the range of the current file already prefetched
+    size_t prefetched = 0;
+};
+
+MappedFile::MappedFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+    struct stat info{};
+    if (fstat(fd, &info) < 0) {
+        close(fd);
+        throw std::runtime_error("cannot stat " + path + ": " + std::strerror(errno));
+    }
+    length = (size_t) info.st_size;
+    // an empty file has no mapping
+    if (length > 0) {
+        address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            address = nullptr;
+            close(fd);
+            throw std::runtime_error("cannot map " + path + ": " + std::strerror(errno));
+        }
+        madvise(address, length, MADV_SEQUENTIAL);
+    }
+    // the mapping keeps the file open
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (address != nullptr) munmap(address, length);
+}
+
+void MappedFile::advise(size_t offset, size_t size, int advice) const {
+    if (address == nullptr || offset >= length) return;
+    static const auto page_size = (size_t) sysconf(_SC_PAGESIZE);
+    size_t begin = offset / page_size * page_size;
+    size_t end = std::min(length, offset + size);
+    madvise(static_cast<char*>(address) + begin, end - begin, advice);
+}
+
+MappedFileSource::MappedFileSource(const std::vector<std::string> &paths, record_format format, size_t chunk_size,
+                                   size_t record_size)
+: format(format), chunk_size(std::max<size_t>(1, chunk_size)), record_size(record_size), readahead(4 * this->chunk_size) {
+    if (format == record_format::fixed && record_size == 0) throw std::invalid_argument("the size of a fixed record is zero");
+    files.reserve(paths.size());
+    for (auto &path: paths) files.emplace_back(path);
+}
+
+std::optional<file_chunk> MappedFileSource::next() {
+    while (file_index < files.size() && offset >= files[file_index].size()) {
+        file_index++;
+        offset = 0;
+        prefetched = 0;
+    }
+    if (file_index == files.size()) return {};
+
+    auto &file = files[file_index];
+    size_t remaining = file.size() - offset;
+    size_t size;
+    if (format == record_format::fixed) {
+        // a truncated record at the end of the file is sent as it is
+        size = std::min(remaining, std::max(record_size, chunk_size / record_size * record_size));
+    } else {
+        size = std::min(remaining, chunk_size);
+        auto newline = static_cast<const char*>(std::memchr(file.data() + offset + size - 1, '\n', remaining - size + 1));
+        size = newline == nullptr ? remaining:(size_t) (newline - (file.data() + offset)) + 1;
+    }
+
+    // prefetch the pages the next chunks will be read from, while the workers read this one
+    if (readahead > 0 && offset + size + readahead > prefetched) {
+        size_t from = std::max(prefetched, offset + size);
+        file.advise(from, offset + size + readahead - from, MADV_WILLNEED);
+        prefetched = offset + size + readahead;
+    }
+
+    file_chunk chunk{ file.data() + offset, size, file_index, offset };
+    offset += size;
+    return chunk;
+}
+
+size_t MappedFileSource::sendTo(Node<file_chunk> &node) {
+    size_t sent = 0;
+    while (auto chunk = next()) {
+        node.send(*chunk);
+        sent++;
+    }
+    return sent;
+}
+
+#endif //AUTONOMICFARM_MAPPEDFILESOURCE_HPP
@@ -15,6 +15,7 @@ public:
 
     void run() override;
     void send(InputType &value) override;
+    void sendTagged(InputType &value, uint32_t tag) override;
 
     /**
      * Wait for the farm to finish and then return the analytics. It is the only way to safely obtain the analytics,
@@ -23,19 +24,115 @@ public:
      */
     virtual farm_analytics wait_and_analytics();
 
+    /**
+     * Enable the inline execution of the tasks on the sending thread. When the farm is idle and the tasks are much
+     * shorter than the time between two arrivals, a task is computed by the sending thread instead of crossing the
+     * threads of a worker and of the gatherer. The farm goes back to its threads as soon as the load rises.
+     * @param enabled true to enable the inline execution
+     * @param sink true to also monitor and output the result on the sending thread, false to send it to the gatherer.
+     * The monitoring, and the controller of an autonomic farm with it, then runs on the sending thread too: only while
+     * the gatherer is idle, so never at once with the gatherer thread
+     */
+    void setInlineExecution(bool enabled, bool sink) {
+        inline_execution = enabled;
+        // pulled results go through the gatherer, which measures when they were produced
+        inline_sink = sink && !this->result_queue;
+    }
+
+    /**
+     * Count the hardware events of the tasks of each worker, summed per window of time. It must be called before
+     * running the farm.
+     * @param window_ms the length of the windows (milliseconds)
+     */
+    void setPerfCounters(long window_ms) {
+        for (auto worker: workerNodes()) worker->enablePerfCounters(window_ms);
+    }
+
 protected:
     MonitoredFarm() = default;
 
     farm_analytics analytics;
+    // the gatherer of the farm, to know how many items it processed and to run it inline
+    MonitoringGatherer<OutputType>* monitoring_gatherer;
+
+    // inline execution
+    bool inline_execution = false;
+    bool inline_sink = false;
+    // true while the tasks are computed by the sending thread
+    bool inline_mode = false;
+    // items that will be processed by the gatherer thread
+    size_t threaded_items = 0;
+    // moving averages of the time needed by a task and of the time between two arrivals (microseconds)
+    std::atomic<double> task_time_us = -1;
+    double arrival_gap_us = -1;
+    std::chrono::steady_clock::time_point last_send;
+
+    // constants
+    // maximum time needed by a task to be computed inline
+    const double inline_max_task_time_us = 200;
+    // minimum ratio between the time between two arrivals and the time needed by a task to compute it inline
+    const double inline_load_factor = 4;
+    // weight of the newest measure on the moving averages
+    const double inline_smoothing = 0.2;
+
+    /**
+     * Compute the worker function on the given item, measuring its time if the inline execution is enabled.
+     * @param value the item to compute
+     * @return the result of the worker function
+     */
+    OutputType compute(InputType &value);
+
+    /**
+     * Check if the next item can be computed by the sending thread: the farm is idle, the tasks are tiny and arrive
+     * slowly enough.
+     * @return true if the item can be computed inline
+     */
+    bool canRunInline();
+
+    /**
+     * Compute the given item on the sending thread.
+     * @param value the item to compute
+     * @param tag the tag of the item, to write its result into its future if it was submitted
+     */
+    void runInline(InputType &value, uint32_t tag);
+
+    /**
+     * Called when an item is computed inline, hence it doesn't reach the workers. It allows to keep track of the
+     * arrivals as the workers would.
+     */
+    virtual void onInlineArrival() {}
+
+    void pullResults() override {
+        monitoring_gatherer->measureProduction();
+        inline_sink = false;
+    }
+
+    /**
+     * @return the workers of this farm
+     */
+    virtual std::vector<ThreadedNode<InputType>*> workerNodes() {
+        std::vector<ThreadedNode<InputType>*> workers;
+        for (auto &node: static_cast<NodePool<InputType, ThreadedNode<InputType>>*>(this->workers_pool)->getNodes()) {
+            workers.push_back(&node);
+        }
+        return workers;
+    }
 };
 
 template<typename InputType, typename OutputType>
 MonitoredFarm<InputType, OutputType>::MonitoredFarm(size_t num_workers, const WorkerFunType &fun, const SendOutFunType &sendOutFun) {
-    this->gatherer = new MonitoringGatherer<OutputType>(sendOutFun, &analytics);
-    this->workers_pool = new NodePool<InputType, ThreadedNode<InputType>>(num_workers, [this, &fun](auto val) {
-        auto res = fun(val);
+    this->worker_fun = fun;
+    this->send_out_fun = sendOutFun;
+    monitoring_gatherer = new MonitoringGatherer<OutputType>([this](auto &res) { this->sendOut(res); }, &analytics);
+    monitoring_gatherer->setName("gatherer");
+    this->gatherer = monitoring_gatherer;
+    auto pool = new NodePool<InputType, ThreadedNode<InputType>>(num_workers, [this](auto val) {
+        auto res = compute(val);
+        this->complete(res, ThreadedNode<InputType>::currentTag());
         this->gatherer->send(res);
     });
+    pool->enableStats();
+    this->workers_pool = pool;
     // we already know the current number of workers
     analytics.num_workers.emplace_back(num_workers, 0);
 }
@@ -49,16 +146,89 @@ void MonitoredFarm<InputType, OutputType>::run() {
 
 template<typename InputType, typename OutputType>
 void MonitoredFarm<InputType, OutputType>::send(InputType &value) {
-    Farm<InputType, OutputType>::send(value);
+    sendTagged(value, 0);
+}
+
+template<typename InputType, typename OutputType>
+void MonitoredFarm<InputType, OutputType>::sendTagged(InputType &value, uint32_t tag) {
     // track at which time a new item arrived
     STOP(analytics.farm_start_time, time, std::chrono::milliseconds);
     analytics.arrival_time.emplace_back(time);
+    EventTracer::record(trace_event::enqueue, (int32_t) analytics.arrival_time.size() - 1);
+
+    if (inline_execution && canRunInline()) {
+        runInline(value, tag);
+        return;
+    }
+    if (inline_mode) {
+        inline_mode = false;
+        analytics.inline_mode_switches++;
+    }
+    threaded_items++;
+    Farm<InputType, OutputType>::sendTagged(value, tag);
+}
+
+template<typename InputType, typename OutputType>
+OutputType MonitoredFarm<InputType, OutputType>::compute(InputType &value) {
+    if (!inline_execution) return this->worker_fun(value);
+
+    auto start = std::chrono::steady_clock::now();
+    auto res = this->worker_fun(value);
+    double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    // concurrent workers may overwrite each other's update, which only delays the average
+    double previous = task_time_us;
+    task_time_us = previous < 0 ? elapsed:inline_smoothing * elapsed + (1 - inline_smoothing) * previous;
+    return res;
+}
+
+template<typename InputType, typename OutputType>
+bool MonitoredFarm<InputType, OutputType>::canRunInline() {
+    auto now = std::chrono::steady_clock::now();
+    if (arrival_gap_us >= 0 || threaded_items + analytics.inline_tasks > 0) {
+        double gap = std::chrono::duration<double, std::micro>(now - last_send).count();
+        arrival_gap_us = arrival_gap_us < 0 ? gap:inline_smoothing * gap + (1 - inline_smoothing) * arrival_gap_us;
+    }
+    last_send = now;
+
+    double task_time = task_time_us;
+    if (task_time < 0 || task_time > inline_max_task_time_us || task_time * inline_load_factor > arrival_gap_us) {
+        return false;
+    }
+    // the farm is idle when the gatherer processed every item sent to the threads: keeping the order of the results
+    return monitoring_gatherer->processed() == threaded_items;
+}
+
+template<typename InputType, typename OutputType>
+void MonitoredFarm<InputType, OutputType>::runInline(InputType &value, uint32_t tag) {
+    if (!inline_mode) {
+        inline_mode = true;
+        analytics.inline_mode_switches++;
+    }
+    analytics.inline_tasks++;
+    onInlineArrival();
+
+    auto res = compute(value);
+    this->complete(res, tag);
+    if (inline_sink) {
+        // the gatherer thread is waiting for new items, so it doesn't touch the analytics meanwhile
+        monitoring_gatherer->onValue(res);
+    } else {
+        threaded_items++;
+        this->gatherer->send(res);
+    }
 }
 
 template<typename InputType, typename OutputType>
 farm_analytics MonitoredFarm<InputType, OutputType>::wait_and_analytics() {
     // wait for the farm to finish and then return the analytics
     Farm<InputType, OutputType>::wait();
+    if (this->result_queue) analytics.consumer_blocked_ms = (double) this->result_queue->blockedTime() / 1e6;
+    long start_ms = std::chrono::duration_cast<std::chrono::milliseconds>(analytics.farm_start_time.time_since_epoch()).count();
+    analytics.workers.clear();
+    for (auto worker: workerNodes()) {
+        analytics.workers.push_back(worker->getStats());
+        if (worker->getPerfCounters() != nullptr) analytics.add_perf_counters(*worker->getPerfCounters(), start_ms);
+    }
     return analytics;
 }
 
@@ -22,8 +22,20 @@ public:
 
     void onValue(OutputType& value) override;
 
+    /**
+     * Measure the throughput on a timeline without the time a slow consumer held the gatherer, which holds the workers
+     * too once the input of the gatherer is full, so that a slow consumer doesn't look like a slow farm to the
+     * controller. It must be called before running.
+     */
+    void measureProduction() {
+        production_time = true;
+    }
+
 protected:
     farm_analytics* analytics;
+    bool production_time = false;
+    // time spent outputting the results so far, measured with currentTime, if the production time is measured
+    std::chrono::system_clock::duration held{0};
     // window of the last throughput values withing <throughput_evaluation_time> milliseconds
     std::deque<std::pair<size_t, double>> throughput_window; // pair <tasks gathered, when it was acquired>
     std::deque<std::pair<double, double>> linear_regression_throughput_window; // pair <throughput, when it was acquired>
@@ -37,18 +49,35 @@ protected:
     const size_t throughput_evaluation_time = 300; //ms
 
     void compute_moving_average(double throughput, double global_elapsed);
+
+    /**
+     * The current point in time, used to timestamp every measurement. It can be overridden to monitor against a
+     * virtual clock.
+     * @return the current point in time
+     */
+    virtual std::chrono::system_clock::time_point currentTime() {
+        return std::chrono::system_clock::now();
+    }
 };
 
 template <typename OutputType>
 void MonitoringGatherer<OutputType>::onValue(OutputType& value) {
     // override gatherer thread's function to add monitoring
-    START(now);
-    this->onValueFun(value);
+    auto now = currentTime();
+    if (production_time) {
+        // outputting a result waits for the consumer, so the time spent outputting is left out of the timeline
+        this->onValueFun(value);
+        auto output_time = currentTime() - now;
+        now -= held;
+        held += output_time;
+    } else {
+        this->onValueFun(value);
+    }
     // get the time elapsed from the beginning of the farm computation
     double global_elapsed = ELAPSED(analytics->farm_start_time, now, std::chrono::milliseconds);
 
     // compute the number of tasks gathered now by increasing the number of tasks gathered before
-    auto global_tasks_gathered = throughput_window.front().first + 1;
+    auto global_tasks_gathered = (throughput_window.empty() ? 0:throughput_window.front().first) + 1;
     // add current measurement into the window
     throughput_window.emplace_front( global_tasks_gathered, global_elapsed );
 
@@ -2,6 +2,7 @@
 #define AUTONOMIC_FARM_NODE_HPP
 
 #include <functional>
+#include <cstdint>
 
 template <typename InputType>
 class Node {
@@ -26,6 +27,18 @@ public:
      * @param value the reference to the item to send to the node
      */
     virtual void send(InputType& value) = 0;
+
+    /**
+     * Send to the node an item along with a tag, which the node gives back while computing the item. Nodes that don't
+     * keep the tags drop it.
+     * @param value the reference to the item to send to the node
+     * @param tag the tag of the item
+     */
+    virtual void sendTagged(InputType& value, [[maybe_unused]] uint32_t tag) {
+        send(value);
+    }
+
+    virtual ~Node() = default;
 };
 
 #endif //AUTONOMIC_FARM_NODE_HPP
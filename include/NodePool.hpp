@@ -2,8 +2,47 @@
 #define AUTONOMICFARM_NODEPOOL_HPP
 
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
 #include "trace.hpp"
 #include "Node.hpp"
+#include "WorkerStats.hpp"
+#include "WorkerSpeeds.hpp"
+
+/**
+ * How a node pool chooses the node that receives the next item.
+ */
+enum class dispatch_policy {
+    // each node in turn, regardless of its load
+    round_robin,
+    // the node with the fewest pending items
+    join_shortest_queue,
+    // the less loaded of two random nodes
+    power_of_two_choices,
+    // the first node with fewer pending items than a bound, waiting for a completion if all are full
+    on_demand,
+    // the node that would complete the item first, given its pending items and its speed
+    shortest_expected_delay
+};
+
+/**
+ * Parse a dispatch policy from its name: rr, jsq, p2c, ondemand or sed.
+ * @param name the name of the policy
+ * @return the dispatch policy
+ */
+dispatch_policy parse_dispatch_policy(const std::string &name) {
+    if (name == "rr") return dispatch_policy::round_robin;
+    if (name == "jsq") return dispatch_policy::join_shortest_queue;
+    if (name == "p2c") return dispatch_policy::power_of_two_choices;
+    if (name == "ondemand") return dispatch_policy::on_demand;
+    if (name == "sed") return dispatch_policy::shortest_expected_delay;
+    throw std::invalid_argument("unknown dispatch policy: " + name);
+}
 
 /**
  * A NodePool is a group of nodes of a specified type.
@@ -38,11 +77,56 @@ public:
     void notify_eos() override;
 
     /**
-     * Send to one of the nodes the node an item to be processed, following round-robin policy.
+     * Send to one of the nodes the node an item to be processed, following the dispatch policy (round-robin by default).
      * @param value the reference to the item to send to the selected node
      */
     void send(InputType& value) override;
 
+    void sendTagged(InputType& value, uint32_t tag) override;
+
+    /**
+     * Set how the node receiving the next item is chosen. The policies other than round-robin look at the pending items
+     * of each node, so the items must be sent by a single thread.
+     * @param policy the dispatch policy
+     * @param max_pending the maximum number of pending items of a node, only for the on-demand policy
+     */
+    void setDispatchPolicy(dispatch_policy policy, size_t max_pending = 1) {
+        this->policy = policy;
+        this->max_pending = std::max<size_t>(1, max_pending);
+        if (policy == dispatch_policy::shortest_expected_delay) trackSpeeds();
+        if (policy == dispatch_policy::on_demand) {
+            for (auto &node: nodes) node.notifyCompletions(&completions);
+        }
+    }
+
+    /**
+     * Estimate the service time of every node. It must be called before running the nodes.
+     */
+    void trackSpeeds() {
+        for (size_t i = 0; i < nodes.size(); ++i) nodes[i].trackSpeed(&speeds, i);
+    }
+
+    /**
+     * Collect the statistics of every node. It must be called before running the nodes.
+     */
+    void enableStats() {
+        for (auto &node: nodes) node.enableStats();
+    }
+
+    /**
+     * Keep the tags of the items sent to every node. It must be called before sending any item.
+     */
+    void enableTags() {
+        for (auto &node: nodes) node.enableTags();
+    }
+
+    /**
+     * @return the nodes of this pool
+     */
+    std::vector<NodeType>& getNodes() {
+        return nodes;
+    }
+
 protected:
     NodePool() = default;
 
@@ -54,8 +138,22 @@ protected:
     template <typename... Args>
     void init(size_t num_nodes, Args... args);
 
+    /**
+     * Choose the node that receives the next item, following the dispatch policy.
+     * @return the index of the node
+     */
+    size_t nextNode();
+
     std::vector<NodeType> nodes;
     size_t worker_index = 0;
+    dispatch_policy policy = dispatch_policy::round_robin;
+    size_t max_pending = 1;
+    // estimates of the service time of each node, if tracked
+    WorkerSpeeds speeds;
+    // state of the xorshift generator picking the nodes of the power of two choices
+    uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+    // items processed by the nodes, waited on by the on-demand policy when every node is full
+    std::atomic<uint64_t> completions = 0;
 };
 
 template<typename InputType, typename NodeType>
@@ -69,38 +167,113 @@ template <typename... Args>
 void NodePool<InputType, NodeType>::init(size_t num_nodes, Args... args) {
     nodes.clear();
     nodes.reserve(num_nodes);
-    for (int i = 0; i < num_nodes; ++i) {
-        TRACEF("Init worker %d/%lu", (i+1), num_nodes);
+    speeds = WorkerSpeeds(num_nodes);
+    for (size_t i = 0; i < num_nodes; ++i) {
+        TRACEF("Init worker %lu/%lu", (i+1), num_nodes);
         nodes.emplace_back(args...);
+        nodes.back().setName("worker " + std::to_string(i));
     }
 }
 
 template<typename InputType, typename NodeType>
 void NodePool<InputType, NodeType>::run() {
-    for (int i = 0; i < nodes.size(); ++i) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
         nodes[i].run();
     }
 }
 
 template<typename InputType, typename NodeType>
 void NodePool<InputType, NodeType>::wait() {
-    for (int i = 0; i < nodes.size(); ++i) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
         nodes[i].wait();
     }
 }
 
 template<typename InputType, typename NodeType>
 void NodePool<InputType, NodeType>::notify_eos() {
-    for (int i = 0; i < nodes.size(); ++i) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
         nodes[i].notify_eos();
     }
 }
 
 template<typename InputType, typename NodeType>
 void NodePool<InputType, NodeType>::send(InputType &value) {
-    TRACEF("Send to worker %lu (round-robin)", worker_index);
-    nodes[worker_index].send(value);
-    worker_index = (worker_index+1) % nodes.size();
+    auto index = nextNode();
+    TRACEF("Send to worker %lu (policy %d)", index, (int) policy);
+    nodes[index].send(value);
+}
+
+template<typename InputType, typename NodeType>
+void NodePool<InputType, NodeType>::sendTagged(InputType &value, uint32_t tag) {
+    nodes[nextNode()].sendTagged(value, tag);
+}
+
+template<typename InputType, typename NodeType>
+size_t NodePool<InputType, NodeType>::nextNode() {
+    size_t index = worker_index;
+    switch (policy) {
+        case dispatch_policy::round_robin:
+            break;
+        case dispatch_policy::join_shortest_queue:
+            // ties go to the node after the last one chosen, so that idle nodes are used in turn
+            for (size_t i = 1; i < nodes.size(); ++i) {
+                size_t candidate = (worker_index + i) % nodes.size();
+                if (nodes[candidate].pending() < nodes[index].pending()) index = candidate;
+            }
+            break;
+        case dispatch_policy::power_of_two_choices: {
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            size_t first = random_state % nodes.size();
+            if (nodes.size() == 1) {
+                index = first;
+                break;
+            }
+            // two different nodes, or a busy node chosen twice would get the item
+            size_t second = (first + 1 + (random_state >> 32) % (nodes.size() - 1)) % nodes.size();
+            index = nodes[second].pending() < nodes[first].pending() ? second:first;
+            break;
+        }
+        case dispatch_policy::on_demand:
+            // the nodes pull the items one bound at a time, as the ready workers of an on-demand emitter
+            while (true) {
+                // read before looking at the nodes, so that a completion after looking at them ends the wait
+                auto seen = completions.load(std::memory_order_acquire);
+                size_t i = 0;
+                while (i < nodes.size() && nodes[(worker_index + i) % nodes.size()].pending() >= max_pending) ++i;
+                if (i < nodes.size()) {
+                    index = (worker_index + i) % nodes.size();
+                    break;
+                }
+                completions.wait(seen, std::memory_order_acquire);
+            }
+            break;
+        case dispatch_policy::shortest_expected_delay: {
+            // nodes not observed yet are assumed as fast as the mean of the observed ones
+            double known_sum = 0;
+            size_t known = 0;
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                if (speeds.serviceTime(i) <= 0) continue;
+                known_sum += speeds.serviceTime(i);
+                known++;
+            }
+            double unknown_service_time = known == 0 ? 1.0:known_sum / (double) known;
+            double best_delay = INFINITY;
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                size_t candidate = (worker_index + i) % nodes.size();
+                double service_time = speeds.serviceTime(candidate);
+                double delay = (double) (nodes[candidate].pending() + 1) * (service_time > 0 ? service_time:unknown_service_time);
+                if (delay < best_delay) {
+                    best_delay = delay;
+                    index = candidate;
+                }
+            }
+            break;
+        }
+    }
+    worker_index = (index + 1) % nodes.size();
+    return index;
 }
 
 
@@ -0,0 +1,243 @@
+#ifndef AUTONOMICFARM_PERFCOUNTERS_HPP
+#define AUTONOMICFARM_PERFCOUNTERS_HPP
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+
+/**
+ * Where the counters of a worker come from. Hardware counters are often unavailable in virtual machines and containers,
+ * or forbidden by perf_event_paranoid, so weaker sources are used instead.
+ */
+enum class perf_source {
+    // nothing could be measured
+    none,
+    // cycles, instructions and last level cache misses, plus the software events
+    hardware,
+    // the kernel's task clock and context switches
+    software,
+    // the CPU time and context switches given by getrusage
+    rusage
+};
+
+/**
+ * Counts of the events of the tasks computed within a window of time.
+ */
+struct perf_window {
+    // beginning of the window, relative to the beginning of the farm once merged (milliseconds)
+    long time = 0;
+    // workers that computed tasks within the window
+    size_t workers = 0;
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t llc_misses = 0;
+    uint64_t context_switches = 0;
+    // CPU time spent on the tasks (nanoseconds)
+    uint64_t task_clock_ns = 0;
+};
+
+/**
+ * Counters of the events of a single worker thread, read right before and after each task and summed per window of
+ * time. The counters must be opened by the thread they measure, and they are only touched by it.
+ */
+class PerfCounters {
+public:
+    /**
+     * @param window_ms the length of the windows the counts are summed over (milliseconds)
+     */
+    explicit PerfCounters(long window_ms) : window_ms(std::max(1L, window_ms)) {}
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters();
+
+    /**
+     * Open the counters of the calling thread, from the best available source.
+     * @param best the best source to try, weaker sources are tried after it
+     * @return the source of the counters
+     */
+    perf_source open(perf_source best = perf_source::hardware);
+
+    /**
+     * Read the counters before computing a task.
+     */
+    void begin();
+
+    /**
+     * Read the counters after computing a task, and add the difference to the current window.
+     */
+    void end();
+
+    [[nodiscard]] perf_source source() const {
+        return current_source;
+    }
+
+    /**
+     * @return the windows measured, with their time since the epoch of the system clock (milliseconds)
+     */
+    [[nodiscard]] const std::vector<perf_window>& windows() const {
+        return measured;
+    }
+
+    /**
+     * Sum the windows of a worker into the windows of the farm.
+     * @param into the windows of the farm, sorted by time
+     * @param from the windows of a worker, sorted by time since the epoch of the system clock
+     * @param start_ms the beginning of the farm since the epoch of the system clock (milliseconds)
+     */
+    static void merge(std::vector<perf_window> &into, const std::vector<perf_window> &from, long start_ms);
+
+private:
+    // position of each event in a read of the group
+    enum event { cycles, instructions, llc_misses, context_switches, task_clock, num_events };
+
+    long window_ms;
+    perf_source current_source = perf_source::none;
+    std::vector<int> fds;
+    // position in a read of the group of each event, -1 if not counted
+    int positions[num_events];
+    uint64_t before[num_events] = {};
+    std::vector<perf_window> measured;
+
+    /**
+     * Open a group of counters of the calling thread.
+     * @param events pairs <type, config> of the events, the first one being the leader
+     * @return true if every event was opened
+     */
+    bool openGroup(const std::vector<std::pair<uint32_t, uint64_t>> &events);
+
+    void close();
+
+    /**
+     * Read the current value of every event, scaled up to the whole time the group was enabled if it was multiplexed.
+     * @param values the values, indexed by event
+     */
+    void read(uint64_t values[num_events]);
+};
+
+PerfCounters::~PerfCounters() {
+    close();
+}
+
+perf_source PerfCounters::open(perf_source best) {
+    std::fill(std::begin(positions), std::end(positions), -1);
+    if (best == perf_source::hardware && openGroup({ { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES }, { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES }, { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+                    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK } })) {
+        for (int i = 0; i < num_events; ++i) positions[i] = i;
+        return current_source = perf_source::hardware;
+    }
+    if (best != perf_source::rusage && openGroup({ { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK }, { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES } })) {
+        positions[task_clock] = 0;
+        positions[context_switches] = 1;
+        return current_source = perf_source::software;
+    }
+    // getrusage is always available
+    return current_source = perf_source::rusage;
+}
+
+bool PerfCounters::openGroup(const std::vector<std::pair<uint32_t, uint64_t>> &events) {
+    close();
+    for (auto [type, config]: events) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        // the times tell how long the group was really counting, when the kernel multiplexes more events than counters
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // the hardware events of user space are allowed by the default perf_event_paranoid
+        attr.exclude_kernel = type == PERF_TYPE_HARDWARE;
+        attr.exclude_hv = 1;
+        // measure the calling thread on any CPU
+        int fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, fds.empty() ? -1:fds.front(), 0);
+        if (fd < 0) {
+            close();
+            return false;
+        }
+        fds.push_back(fd);
+    }
+    ioctl(fds.front(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds.front(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void PerfCounters::close() {
+    for (int fd: fds) ::close(fd);
+    fds.clear();
+}
+
+void PerfCounters::read(uint64_t values[num_events]) {
+    std::fill(values, values + num_events, 0);
+    if (current_source == perf_source::rusage) {
+        rusage usage{};
+        getrusage(RUSAGE_THREAD, &usage);
+        values[context_switches] = usage.ru_nvcsw + usage.ru_nivcsw;
+        values[task_clock] = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL
+                             + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+        return;
+    }
+    if (fds.empty()) return;
+    // a read of the group gives the number of events, the time enabled and running, then the values of the events
+    uint64_t group[num_events + 3];
+    if (::read(fds.front(), group, sizeof(group)) < (ssize_t) (3 * sizeof(uint64_t))) return;
+    uint64_t enabled = group[1], running = group[2];
+    // a group that never ran counted nothing, there is nothing to scale
+    double scale = running > 0 && running < enabled ? (double) enabled / (double) running:1.0;
+    for (int i = 0; i < num_events; ++i) {
+        if (positions[i] >= 0 && (uint64_t) positions[i] < group[0]) {
+            values[i] = (uint64_t) ((double) group[positions[i] + 3] * scale);
+        }
+    }
+}
+
+void PerfCounters::begin() {
+    read(before);
+}
+
+void PerfCounters::end() {
+    uint64_t after[num_events];
+    read(after);
+    long now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    long window_time = now_ms - now_ms % window_ms;
+    if (measured.empty() || measured.back().time != window_time) {
+        measured.emplace_back();
+        measured.back().time = window_time;
+        measured.back().workers = 1;
+    }
+    auto &window = measured.back();
+    window.cycles += after[cycles] - before[cycles];
+    window.instructions += after[instructions] - before[instructions];
+    window.llc_misses += after[llc_misses] - before[llc_misses];
+    window.context_switches += after[context_switches] - before[context_switches];
+    window.task_clock_ns += after[task_clock] - before[task_clock];
+}
+
+void PerfCounters::merge(std::vector<perf_window> &into, const std::vector<perf_window> &from, long start_ms) {
+    for (auto window: from) {
+        // windows are aligned to the epoch, so the first one may begin before the farm
+        window.time = std::max(0L, window.time - start_ms);
+        auto same = std::lower_bound(into.begin(), into.end(), window.time,
+                                     [](const perf_window &w, long time) { return w.time < time; });
+        if (same == into.end() || same->time != window.time) {
+            into.insert(same, window);
+            continue;
+        }
+        same->workers += window.workers;
+        same->cycles += window.cycles;
+        same->instructions += window.instructions;
+        same->llc_misses += window.llc_misses;
+        same->context_switches += window.context_switches;
+        same->task_clock_ns += window.task_clock_ns;
+    }
+}
+
+#endif //AUTONOMICFARM_PERFCOUNTERS_HPP
@@ -8,6 +8,9 @@
 #include <cmath>
 #include <unordered_map>
 #include <iomanip>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
 
 #define HELP_FLAG "--help"
 #define WORKERS_FLAG "-w"
@@ -17,6 +20,38 @@
 #define TARGET_SERVICE_TIME_FLAG "--target"
 #define SERVICE_TIME_FLAG "--service"
 #define ARRIVAL_TIME_FLAG "--arrival"
+#define ARRIVAL_DISTRIBUTION_FLAG "--arrival-dist"
+#define SERVICE_DISTRIBUTION_FLAG "--service-dist"
+#define SEED_FLAG "--seed"
+#define BURST_FACTOR_FLAG "--burst"
+#define PERIOD_FLAG "--period"
+#define SHAPE_FLAG "--shape"
+#define KERNEL_FLAG "--kernel"
+#define KERNEL_SIZE_FLAG "--kernel-size"
+#define TRACE_FILE_FLAG "--trace"
+#define FORECAST_FLAG "--forecast"
+#define STATE_FILE_FLAG "--state"
+#define CALIBRATION_FLAG "--calibrate"
+#define INLINE_FLAG "--inline"
+#define DISPATCH_FLAG "--dispatch"
+#define DISPATCH_DEPTH_FLAG "--dispatch-depth"
+#define PERF_FLAG "--perf"
+#define TRACE_EVENTS_FLAG "--trace-events"
+#define ASYNC_FLAG "--async"
+#define OUTPUT_FLAG "--output"
+#define OUTPUT_DIRECT_FLAG "--output-direct"
+#define SPILL_FLAG "--spill"
+#define SPILL_DIR_FLAG "--spill-dir"
+#define SHED_FLAG "--shed"
+#define MAX_QUEUE_FLAG "--max-queue"
+#define DELAY_TARGET_FLAG "--delay-target"
+#define TTL_FLAG "--ttl"
+#define PRIORITY_BELOW_FLAG "--priority-below"
+#define AGING_FLAG "--aging"
+#define PRIORITY_TARGET_FLAG "--priority-target"
+#define TENANT_BOUNDS_FLAG "--tenant-bounds"
+#define TENANT_WEIGHTS_FLAG "--tenant-weights"
+#define TENANT_CAPS_FLAG "--tenant-caps"
 #define DEFAULT_NUM_WORKERS 4
 #define DEFAULT_MIN_NUM_WORKERS 2
 #define DEFAULT_MAX_NUM_WORKERS 32
@@ -24,6 +59,32 @@
 #define DEFAULT_TARGET_SERVICE_TIME 0
 #define DEFAULT_SERVICE_TIME_MS std::vector<size_t>{ 8L }
 #define DEFAULT_ARRIVAL_TIME_MS std::vector<size_t>{ 5L }
+#define DEFAULT_DISTRIBUTION "fixed"
+#define DEFAULT_SEED 42
+#define DEFAULT_BURST_FACTOR 4
+#define DEFAULT_PERIOD_MS 1000
+#define DEFAULT_SHAPE 0
+#define DEFAULT_KERNEL "spin"
+#define DEFAULT_KERNEL_SIZE_KB 0
+#define DEFAULT_TRACE_FILE ""
+#define DEFAULT_STATE_FILE ""
+#define DEFAULT_CALIBRATION_TASKS 0
+#define DEFAULT_INLINE_MODE "off"
+#define DEFAULT_DISPATCH "rr"
+#define DEFAULT_DISPATCH_DEPTH 1
+#define DEFAULT_PERF_WINDOW_MS 0
+#define DEFAULT_TRACE_EVENTS_FILE ""
+#define DEFAULT_ASYNC_CONCURRENCY 0
+#define DEFAULT_OUTPUT_FILE ""
+#define DEFAULT_SPILL_THRESHOLD 0
+#define DEFAULT_SPILL_DIR "/var/tmp"
+#define DEFAULT_SHED_POLICY "none"
+#define DEFAULT_MAX_QUEUE 1000
+#define DEFAULT_DELAY_TARGET_MS 50
+#define DEFAULT_TTL_MS 0
+#define DEFAULT_PRIORITY_BELOW_MS 0
+#define DEFAULT_AGING_MS 1000
+#define DEFAULT_PRIORITY_TARGET 0
 
 struct program_args {
 public:
@@ -43,6 +104,71 @@ public:
     std::vector<size_t> serviceTimes;
     // arrival times of stream's items
     std::vector<size_t> arrivalTimes;
+    // distribution of the inter-arrival times: fixed, poisson, mmpp or diurnal
+    std::string arrival_distribution;
+    // distribution of the service times: fixed, pareto or lognormal
+    std::string service_distribution;
+    // seed of the random generators used by the distributions
+    size_t seed;
+    // ratio between the arrival rate of the bursty and of the quiet state of the mmpp distribution
+    double burst_factor;
+    // period of the diurnal distribution (milliseconds)
+    double period_ms;
+    // shape of the service time distribution (pareto alpha or lognormal sigma). Zero picks the distribution default
+    double shape;
+    // work executed by each task: spin, compute, stream, chase, alloc or mixed
+    std::string kernel;
+    // memory touched by the kernel of each worker (kilobytes). Zero picks the kernel default
+    size_t kernel_size_kb;
+    // csv file with the arrival and service times replayed by the simulator. Empty to simulate the given stream
+    std::string trace_file;
+    // scale the autonomic farm ahead of the forecast arrival rate
+    bool forecast;
+    // file where the autonomic controller loads its learned state from and saves it to. Empty to start from scratch
+    std::string state_file;
+    // tasks measured to calibrate the initial number of workers of the autonomic farm. Zero to start from num_workers
+    size_t calibration_tasks;
+    // tiny tasks computed by the sending thread when the farm is idle: off, worker or sink (worker and gatherer)
+    std::string inline_mode;
+    // how the farm dispatches the items to its workers: rr, jsq, p2c, ondemand or sed
+    std::string dispatch;
+    // maximum pending items of a worker with the on-demand dispatch
+    size_t dispatch_depth;
+    // length of the windows the hardware counters of the workers are summed over, zero to disable them
+    size_t perf_window_ms;
+    // file where the events of the farm are written as a Chrome trace. Empty to disable the tracing
+    std::string trace_events_file;
+    // maximum items in flight per worker of the autonomic farm, computed as coroutines. Zero to compute them one by one
+    size_t async_concurrency;
+    // file where the results are written by an asynchronous sink. Empty to drop the results
+    std::string output_file;
+    // write the results bypassing the page cache
+    bool output_direct;
+    // tasks waiting in the memory of the autonomic farm beyond which they are spilled to disk. Zero to keep them all in memory
+    size_t spill_threshold;
+    // directory of the files the tasks are spilled to
+    std::string spill_dir;
+    // what the autonomic farms do with the tasks arriving when they can't keep up: none, newest, oldest or early
+    std::string shed;
+    // waiting tasks beyond which the newest or the oldest ones are dropped
+    size_t max_queue;
+    // queue delay above which the tasks are dropped early (milliseconds)
+    double delay_target_ms;
+    // time a task may wait before being dropped unexecuted (milliseconds). Zero to never drop the waiting tasks
+    double ttl_ms;
+    // service time up to which the tasks are interactive, dispatched before the longer bulk ones. Zero for FIFO dispatch
+    size_t priority_below;
+    // time after which a bulk task goes before the interactive tasks arriving later (milliseconds)
+    double aging_ms;
+    // service time targeted for the interactive tasks. Zero to keep up with their arrivals
+    double priority_target;
+    // service times splitting the tasks among tenants sharing the autonomic farms: a task belongs to the tenant k if its
+    // service time is above k bounds. Empty for no tenants
+    std::vector<size_t> tenant_bounds;
+    // weight of each tenant, one for the missing ones
+    std::vector<double> tenant_weights;
+    // most workers of each tenant at once, zero or missing for no cap
+    std::vector<size_t> tenant_caps;
 
     static void usage(std::ostream &os, char* argv[]) {
         os << argv[0] << " [OPTIONS]" << std::endl;
@@ -55,6 +181,38 @@ public:
         os << "  " << SERVICE_TIME_FLAG << " arg         Service time values for tasks (space-separated) (default: " << DEFAULT_SERVICE_TIME_MS[0] << " ms)" << std::endl;
         os << "  " << ARRIVAL_TIME_FLAG << " arg         Arrival time values for tasks (space-separated) (default: " << DEFAULT_ARRIVAL_TIME_MS[0] << " ms)" << std::endl;
         os << "  " << TARGET_SERVICE_TIME_FLAG << " arg          Target service time (default: None)" << std::endl;
+        os << "  " << ARRIVAL_DISTRIBUTION_FLAG << " arg    Inter-arrival distribution: fixed, poisson, mmpp, diurnal (default: " << DEFAULT_DISTRIBUTION << ")" << std::endl;
+        os << "  " << SERVICE_DISTRIBUTION_FLAG << " arg    Service time distribution: fixed, pareto, lognormal (default: " << DEFAULT_DISTRIBUTION << ")" << std::endl;
+        os << "  " << SEED_FLAG << " arg            Seed of the arrival and service distributions (default: " << DEFAULT_SEED << ")" << std::endl;
+        os << "  " << BURST_FACTOR_FLAG << " arg           Burst factor of the mmpp arrivals (default: " << DEFAULT_BURST_FACTOR << ")" << std::endl;
+        os << "  " << PERIOD_FLAG << " arg          Period of the diurnal arrivals (default: " << DEFAULT_PERIOD_MS << " ms)" << std::endl;
+        os << "  " << SHAPE_FLAG << " arg           Pareto alpha or lognormal sigma (default: 2.5 or 0.5)" << std::endl;
+        os << "  " << KERNEL_FLAG << " arg          Task kernel: spin, compute, stream, chase, alloc, mixed, io (default: " << DEFAULT_KERNEL << ")" << std::endl;
+        os << "  " << KERNEL_SIZE_FLAG << " arg     Working set of the kernel per worker in KB (default: kernel specific)" << std::endl;
+        os << "  " << TRACE_FILE_FLAG << " arg           Trace replayed by the simulator (csv: arrival_ms,service_ms) (default: None)" << std::endl;
+        os << "  " << FORECAST_FLAG << "            Add workers ahead of the forecast arrival rate" << std::endl;
+        os << "  " << STATE_FILE_FLAG << " arg           Controller state loaded at start and saved at the end (default: None)" << std::endl;
+        os << "  " << CALIBRATION_FLAG << " arg       Tasks measured to choose the initial number of workers (default: " << DEFAULT_CALIBRATION_TASKS << ", off)" << std::endl;
+        os << "  " << INLINE_FLAG << " arg          Compute tiny tasks on the sending thread at light load: off, worker, sink (default: " << DEFAULT_INLINE_MODE << ")" << std::endl;
+        os << "  " << DISPATCH_FLAG << " arg        Dispatch of the items to the workers: rr, jsq, p2c, ondemand, sed (default: " << DEFAULT_DISPATCH << ")" << std::endl;
+        os << "  " << DISPATCH_DEPTH_FLAG << " arg  Maximum pending items of a worker with the ondemand dispatch (default: " << DEFAULT_DISPATCH_DEPTH << ")" << std::endl;
+        os << "  " << PERF_FLAG << " arg            Window of the hardware counters of the workers in ms (default: " << DEFAULT_PERF_WINDOW_MS << ", off)" << std::endl;
+        os << "  " << TRACE_EVENTS_FLAG << " arg    Chrome trace of the events of the farm, for Perfetto (default: None)" << std::endl;
+        os << "  " << ASYNC_FLAG << " arg           Maximum tasks in flight per autonomic worker, run as coroutines (default: " << DEFAULT_ASYNC_CONCURRENCY << ", off)" << std::endl;
+        os << "  " << OUTPUT_FLAG << " arg          File the results are written to, by a writer thread (default: None)" << std::endl;
+        os << "  " << OUTPUT_DIRECT_FLAG << "       Write the results with O_DIRECT, bypassing the page cache" << std::endl;
+        os << "  " << SPILL_FLAG << " arg           Waiting tasks kept in memory before spilling to disk (default: " << DEFAULT_SPILL_THRESHOLD << ", off)" << std::endl;
+        os << "  " << SPILL_DIR_FLAG << " arg       Directory of the spilled tasks, on disk: /tmp is often in memory (default: " << DEFAULT_SPILL_DIR << ")" << std::endl;
+        os << "  " << SHED_FLAG << " arg            Tasks dropped when the farm can't keep up: none, newest, oldest, early (default: " << DEFAULT_SHED_POLICY << ")" << std::endl;
+        os << "  " << MAX_QUEUE_FLAG << " arg       Waiting tasks beyond which the newest or oldest are dropped (default: " << DEFAULT_MAX_QUEUE << ")" << std::endl;
+        os << "  " << DELAY_TARGET_FLAG << " arg    Queue delay above which the tasks are dropped early (default: " << DEFAULT_DELAY_TARGET_MS << " ms)" << std::endl;
+        os << "  " << TTL_FLAG << " arg             Time a task may wait before being dropped unexecuted (default: " << DEFAULT_TTL_MS << " ms, off)" << std::endl;
+        os << "  " << PRIORITY_BELOW_FLAG << " arg  Service time up to which the tasks are dispatched first (default: " << DEFAULT_PRIORITY_BELOW_MS << " ms, off)" << std::endl;
+        os << "  " << AGING_FLAG << " arg           Wait after which a long task goes before the short ones (default: " << DEFAULT_AGING_MS << " ms)" << std::endl;
+        os << "  " << PRIORITY_TARGET_FLAG << " arg Target service time of the short tasks (default: their arrival time)" << std::endl;
+        os << "  " << TENANT_BOUNDS_FLAG << " arg   Service times splitting the tasks among tenants, shared fairly (space-separated) (default: None)" << std::endl;
+        os << "  " << TENANT_WEIGHTS_FLAG << " arg  Weight of each tenant (space-separated) (default: 1)" << std::endl;
+        os << "  " << TENANT_CAPS_FLAG << " arg     Most workers of each tenant at once (space-separated) (default: 0, no cap)" << std::endl;
         os << "  " << HELP_FLAG << "                Show this usage";
     }
 
@@ -72,7 +230,31 @@ private:
     program_args(bool help, size_t numWorkers, size_t minNumWorkers, size_t maxNumWorkers, double reqServiceTime, size_t streamSize,
                  const std::vector<size_t> &serviceTimes, const std::vector<size_t> &arrivalTimes)
     : help(help), num_workers(numWorkers), min_num_workers(minNumWorkers), max_num_workers(maxNumWorkers),
-    target_service_time(reqServiceTime), stream_size(streamSize), serviceTimes(serviceTimes), arrivalTimes(arrivalTimes) {}
+    target_service_time(reqServiceTime), stream_size(streamSize), serviceTimes(serviceTimes), arrivalTimes(arrivalTimes),
+    arrival_distribution(DEFAULT_DISTRIBUTION), service_distribution(DEFAULT_DISTRIBUTION), seed(DEFAULT_SEED),
+    burst_factor(DEFAULT_BURST_FACTOR), period_ms(DEFAULT_PERIOD_MS), shape(DEFAULT_SHAPE), kernel(DEFAULT_KERNEL),
+    kernel_size_kb(DEFAULT_KERNEL_SIZE_KB), trace_file(DEFAULT_TRACE_FILE), forecast(false),
+    state_file(DEFAULT_STATE_FILE), calibration_tasks(DEFAULT_CALIBRATION_TASKS),
+    inline_mode(DEFAULT_INLINE_MODE),
+    dispatch(DEFAULT_DISPATCH),
+    dispatch_depth(DEFAULT_DISPATCH_DEPTH),
+    perf_window_ms(DEFAULT_PERF_WINDOW_MS),
+    trace_events_file(DEFAULT_TRACE_EVENTS_FILE),
+    async_concurrency(DEFAULT_ASYNC_CONCURRENCY),
+    output_file(DEFAULT_OUTPUT_FILE),
+    output_direct(false),
+    spill_threshold(DEFAULT_SPILL_THRESHOLD),
+    spill_dir(DEFAULT_SPILL_DIR),
+    shed(DEFAULT_SHED_POLICY),
+    max_queue(DEFAULT_MAX_QUEUE),
+    delay_target_ms(DEFAULT_DELAY_TARGET_MS),
+    ttl_ms(DEFAULT_TTL_MS),
+    priority_below(DEFAULT_PRIORITY_BELOW_MS),
+    aging_ms(DEFAULT_AGING_MS),
+    priority_target(DEFAULT_PRIORITY_TARGET) {}
+
+    template<typename ValueType>
+    static ValueType parse_value(std::string_view value);
 
     static void proportions_to_stream(std::ostream &os, size_t stream_size, const std::vector<size_t>& data, std::string_view label);
 };
@@ -80,13 +262,24 @@ private:
 #define GET_ARG(type, name, map,  flag, default_value) \
 type name = default_value; \
 if (map.contains(flag) && !map[flag].empty()) { \
-    name = map[flag][0]; \
+    name = parse_value<type>(map[flag][0]); \
 } \
 
+template<typename ValueType>
+ValueType program_args::parse_value(std::string_view value) {
+    if constexpr (std::is_same_v<ValueType, std::string>) {
+        return std::string(value);
+    } else if constexpr (std::is_floating_point_v<ValueType>) {
+        return std::stod(std::string(value));
+    } else {
+        return std::stoi(std::string(value));
+    }
+}
+
 program_args program_args::build(int argc, char* argv[]) {
     const std::vector<std::string_view> args(argv + 1, argv + argc);
     std::string_view last_flag = "beginning_with_no_flag"; // first arguments, not preceded by a flag
-    std::unordered_map<std::string_view, std::vector<size_t>> flags_to_values;
+    std::unordered_map<std::string_view, std::vector<std::string_view>> flags_to_values;
 
     bool help = false;
 
@@ -99,7 +292,7 @@ program_args program_args::build(int argc, char* argv[]) {
                 flags_to_values[last_flag] = {};
             }
         } else {
-            flags_to_values[last_flag].push_back(std::stoi(arg.data()));
+            flags_to_values[last_flag].push_back(arg);
         }
     }
 
@@ -109,13 +302,91 @@ program_args program_args::build(int argc, char* argv[]) {
     GET_ARG(size_t, stream_size, flags_to_values, STREAM_SIZE_FLAG, DEFAULT_STREAM_SIZE)
     GET_ARG(double, target_service_time, flags_to_values, TARGET_SERVICE_TIME_FLAG, DEFAULT_TARGET_SERVICE_TIME)
 
-    auto service_times = flags_to_values.contains(SERVICE_TIME_FLAG) ? flags_to_values[SERVICE_TIME_FLAG]:DEFAULT_SERVICE_TIME_MS;
-    if (service_times.size() > stream_size) service_times.resize(stream_size);
+    GET_ARG(std::string, arrival_distribution, flags_to_values, ARRIVAL_DISTRIBUTION_FLAG, DEFAULT_DISTRIBUTION)
+    GET_ARG(std::string, service_distribution, flags_to_values, SERVICE_DISTRIBUTION_FLAG, DEFAULT_DISTRIBUTION)
+    GET_ARG(size_t, seed, flags_to_values, SEED_FLAG, DEFAULT_SEED)
+    GET_ARG(double, burst_factor, flags_to_values, BURST_FACTOR_FLAG, DEFAULT_BURST_FACTOR)
+    GET_ARG(double, period_ms, flags_to_values, PERIOD_FLAG, DEFAULT_PERIOD_MS)
+    // the diurnal distribution divides by the period
+    if (period_ms <= 0) throw std::invalid_argument("the period must be positive: " + std::to_string(period_ms));
+    GET_ARG(double, shape, flags_to_values, SHAPE_FLAG, DEFAULT_SHAPE)
+    GET_ARG(std::string, kernel, flags_to_values, KERNEL_FLAG, DEFAULT_KERNEL)
+    GET_ARG(size_t, kernel_size_kb, flags_to_values, KERNEL_SIZE_FLAG, DEFAULT_KERNEL_SIZE_KB)
+    GET_ARG(std::string, trace_file, flags_to_values, TRACE_FILE_FLAG, DEFAULT_TRACE_FILE)
+    GET_ARG(std::string, state_file, flags_to_values, STATE_FILE_FLAG, DEFAULT_STATE_FILE)
+    GET_ARG(size_t, calibration_tasks, flags_to_values, CALIBRATION_FLAG, DEFAULT_CALIBRATION_TASKS)
+    GET_ARG(std::string, inline_mode, flags_to_values, INLINE_FLAG, DEFAULT_INLINE_MODE)
+    GET_ARG(std::string, dispatch, flags_to_values, DISPATCH_FLAG, DEFAULT_DISPATCH)
+    GET_ARG(size_t, dispatch_depth, flags_to_values, DISPATCH_DEPTH_FLAG, DEFAULT_DISPATCH_DEPTH)
+    GET_ARG(size_t, perf_window_ms, flags_to_values, PERF_FLAG, DEFAULT_PERF_WINDOW_MS)
+    GET_ARG(std::string, trace_events_file, flags_to_values, TRACE_EVENTS_FLAG, DEFAULT_TRACE_EVENTS_FILE)
+    GET_ARG(size_t, async_concurrency, flags_to_values, ASYNC_FLAG, DEFAULT_ASYNC_CONCURRENCY)
+    GET_ARG(std::string, output_file, flags_to_values, OUTPUT_FLAG, DEFAULT_OUTPUT_FILE)
+    GET_ARG(size_t, spill_threshold, flags_to_values, SPILL_FLAG, DEFAULT_SPILL_THRESHOLD)
+    GET_ARG(std::string, spill_dir, flags_to_values, SPILL_DIR_FLAG, DEFAULT_SPILL_DIR)
+    GET_ARG(std::string, shed, flags_to_values, SHED_FLAG, DEFAULT_SHED_POLICY)
+    GET_ARG(size_t, max_queue, flags_to_values, MAX_QUEUE_FLAG, DEFAULT_MAX_QUEUE)
+    GET_ARG(double, delay_target_ms, flags_to_values, DELAY_TARGET_FLAG, DEFAULT_DELAY_TARGET_MS)
+    GET_ARG(double, ttl_ms, flags_to_values, TTL_FLAG, DEFAULT_TTL_MS)
+    GET_ARG(size_t, priority_below, flags_to_values, PRIORITY_BELOW_FLAG, DEFAULT_PRIORITY_BELOW_MS)
+    GET_ARG(double, aging_ms, flags_to_values, AGING_FLAG, DEFAULT_AGING_MS)
+    GET_ARG(double, priority_target, flags_to_values, PRIORITY_TARGET_FLAG, DEFAULT_PRIORITY_TARGET)
 
-    auto arrival_times = flags_to_values.contains(ARRIVAL_TIME_FLAG) ? flags_to_values[ARRIVAL_TIME_FLAG]:DEFAULT_ARRIVAL_TIME_MS;
+    auto service_times = DEFAULT_SERVICE_TIME_MS;
+    if (flags_to_values.contains(SERVICE_TIME_FLAG)) {
+        service_times.clear();
+        for (auto &value: flags_to_values[SERVICE_TIME_FLAG]) service_times.push_back(parse_value<size_t>(value));
+    }
     if (service_times.size() > stream_size) service_times.resize(stream_size);
 
-    return { help, num_workers, min_num_workers, max_num_workers, target_service_time, stream_size, service_times, arrival_times };
+    auto arrival_times = DEFAULT_ARRIVAL_TIME_MS;
+    if (flags_to_values.contains(ARRIVAL_TIME_FLAG)) {
+        arrival_times.clear();
+        for (auto &value: flags_to_values[ARRIVAL_TIME_FLAG]) arrival_times.push_back(parse_value<size_t>(value));
+    }
+    if (arrival_times.size() > stream_size) arrival_times.resize(stream_size);
+
+    std::vector<size_t> tenant_bounds, tenant_caps;
+    std::vector<double> tenant_weights;
+    for (auto &value: flags_to_values[TENANT_BOUNDS_FLAG]) tenant_bounds.push_back(parse_value<size_t>(value));
+    std::sort(tenant_bounds.begin(), tenant_bounds.end());
+    for (auto &value: flags_to_values[TENANT_WEIGHTS_FLAG]) tenant_weights.push_back(parse_value<double>(value));
+    for (auto &value: flags_to_values[TENANT_CAPS_FLAG]) tenant_caps.push_back(parse_value<size_t>(value));
+
+    program_args built{ help, num_workers, min_num_workers, max_num_workers, target_service_time, stream_size, service_times, arrival_times };
+    built.arrival_distribution = arrival_distribution;
+    built.service_distribution = service_distribution;
+    built.seed = seed;
+    built.burst_factor = burst_factor;
+    built.period_ms = period_ms;
+    built.shape = shape;
+    built.kernel = kernel;
+    built.kernel_size_kb = kernel_size_kb;
+    built.trace_file = trace_file;
+    built.forecast = flags_to_values.contains(FORECAST_FLAG);
+    built.state_file = state_file;
+    built.calibration_tasks = calibration_tasks;
+    built.inline_mode = inline_mode;
+    built.dispatch = dispatch;
+    built.dispatch_depth = dispatch_depth;
+    built.perf_window_ms = perf_window_ms;
+    built.trace_events_file = trace_events_file;
+    built.async_concurrency = async_concurrency;
+    built.output_file = output_file;
+    built.output_direct = flags_to_values.contains(OUTPUT_DIRECT_FLAG);
+    built.spill_threshold = spill_threshold;
+    built.spill_dir = spill_dir;
+    built.shed = shed;
+    built.max_queue = max_queue;
+    built.delay_target_ms = delay_target_ms;
+    built.ttl_ms = ttl_ms;
+    built.priority_below = priority_below;
+    built.aging_ms = aging_ms;
+    built.priority_target = priority_target;
+    built.tenant_bounds = tenant_bounds;
+    built.tenant_weights = tenant_weights;
+    built.tenant_caps = tenant_caps;
+    return built;
 }
 
 #define NUMBER_OF_DIGITS(integer) (integer == 0 ? 1:(int) std::log10((double) (integer)) + 1)
@@ -128,6 +399,13 @@ std::ostream &operator<<(std::ostream &os, const program_args &args) {
     program_args::proportions_to_stream(os, args.stream_size, args.arrivalTimes, "arrival times");
     os << std::endl;
     program_args::proportions_to_stream(os, args.stream_size, args.serviceTimes, "service times");
+    if (args.arrival_distribution != DEFAULT_DISTRIBUTION || args.service_distribution != DEFAULT_DISTRIBUTION) {
+        os << std::endl << "Arrival distribution: " << args.arrival_distribution;
+        os << ", service distribution: " << args.service_distribution << ", seed: " << args.seed;
+    }
+    if (args.kernel != DEFAULT_KERNEL) {
+        os << std::endl << "Kernel: " << args.kernel;
+    }
     return os;
 }
 
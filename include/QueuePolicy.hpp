@@ -0,0 +1,271 @@
+#ifndef AUTONOMICFARM_QUEUEPOLICY_HPP
+#define AUTONOMICFARM_QUEUEPOLICY_HPP
+
+#include <deque>
+#include <optional>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+#include <cstdint>
+#include "AdmissionControl.hpp"
+#include "TaskPriority.hpp"
+#include "FairQueue.hpp"
+
+/**
+ * An element waiting in a stream, along with what the stream and its policies know about it.
+ * @tparam T the type of the value
+ */
+template<typename T>
+struct queued_element {
+    T value;
+    std::chrono::steady_clock::time_point added; // when it was added, if the stream records it
+    uint32_t tag = 0;
+    uint32_t priority_class = 0;
+    std::chrono::steady_clock::time_point due; // virtual deadline, if the priorities are enabled
+    uint32_t tenant = 0; // if the tenants are enabled
+};
+
+/**
+ * The policies of a stream, each one enabled on its own: the priorities decide where an element is queued, the
+ * admission control which elements are dropped, and the tenants which element is queued next. The stream keeps the
+ * elements and calls the policies holding its lock, so they are not thread safe.
+ * @tparam T the type of the values
+ */
+template<typename T>
+class QueuePolicy {
+public:
+    using element = queued_element<T>;
+    // function called with every element dropped by the admission control, along with its tag
+    using ShedFunType = std::function<void(T&, uint32_t)>;
+    // function giving the tenant of an element
+    using TenantFunType = std::function<uint32_t(const T&)>;
+
+    /**
+     * Queue the elements earliest virtual deadline first instead of in FIFO order, as given by their priority: the
+     * elements without a deadline are due at their arrival plus the aging period times their class.
+     * @param aging_ms the aging period of the classes (milliseconds)
+     */
+    void enablePriorities(double aging_ms) {
+        ordered = true;
+        aging = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(aging_ms));
+    }
+
+    bool prioritized() const {
+        return ordered;
+    }
+
+    /**
+     * Let the given admission control decide which elements are added and which ones are dropped.
+     * @param admission the admission control, copied
+     * @param on_shed the function called with every element dropped
+     */
+    void enableAdmission(const AdmissionControl &admission, const ShedFunType &on_shed) {
+        this->admission = std::make_unique<AdmissionControl>(admission);
+        this->on_shed = on_shed;
+    }
+
+    bool admitting() const {
+        return admission != nullptr;
+    }
+
+    /**
+     * Keep the elements of each tenant in a sub-queue of its own, from which they are taken by weighted deficit round
+     * robin.
+     * @param tenant_of the function giving the tenant of an element, numbered from zero
+     */
+    void enableTenants(const TenantFunType &tenant_of) {
+        this->tenant_of = tenant_of;
+        tenants = std::make_unique<FairQueue<element>>();
+    }
+
+    bool fair() const {
+        return tenants != nullptr;
+    }
+
+    /**
+     * Give an element being added its class, its virtual deadline and its tenant, as the policies enabled need them.
+     */
+    void stamp(element &e, const task_priority &priority) const;
+
+    /**
+     * Insert an element into a queue: at the end, or after the elements due before it if the priorities are enabled.
+     */
+    void insert(std::deque<element> &queue, element &e) const;
+
+    /**
+     * Decide about an arriving element, if the admission control is enabled.
+     * @param waiting the number of elements waiting in the stream
+     * @param added the point in time of the arrival
+     * @return empty to add the element, oldest to add it and drop the oldest one, otherwise why the element is dropped
+     */
+    std::optional<shed_reason> onArrival(size_t waiting, std::chrono::steady_clock::time_point added) {
+        return admission ? admission->onArrival(waiting, added):std::nullopt;
+    }
+
+    /**
+     * @return true if the deadline of an element about to be taken passed, if the admission control is enabled
+     */
+    bool expired(const element &e, std::chrono::steady_clock::time_point now) const {
+        return admission && admission->expired(e.added, now);
+    }
+
+    /**
+     * Measure the queue delay from an element about to be taken, if the admission control is enabled.
+     */
+    void onDeparture(const element &e, std::chrono::steady_clock::time_point now) {
+        if (admission) admission->onDeparture(e.added, now);
+    }
+
+    /**
+     * Drop an element, as decided by the admission control, keeping it for on_shed.
+     */
+    void shed(element &e, shed_reason reason) {
+        admission->onShed(reason);
+        if (on_shed) dropped.emplace_back(std::move(e.value), e.tag);
+    }
+
+    /**
+     * @return the elements dropped since the last call, with their tags, to give to notifyShed once the lock of the
+     * stream is released
+     */
+    std::vector<std::pair<T, uint32_t>> takeDropped() {
+        return std::exchange(dropped, {});
+    }
+
+    /**
+     * @return true if some element was dropped since the last call to takeDropped
+     */
+    bool shedding() const {
+        return !dropped.empty();
+    }
+
+    /**
+     * Give the elements dropped to on_shed.
+     */
+    void notifyShed(std::vector<std::pair<T, uint32_t>> &elements) const {
+        for (auto &[value, tag]: elements) on_shed(value, tag);
+    }
+
+    /**
+     * @return how many elements were admitted and dropped so far
+     */
+    shed_stats shedStats() const {
+        return admission ? admission->stats():shed_stats();
+    }
+
+    /**
+     * Add an element to the sub-queue of its tenant. The tenants must be enabled.
+     */
+    void push(element &e) {
+        tenants->push(e.tenant, e, ordered ? e.due:std::chrono::steady_clock::time_point());
+    }
+
+    /**
+     * @return the next element of the tenants, if some tenant has one and is not capped
+     */
+    std::optional<element> pop() {
+        uint32_t tenant;
+        return tenants ? tenants->pop(tenant):std::nullopt;
+    }
+
+    /**
+     * @return the oldest element of the tenant with the most elements waiting, or the one due last if the priorities
+     * are enabled, if the tenants are enabled and have some
+     */
+    std::optional<element> popLongest() {
+        uint32_t tenant;
+        return tenants ? tenants->popLongest(tenant, ordered):std::nullopt;
+    }
+
+    /**
+     * Free the place of an element taken from the tenants and dropped, if the tenants are enabled.
+     */
+    void release(uint32_t tenant) {
+        if (tenants) tenants->release(tenant);
+    }
+
+    /**
+     * Tell that an element of a tenant was computed, if the tenants are enabled.
+     * @param tenant the tenant of the element
+     * @param service_ms the time spent computing the element (milliseconds), negative if unknown
+     */
+    void done(uint32_t tenant, double service_ms) {
+        if (tenants) tenants->done(tenant, service_ms);
+    }
+
+    void setTenantWeight(uint32_t tenant, double weight) {
+        tenants->setWeight(tenant, weight);
+    }
+
+    void setTenantCap(uint32_t tenant, size_t max_in_flight) {
+        tenants->setCap(tenant, max_in_flight);
+    }
+
+    /**
+     * @return the number of elements waiting in the sub-queues of the tenants
+     */
+    size_t waiting() const {
+        return tenants ? tenants->size():0;
+    }
+
+    /**
+     * @return true if no element waits in the sub-queues of the tenants
+     */
+    bool drained() const {
+        return !tenants || tenants->empty();
+    }
+
+    /**
+     * @return the most workers the tenants can use, the maximum value of size_t if the tenants are not enabled or some
+     * of them is not capped
+     */
+    size_t usefulWorkers() const {
+        return tenants ? tenants->usefulWorkers():std::numeric_limits<size_t>::max();
+    }
+
+    /**
+     * @return the most elements waiting and in flight at once of each tenant, if the tenants are enabled
+     */
+    std::vector<tenant_stats> tenantStats() const {
+        return tenants ? tenants->stats():std::vector<tenant_stats>();
+    }
+
+private:
+    // priorities, if enabled
+    bool ordered = false;
+    std::chrono::steady_clock::duration aging{0};
+    // admission control, if enabled, and the elements dropped not given to on_shed yet
+    std::unique_ptr<AdmissionControl> admission;
+    ShedFunType on_shed;
+    std::vector<std::pair<T, uint32_t>> dropped;
+    // sub-queues of the tenants, if enabled
+    TenantFunType tenant_of;
+    std::unique_ptr<FairQueue<element>> tenants;
+};
+
+template<typename T>
+void QueuePolicy<T>::stamp(element &e, const task_priority &priority) const {
+    if (ordered) {
+        e.priority_class = priority.priority_class;
+        e.due = priority.dispatchBy(e.added, aging);
+    }
+    if (tenants) e.tenant = tenant_of(e.value);
+}
+
+template<typename T>
+void QueuePolicy<T>::insert(std::deque<element> &queue, element &e) const {
+    if (!ordered) {
+        queue.push_back(std::move(e));
+        return;
+    }
+    // after the elements due at the same time, to keep their order
+    auto position = std::upper_bound(queue.begin(), queue.end(), e.due,
+                                     [](auto due, const element &other) { return due < other.due; });
+    queue.insert(position, std::move(e));
+}
+
+#endif //AUTONOMICFARM_QUEUEPOLICY_HPP
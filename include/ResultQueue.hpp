@@ -0,0 +1,185 @@
+#ifndef AUTONOMICFARM_RESULTQUEUE_HPP
+#define AUTONOMICFARM_RESULTQUEUE_HPP
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <iterator>
+#include <algorithm>
+
+/**
+ * A bounded queue of the results of a farm, from which the consumer pulls them. When the queue is full the gatherer
+ * waits for the consumer to make room, and the time it waits is counted apart, as the slowness of the consumer.
+ * @tparam T the type of the results
+ */
+template<typename T>
+class ResultQueue {
+public:
+    /**
+     * An input iterator taking the results out of the queue, until the queue is closed and empty.
+     */
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        iterator() = default;
+        explicit iterator(ResultQueue* queue) : queue(queue), current(queue->pop()) {}
+
+        T& operator*() {
+            return *current;
+        }
+
+        T* operator->() {
+            return &*current;
+        }
+
+        iterator& operator++() {
+            current = queue->pop();
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        bool operator==(std::default_sentinel_t) const {
+            return !current.has_value();
+        }
+
+    private:
+        ResultQueue* queue = nullptr;
+        std::optional<T> current;
+    };
+
+    /**
+     * @param capacity the maximum number of results waiting for the consumer
+     */
+    explicit ResultQueue(size_t capacity) : max_size(std::max<size_t>(1, capacity)) {}
+
+    /**
+     * Add a result, waiting while the queue is full.
+     * @param value the result. It is moved and not copied
+     */
+    void push(T& value);
+
+    /**
+     * Take the next result, waiting for it.
+     * @return the next result, or an empty optional if the queue is closed and empty
+     */
+    std::optional<T> pop();
+
+    /**
+     * Take the next result without waiting for it.
+     * @return the next result, or an empty optional if there is none now
+     */
+    std::optional<T> try_pop();
+
+    /**
+     * Tell that no more results will be added, so that the consumer stops once it took the remaining ones.
+     */
+    void close();
+
+    /**
+     * @return true if the queue is closed and every result was taken
+     */
+    bool done();
+
+    /**
+     * @return an iterator over the results, taking each one out of the queue
+     */
+    iterator begin() {
+        return iterator(this);
+    }
+
+    std::default_sentinel_t end() {
+        return std::default_sentinel;
+    }
+
+    size_t capacity() const {
+        return max_size;
+    }
+
+    /**
+     * @return the time the results waited for room in the queue, because of a slow consumer (nanoseconds)
+     */
+    long blockedTime();
+
+private:
+    std::mutex mutex;
+    std::condition_variable cond_empty;
+    std::condition_variable cond_full;
+    std::deque<T> queue;
+    size_t max_size;
+    bool closed = false;
+    long blocked_ns = 0;
+};
+
+template<typename T>
+void ResultQueue<T>::push(T &value) {
+    {
+        std::unique_lock lock(mutex);
+        if (queue.size() >= max_size) {
+            auto blocked_from = std::chrono::steady_clock::now();
+            cond_full.wait(lock, [this]() { return queue.size() < max_size; });
+            blocked_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - blocked_from).count();
+        }
+        queue.push_back(std::move(value));
+    }
+    cond_empty.notify_one();
+}
+
+template<typename T>
+std::optional<T> ResultQueue<T>::pop() {
+    std::optional<T> value;
+    {
+        std::unique_lock lock(mutex);
+        cond_empty.wait(lock, [this]() { return closed || !queue.empty(); });
+        if (queue.empty()) return {};
+        value.emplace(std::move(queue.front()));
+        queue.pop_front();
+    }
+    cond_full.notify_one();
+    return value;
+}
+
+template<typename T>
+std::optional<T> ResultQueue<T>::try_pop() {
+    std::optional<T> value;
+    {
+        std::unique_lock lock(mutex);
+        if (queue.empty()) return {};
+        value.emplace(std::move(queue.front()));
+        queue.pop_front();
+    }
+    cond_full.notify_one();
+    return value;
+}
+
+template<typename T>
+void ResultQueue<T>::close() {
+    {
+        std::unique_lock lock(mutex);
+        closed = true;
+    }
+    cond_empty.notify_all();
+}
+
+template<typename T>
+bool ResultQueue<T>::done() {
+    std::unique_lock lock(mutex);
+    return closed && queue.empty();
+}
+
+template<typename T>
+long ResultQueue<T>::blockedTime() {
+    std::unique_lock lock(mutex);
+    return blocked_ns;
+}
+
+#endif //AUTONOMICFARM_RESULTQUEUE_HPP
@@ -0,0 +1,167 @@
+#ifndef AUTONOMICFARM_SCALABILITYMODEL_HPP
+#define AUTONOMICFARM_SCALABILITYMODEL_HPP
+
+#include <vector>
+#include <algorithm>
+
+/**
+ * Online model of the throughput reached by the farm with each number of workers. The throughput of a number of
+ * workers is their count over the service time of a single worker while they all run, so it shows the slowdown caused
+ * by the contention on memory bandwidth, caches or locks, regardless of how loaded the farm is. Observed counts keep an
+ * exponential moving average of their throughput, the other counts are interpolated between the observed ones and
+ * extrapolated with the marginal gain of the largest observed counts, so that once the curve flattens no further gain
+ * is expected from more workers.
+ */
+class ScalabilityModel {
+public:
+    /**
+     * @param max_num_workers the maximum number of workers that can be observed
+     * @param smoothing weight of the newest observation on the throughput of a number of workers
+     * @param saturation_gain minimum throughput gain of one more worker, as a fraction of the throughput of a worker,
+     * for the worker to be useful
+     */
+    explicit ScalabilityModel(size_t max_num_workers, double smoothing = 0.3, double saturation_gain = 0.1)
+    : points(max_num_workers), smoothing(smoothing), saturation_gain(saturation_gain) {}
+
+    /**
+     * Add an observation of the service time of a worker while the given number of workers is running.
+     * @param num_workers the number of running workers
+     * @param worker_service_time the service time of a worker (milliseconds)
+     */
+    void observe(size_t num_workers, double worker_service_time);
+
+    /**
+     * Restore the throughput of a number of workers learned by a previous run. It is replaced by the newer observations
+     * as they come.
+     * @param num_workers the number of workers
+     * @param throughput the throughput learned (tasks per millisecond)
+     * @param samples how many observations the throughput was learned from
+     */
+    void restore(size_t num_workers, double throughput, size_t samples);
+
+    /**
+     * Predict the throughput of the given number of workers.
+     * @param num_workers the number of workers
+     * @return the throughput (tasks per millisecond), or zero if nothing was observed yet
+     */
+    [[nodiscard]] double throughput(size_t num_workers) const;
+
+    /**
+     * @return the smallest number of workers after which no worker is useful anymore
+     */
+    [[nodiscard]] size_t knee() const;
+
+    /**
+     * Choose the smallest number of workers whose predicted throughput reaches the target. If no number of workers
+     * reaches it, choose the knee of the curve, since more workers would only waste resources.
+     * @param target_throughput the throughput needed (tasks per millisecond)
+     * @param min_num_workers the minimum number of workers
+     * @param max_num_workers the maximum number of workers
+     * @return the number of workers
+     */
+    [[nodiscard]] size_t workersFor(double target_throughput, size_t min_num_workers, size_t max_num_workers) const;
+
+    /**
+     * @return true if at least two different numbers of workers were observed, hence the shape of the curve is known
+     */
+    [[nodiscard]] bool isReady() const;
+
+    /**
+     * @param num_workers the number of workers
+     * @return the observed throughput of the given number of workers (tasks per millisecond), or zero if never observed
+     */
+    [[nodiscard]] double observedThroughput(size_t num_workers) const {
+        return points[num_workers - 1].throughput;
+    }
+
+    /**
+     * @param num_workers the number of workers
+     * @return how many times the given number of workers was observed
+     */
+    [[nodiscard]] size_t samples(size_t num_workers) const {
+        return points[num_workers - 1].samples;
+    }
+
+private:
+    struct point {
+        double throughput = 0.0;
+        size_t samples = 0;
+    };
+
+    std::vector<point> points; // indexed by number of workers - 1
+    double smoothing;
+    double saturation_gain;
+};
+
+void ScalabilityModel::observe(size_t num_workers, double worker_service_time) {
+    if (num_workers == 0 || num_workers > points.size() || worker_service_time <= 0) return;
+    auto &observed = points[num_workers - 1];
+    double throughput = (double) num_workers / worker_service_time;
+    observed.throughput = observed.samples == 0 ? throughput:smoothing * throughput + (1 - smoothing) * observed.throughput;
+    observed.samples++;
+}
+
+void ScalabilityModel::restore(size_t num_workers, double throughput, size_t samples) {
+    if (num_workers == 0 || num_workers > points.size() || throughput <= 0 || samples == 0) return;
+    points[num_workers - 1] = { throughput, samples };
+}
+
+double ScalabilityModel::throughput(size_t num_workers) const {
+    // nearest observed number of workers below and above the given one, and the largest two observed
+    size_t lower = 0, upper = 0, largest = 0, second_largest = 0;
+    for (size_t n = 1; n <= points.size(); ++n) {
+        if (points[n - 1].samples == 0) continue;
+        if (n == num_workers) return points[n - 1].throughput;
+        if (n < num_workers) lower = n;
+        if (n > num_workers && upper == 0) upper = n;
+        second_largest = largest;
+        largest = n;
+    }
+    if (largest == 0) return 0.0;
+
+    if (lower != 0 && upper != 0) {
+        double fraction = (double) (num_workers - lower) / (double) (upper - lower);
+        return points[lower - 1].throughput + fraction * (points[upper - 1].throughput - points[lower - 1].throughput);
+    }
+    if (lower == 0) {
+        // fewer workers than any observed one can't do better than the same throughput per worker
+        return points[upper - 1].throughput * (double) num_workers / (double) upper;
+    }
+    if (second_largest == 0) {
+        // a single observation, assume linear scaling
+        return points[largest - 1].throughput * (double) num_workers / (double) largest;
+    }
+    // continue the curve with the marginal gain of the largest observed numbers of workers, never going down
+    double marginal_gain = (points[largest - 1].throughput - points[second_largest - 1].throughput)
+                           / (double) (largest - second_largest);
+    return points[largest - 1].throughput + std::max(0.0, marginal_gain) * (double) (num_workers - largest);
+}
+
+size_t ScalabilityModel::knee() const {
+    std::vector<double> curve(points.size());
+    for (size_t n = 1; n <= points.size(); ++n) curve[n - 1] = throughput(n);
+    for (size_t n = 1; n <= points.size(); ++n) {
+        // n is the knee if no larger number of workers gains enough for each added worker
+        double min_gain = saturation_gain * curve[n - 1] / (double) n;
+        bool useful = false;
+        for (size_t m = n + 1; m <= points.size() && !useful; ++m) {
+            useful = curve[m - 1] - curve[n - 1] >= min_gain * (double) (m - n);
+        }
+        if (!useful) return n;
+    }
+    return points.size();
+}
+
+size_t ScalabilityModel::workersFor(double target_throughput, size_t min_num_workers, size_t max_num_workers) const {
+    auto knee_num_workers = std::clamp(knee(), min_num_workers, max_num_workers);
+    for (size_t n = min_num_workers; n <= knee_num_workers; ++n) {
+        if (throughput(n) >= target_throughput) return n;
+    }
+    return knee_num_workers;
+}
+
+bool ScalabilityModel::isReady() const {
+    return std::count_if(points.begin(), points.end(), [](const point &p) { return p.samples > 0; }) >= 2;
+}
+
+#endif //AUTONOMICFARM_SCALABILITYMODEL_HPP
@@ -0,0 +1,180 @@
+#ifndef AUTONOMICFARM_SPILLQUEUE_HPP
+#define AUTONOMICFARM_SPILLQUEUE_HPP
+
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/**
+ * How a queue spilled its items to disk.
+ */
+struct spill_stats {
+    size_t items_written = 0; // items spilled
+    size_t bytes_written = 0; // bytes spilled
+    size_t bytes_read = 0; // bytes read back
+    // time spent copying the items into the mapped segments, and out of them: the kernel writes the pages back to disk
+    // and reads them in on its own, so a page fault on reading is the only disk time counted
+    long copy_in_ns = 0;
+    long copy_out_ns = 0;
+    size_t segments = 0; // segment files created
+    size_t max_backlog = 0; // most items on disk at once
+
+    /**
+     * @return the throughput of the copies into the segments, in megabytes per second of copying
+     */
+    double copy_in_mb_per_s() const {
+        return copy_in_ns > 0 ? (double) bytes_written / 1e6 / ((double) copy_in_ns / 1e9):0;
+    }
+
+    /**
+     * @return the throughput of the copies out of the segments, in megabytes per second of copying
+     */
+    double copy_out_mb_per_s() const {
+        return copy_out_ns > 0 ? (double) bytes_read / 1e6 / ((double) copy_out_ns / 1e9):0;
+    }
+};
+
+/**
+ * A FIFO queue on disk, made of append-only segment files mapped in memory. The items are appended to the newest
+ * segment and read back from the oldest one, which is deleted once read. The files are unlinked as soon as they are
+ * created, so they disappear with the process, and the pages of the segments that are neither written nor read are
+ * released, so the memory used stays bounded by two segments whatever the number of items on disk.
+ * @tparam T the type of the items, copied byte by byte: trivially copyable and default constructible
+ */
+template<typename T>
+class SpillQueue {
+public:
+    /**
+     * @param directory the directory of the segment files
+     * @param segment_bytes the size of a segment file, rounded down to whole items
+     */
+    SpillQueue(const std::string &directory, size_t segment_bytes)
+    : directory(directory), segment_capacity(std::max<size_t>(1, segment_bytes / sizeof(T))) {}
+
+    SpillQueue(const SpillQueue&) = delete;
+    SpillQueue& operator=(const SpillQueue&) = delete;
+
+    ~SpillQueue();
+
+    /**
+     * Append an item to the queue.
+     * @param value the item
+     * @throws std::runtime_error if a new segment file cannot be created
+     */
+    void push(const T &value);
+
+    /**
+     * Take the oldest item of the queue.
+     * @param value set to the item, if any
+     * @return false if the queue is empty
+     */
+    bool pop(T &value);
+
+    size_t size() const {
+        return items;
+    }
+
+    bool empty() const {
+        return items == 0;
+    }
+
+    const spill_stats& stats() const {
+        return statistics;
+    }
+
+private:
+    struct segment {
+        T* records;
+        // items appended and items read
+        size_t written = 0;
+        size_t read = 0;
+    };
+
+    std::string directory;
+    size_t segment_capacity;
+    // the oldest segment is read, the newest one is written
+    std::deque<segment> segments;
+    size_t items = 0;
+    spill_stats statistics;
+
+    /**
+     * Create and map a new segment file, which is unlinked right away.
+     */
+    void addSegment();
+
+    void removeSegment(segment &removed) {
+        munmap(removed.records, segment_capacity * sizeof(T));
+    }
+};
+
+template<typename T>
+SpillQueue<T>::~SpillQueue() {
+    for (auto &mapped: segments) removeSegment(mapped);
+}
+
+template<typename T>
+void SpillQueue<T>::addSegment() {
+    if (segments.size() > 1) {
+        // the full segment is not read until the older ones are: its pages can go to disk meanwhile
+        madvise(segments.back().records, segment_capacity * sizeof(T), MADV_DONTNEED);
+    }
+    std::string path = directory + "/spill-" + std::to_string(getpid()) + "-" + std::to_string(statistics.segments) + ".seg";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) throw std::runtime_error("cannot create the spill segment " + path + ": " + std::strerror(errno));
+    // the mapping keeps the file alive
+    unlink(path.c_str());
+    size_t bytes = segment_capacity * sizeof(T);
+    void* address = MAP_FAILED;
+    if (ftruncate(fd, (off_t) bytes) == 0) {
+        address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    int error = errno;
+    close(fd);
+    if (address == MAP_FAILED) throw std::runtime_error("cannot map the spill segment " + path + ": " + std::strerror(error));
+    madvise(address, bytes, MADV_SEQUENTIAL);
+    segments.push_back({ static_cast<T*>(address) });
+    statistics.segments++;
+}
+
+template<typename T>
+void SpillQueue<T>::push(const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable items can be spilled to disk");
+    auto start = std::chrono::steady_clock::now();
+    if (segments.empty() || segments.back().written == segment_capacity) addSegment();
+    auto &tail = segments.back();
+    std::memcpy(tail.records + tail.written, &value, sizeof(T));
+    tail.written++;
+    items++;
+    statistics.items_written++;
+    statistics.bytes_written += sizeof(T);
+    statistics.max_backlog = std::max(statistics.max_backlog, items);
+    statistics.copy_in_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename T>
+bool SpillQueue<T>::pop(T &value) {
+    if (items == 0) return false;
+    auto start = std::chrono::steady_clock::now();
+    auto &head = segments.front();
+    std::memcpy(&value, head.records + head.read, sizeof(T));
+    head.read++;
+    items--;
+    // a segment read to the end is deleted, unless it is still being written
+    if (head.read == segment_capacity) {
+        removeSegment(head);
+        segments.pop_front();
+    }
+    statistics.bytes_read += sizeof(T);
+    statistics.copy_out_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+#endif //AUTONOMICFARM_SPILLQUEUE_HPP
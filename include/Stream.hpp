@@ -3,12 +3,29 @@
 
 
 #include <condition_variable>
+#include <chrono>
 #include <queue>
 #include <optional>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "SpillQueue.hpp"
+#include "QueuePolicy.hpp"
 
 template<typename InputType>
 class Stream {
 public:
+    // function called with every element dropped by the admission control, along with its tag
+    using ShedFunType = typename QueuePolicy<InputType>::ShedFunType;
+    // function giving the tenant of an element
+    using TenantFunType = typename QueuePolicy<InputType>::TenantFunType;
+
     /**
      * Construct an empty stream
      */
@@ -23,6 +40,25 @@ public:
      */
     bool add(InputType& value);
 
+    /**
+     * Add the given value to the stream along with a tag, given back when the value is popped. The tags must be
+     * enabled, otherwise the tag is dropped.
+     * @param value the value to add to the stream. It is moved and not copied
+     * @param tag the tag of the value
+     * @return true if the add was allowed, false otherwise
+     */
+    bool add(InputType& value, uint32_t tag);
+
+    /**
+     * Add the given value to the stream along with a tag and a priority. The priorities must be enabled, otherwise
+     * the value is added in FIFO order.
+     * @param value the value to add to the stream. It is moved and not copied
+     * @param tag the tag of the value
+     * @param priority the priority of the value
+     * @return true if the add was allowed, false otherwise
+     */
+    bool add(InputType& value, uint32_t tag, const task_priority &priority);
+
     /**
      * Adds many values to the stream. The values are accessed from begin to end, by following the given iterators. It
      * is equivalent to call add(value) method many times but this is more efficient since the lock is acquired once.
@@ -47,24 +83,433 @@ public:
      */
     std::optional<InputType> next();
 
-    std::optional<InputType> next(bool* is_eos);
+    /**
+     * Pop the next element from the stream without waiting for it.
+     * @param is_eos set to true if the stream is empty and reached the end-of-stream
+     * @param tag set to the tag of the element, zero if it has none, if the tags are enabled
+     * @param priority_class set to the class of the element, if the priorities are enabled
+     * @param tenant set to the tenant of the element, if the tenants are enabled
+     * @return an optional containing the next element, or an empty optional if the stream is empty
+     */
+    std::optional<InputType> next(bool* is_eos, uint32_t* tag = nullptr, uint32_t* priority_class = nullptr,
+                                  uint32_t* tenant = nullptr);
+
+    /**
+     * Pop the next element from the stream as next() does, also giving when it was added.
+     * @param added set to the point in time when the element was added, if the timestamps are enabled
+     * @param tag set to the tag of the element, zero if it has none, if the tags are enabled
+     * @param priority_class set to the class of the element, if the priorities are enabled
+     * @param tenant set to the tenant of the element, if the tenants are enabled
+     * @return and optional containing the next element, if available, and empty optional if the stream reached the
+     * end-of-stream
+     */
+    std::optional<InputType> next(std::chrono::steady_clock::time_point* added, uint32_t* tag = nullptr,
+                                  uint32_t* priority_class = nullptr, uint32_t* tenant = nullptr);
+
+    /**
+     * Record the point in time when each element is added, to know how long it waited. It must be called before adding
+     * any element.
+     */
+    void enableTimestamps() {
+        timestamps = true;
+    }
+
+    /**
+     * Keep the tag of each element. It must be called before adding any element.
+     */
+    void enableTags() {
+        tagged = true;
+    }
+
+    /**
+     * Pop the elements earliest virtual deadline first instead of in FIFO order, as given by their priority: the
+     * elements without a deadline are due at their arrival plus the aging period times their class. It must be called
+     * before adding any element.
+     * @param aging_ms the aging period of the classes (milliseconds)
+     */
+    void enablePriorities(double aging_ms) {
+        policy.enablePriorities(aging_ms);
+        // the virtual deadlines come from the timestamps
+        timestamps = true;
+    }
+
+    /**
+     * Make the additions wait while the queue holds the given number of elements, so that a slow consumer holds the
+     * producers instead of letting the stream grow. It must be called before adding any element.
+     * @param capacity the maximum number of elements in the queue, zero for no bound
+     */
+    void setCapacity(size_t capacity) {
+        this->capacity = capacity;
+    }
+
+    /**
+     * Keep at most the given number of elements in memory, and append the following ones to segment files on disk,
+     * read back in order as the stream is consumed. The elements must be trivially copyable and default constructible,
+     * otherwise they are always kept in memory. If the priorities are enabled, the elements of the most urgent class are
+     * always kept in memory, beyond the maximum, so that they don't wait behind the elements on disk. It must be called
+     * before adding any element.
+     * @param max_in_memory the maximum number of elements kept in memory
+     * @param directory the directory of the segment files
+     * @param segment_bytes the size of a segment file
+     */
+    void enableSpill(size_t max_in_memory, const std::string &directory, size_t segment_bytes = 64 << 20) {
+        if constexpr (std::is_trivially_copyable_v<InputType>) {
+            this->max_in_memory = std::max<size_t>(1, max_in_memory);
+            spill = std::make_unique<SpillQueue<element>>(directory, segment_bytes);
+        }
+    }
+
+    /**
+     * Let the given admission control decide which elements are added and which ones are dropped, on arrival or once
+     * expired. The dropped elements are given to a function, for example to fail their futures. It must be called
+     * before adding any element.
+     * @param admission the admission control, copied
+     * @param on_shed the function called with every element dropped, after releasing the lock of the stream
+     */
+    void enableAdmission(const AdmissionControl &admission, const ShedFunType &on_shed) {
+        policy.enableAdmission(admission, on_shed);
+        // the queue delay and the deadlines come from the timestamps
+        timestamps = true;
+    }
+
+    /**
+     * Keep the elements of each tenant in a sub-queue of its own, and pop them by weighted deficit round robin among the
+     * tenants, each element costing the time spent computing the elements of its tenant: a tenant flooding the stream
+     * only lengthens its own sub-queue. The next element is chosen when popped, so the priorities only order the
+     * elements of the same tenant, and the elements are never spilled to disk. Each element popped must be told done.
+     * It must be called before adding any element.
+     * @param tenant_of the function giving the tenant of an element, numbered from zero
+     */
+    void enableTenants(const TenantFunType &tenant_of) {
+        policy.enableTenants(tenant_of);
+    }
+
+    /**
+     * Set the share of the computing time given to a tenant, one by default. The tenants must be enabled.
+     */
+    void setTenantWeight(uint32_t tenant, double weight) {
+        std::unique_lock lock(mutex);
+        policy.setTenantWeight(tenant, weight);
+    }
+
+    /**
+     * Cap the elements of a tenant popped and not done yet: the other ones wait, even if some worker is idle. The
+     * tenants must be enabled.
+     * @param tenant the tenant
+     * @param max_in_flight the maximum number of elements in flight, zero for no cap
+     */
+    void setTenantCap(uint32_t tenant, size_t max_in_flight) {
+        std::unique_lock lock(mutex);
+        policy.setTenantCap(tenant, max_in_flight);
+    }
+
+    /**
+     * Tell that an element popped was computed, which frees its place among the ones its tenant may have in flight.
+     * @param tenant the tenant of the element
+     * @param service_ms the time spent computing the element (milliseconds), negative if unknown
+     */
+    void done(uint32_t tenant, double service_ms);
+
+    /**
+     * @return the most workers the tenants with elements waiting or in flight can use, the maximum value of size_t if
+     * the tenants are not enabled or some of them is not capped
+     */
+    size_t usefulWorkers() {
+        std::unique_lock lock(mutex);
+        return policy.usefulWorkers();
+    }
+
+    /**
+     * @return the most elements waiting and in flight at once of each tenant, if the tenants are enabled
+     */
+    std::vector<tenant_stats> tenantStats() {
+        std::unique_lock lock(mutex);
+        return policy.tenantStats();
+    }
+
+    /**
+     * @return how many elements were admitted and dropped so far
+     */
+    shed_stats shedStats() {
+        std::unique_lock lock(mutex);
+        return policy.shedStats();
+    }
+
+    /**
+     * @return the number of elements waiting on disk
+     */
+    size_t spilled() const {
+        return spilled_items.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @return how the elements were spilled to disk so far
+     */
+    spill_stats spillStats() {
+        std::unique_lock lock(mutex);
+        return spill ? spill->stats():spill_stats();
+    }
 
 private:
+    using element = queued_element<InputType>;
+
     std::mutex mutex;
     std::condition_variable cond_empty;
-    std::deque<InputType> queue;
+    std::deque<element> queue;
     bool eosFlag = false;
+    // maximum number of elements in the queue, zero for no bound, and the condition the additions wait on
+    size_t capacity = 0;
+    std::condition_variable cond_full;
+    // whether the points in time when the elements are added are recorded, and their tags kept
+    bool timestamps = false;
+    bool tagged = false;
+    // priorities, admission control and tenants
+    QueuePolicy<InputType> policy;
+    // elements beyond max_in_memory, if enabled
+    std::unique_ptr<SpillQueue<element>> spill;
+    size_t max_in_memory = 0;
+    std::atomic<size_t> spilled_items = 0;
+
+    /**
+     * Add an element to the queue, to the sub-queue of its tenant, or to the disk if the queue is full, unless the
+     * admission control drops it. It must be called holding the lock.
+     */
+    void enqueue(element &e);
+
+    /**
+     * Take the element at the front of the queue, then refill the queue. It must be called holding the lock, with a
+     * non-empty queue.
+     */
+    element popFront();
+
+    /**
+     * Take the element at the front of the queue as popFront does, giving what is known about it.
+     * @param added set to the point in time when the element was added, if not null and the timestamps are enabled
+     * @param tag set to the tag of the element, if not null and the tags are enabled
+     * @param priority_class set to the class of the element, if not null and the priorities are enabled
+     * @param tenant set to the tenant of the element, if not null and the tenants are enabled
+     * @return the element
+     */
+    InputType take(std::chrono::steady_clock::time_point* added, uint32_t* tag, uint32_t* priority_class,
+                   uint32_t* tenant);
+
+    /**
+     * Move the elements on disk into the queue, as long as it has room. It must be called holding the lock.
+     */
+    void refill();
+
+    /**
+     * Move the next element of the tenants into the queue, if the queue is empty and the tenants are enabled. It must
+     * be called holding the lock.
+     */
+    void pullTenants();
+
+    /**
+     * Wait for room in the queue, if it is bounded. It must be called holding the lock.
+     */
+    void waitRoom(std::unique_lock<std::mutex> &lock) {
+        if (capacity == 0 || queue.size() < capacity) return;
+        // the elements added so far by the caller may not be told yet
+        cond_empty.notify_all();
+        cond_full.wait(lock, [this]() { return queue.size() < capacity || eosFlag; });
+    }
+
+    /**
+     * Wake up an addition waiting for room, if the queue is bounded. It must be called after taking an element.
+     */
+    void notifyRoom() {
+        if (capacity > 0) cond_full.notify_one();
+    }
+
+    /**
+     * Wait for an element to take, dropping the expired ones once the wait ends. It must be called holding the lock,
+     * which is released to give the expired elements to on_shed if the queue has to be waited for again.
+     * @return true if there is an element to take, false if the stream reached the end-of-stream
+     */
+    bool waitFront(std::unique_lock<std::mutex> &lock);
+
+    /**
+     * Drop the element at the front of the queue, the oldest unless the priorities are enabled. It must be called
+     * holding the lock, with a non-empty queue.
+     */
+    void shedFront(shed_reason reason);
+
+    /**
+     * Drop the element at the back of the queue, the one due last if the priorities are enabled. It must be called
+     * holding the lock, with a non-empty queue.
+     */
+    void shedBack(shed_reason reason);
+
+    /**
+     * Drop the oldest element of the queue, or of the tenant with the most elements waiting if the tenants are enabled,
+     * or the one due last if the priorities are enabled: the front is then the most urgent element, which the
+     * priorities protect. It must be called holding the lock.
+     */
+    void shedOldest();
+
+    /**
+     * Drop the expired elements at the front of the queue, then measure the queue delay from the element about to be
+     * taken, if the admission control is enabled. It must be called holding the lock.
+     */
+    void admitFront();
 };
 
+template<typename InputType>
+void Stream<InputType>::shedFront(shed_reason reason) {
+    auto e = popFront();
+    policy.release(e.tenant);
+    policy.shed(e, reason);
+}
+
+template<typename InputType>
+void Stream<InputType>::shedBack(shed_reason reason) {
+    auto e = std::move(queue.back());
+    queue.pop_back();
+    policy.release(e.tenant);
+    policy.shed(e, reason);
+}
+
+template<typename InputType>
+void Stream<InputType>::shedOldest() {
+    std::optional<element> oldest;
+    if ((oldest = policy.popLongest())) {
+        policy.shed(*oldest, shed_reason::oldest);
+    } else if (!queue.empty()) {
+        if (policy.prioritized()) shedBack(shed_reason::oldest);
+        else shedFront(shed_reason::oldest);
+    }
+}
+
+template<typename InputType>
+void Stream<InputType>::admitFront() {
+    pullTenants();
+    if (!policy.admitting() || queue.empty()) return;
+    auto now = std::chrono::steady_clock::now();
+    while (!queue.empty() && policy.expired(queue.front(), now)) {
+        shedFront(shed_reason::expired);
+        pullTenants();
+    }
+    if (!queue.empty()) policy.onDeparture(queue.front(), now);
+}
+
+template<typename InputType>
+bool Stream<InputType>::waitFront(std::unique_lock<std::mutex> &lock) {
+    while (true) {
+        cond_empty.wait(lock, [&]{ pullTenants(); return !queue.empty() || (eosFlag && policy.drained()); });
+        // the expired elements may empty the queue again
+        admitFront();
+        if (!queue.empty()) return true;
+        if (eosFlag && policy.drained()) return false;
+        if (!policy.shedding()) continue;
+        // the expired elements are told before waiting again, which may be long
+        auto shed_elements = policy.takeDropped();
+        lock.unlock();
+        policy.notifyShed(shed_elements);
+        lock.lock();
+    }
+}
+
+template<typename InputType>
+void Stream<InputType>::pullTenants() {
+    if (!queue.empty()) return;
+    auto e = policy.pop();
+    if (e) queue.push_back(std::move(*e));
+}
+
+template<typename InputType>
+void Stream<InputType>::done(uint32_t tenant, double service_ms) {
+    bool eos;
+    {
+        std::unique_lock lock(mutex);
+        if (!policy.fair()) return;
+        policy.done(tenant, service_ms);
+        eos = eosFlag;
+    }
+    // a capped tenant may go on; after the end of the stream, every waiting worker must see whether the tenants drained
+    if (eos) cond_empty.notify_all();
+    else cond_empty.notify_one();
+}
+
+template<typename InputType>
+void Stream<InputType>::enqueue(element &e) {
+    auto reason = policy.onArrival(queue.size() + spilled() + policy.waiting(), e.added);
+    if (reason == shed_reason::oldest) {
+        shedOldest();
+    } else if (reason) {
+        policy.shed(e, *reason);
+        return;
+    }
+    if (policy.fair()) {
+        policy.push(e);
+        return;
+    }
+    if constexpr (std::is_trivially_copyable_v<InputType>) {
+        // once an element is on disk the following ones go there too, to keep the order, but the most urgent ones
+        bool urgent = policy.prioritized() && e.priority_class == 0;
+        if (spill && !urgent && (!spill->empty() || queue.size() >= max_in_memory)) {
+            spill->push(e);
+            spilled_items.store(spill->size(), std::memory_order_relaxed);
+            return;
+        }
+    }
+    policy.insert(queue, e);
+}
+
+template<typename InputType>
+typename Stream<InputType>::element Stream<InputType>::popFront() {
+    auto e = std::move(queue.front());
+    queue.pop_front();
+    refill();
+    return e;
+}
+
+template<typename InputType>
+InputType Stream<InputType>::take(std::chrono::steady_clock::time_point* added, uint32_t* tag, uint32_t* priority_class,
+                                  uint32_t* tenant) {
+    auto e = popFront();
+    if (added != nullptr && timestamps) *added = e.added;
+    if (tag != nullptr && tagged) *tag = e.tag;
+    if (priority_class != nullptr && policy.prioritized()) *priority_class = e.priority_class;
+    if (tenant != nullptr && policy.fair()) *tenant = e.tenant;
+    return std::move(e.value);
+}
+
+template<typename InputType>
+void Stream<InputType>::refill() {
+    if constexpr (std::is_trivially_copyable_v<InputType>) {
+        if (!spill) return;
+        element e;
+        while (queue.size() < max_in_memory && spill->pop(e)) policy.insert(queue, e);
+        spilled_items.store(spill->size(), std::memory_order_relaxed);
+    }
+}
+
 template<typename InputType>
 bool Stream<InputType>::add(InputType& value) {
+    return add(value, 0);
+}
+
+template<typename InputType>
+bool Stream<InputType>::add(InputType& value, uint32_t tag) {
+    return add(value, tag, task_priority());
+}
+
+template<typename InputType>
+bool Stream<InputType>::add(InputType& value, uint32_t tag, const task_priority &priority) {
+    std::vector<std::pair<InputType, uint32_t>> shed_elements;
     {
         std::unique_lock lock(mutex);
+        waitRoom(lock);
         if (eosFlag) return false; // avoid adding new values after end of stream
         // zero-copy communication
-        queue.push_back(std::move(value));
+        element e{ std::move(value), timestamps ? std::chrono::steady_clock::now():std::chrono::steady_clock::time_point(),
+                   tagged ? tag:0 };
+        policy.stamp(e, priority);
+        enqueue(e);
+        shed_elements = policy.takeDropped();
     }
     cond_empty.notify_one();
+    policy.notifyShed(shed_elements);
 
     return true;
 }
@@ -72,18 +517,30 @@ bool Stream<InputType>::add(InputType& value) {
 template<typename InputType>
 template<typename Iterator>
 bool Stream<InputType>::add_all(Iterator begin, Iterator end) {
+    std::vector<std::pair<InputType, uint32_t>> shed_elements;
+    bool added_all = true;
     {
         std::unique_lock lock(mutex);
         if (eosFlag) return false; // avoid adding new values after end of stream
 
+        auto now = std::chrono::steady_clock::now();
         while (begin != end) {
-            queue.push_back(*begin);
+            waitRoom(lock);
+            if (eosFlag) {
+                added_all = false;
+                break;
+            }
+            element e{ *begin, now };
+            policy.stamp(e, task_priority());
+            enqueue(e);
             begin++;
         }
+        shed_elements = policy.takeDropped();
     }
     cond_empty.notify_one();
+    policy.notifyShed(shed_elements);
 
-    return true;
+    return added_all;
 }
 
 template<typename InputType>
@@ -93,33 +550,44 @@ void Stream<InputType>::eos() {
         eosFlag = true;
     }
     cond_empty.notify_all();
+    cond_full.notify_all();
 }
 
 template<typename InputType>
 std::optional<InputType> Stream<InputType>::next() {
-    std::unique_lock<std::mutex> lock(mutex);
-    cond_empty.wait(lock, [&]{ return eosFlag || !queue.empty(); });
-    if (eosFlag && queue.empty()) return {};
-
-    auto next_elem = std::optional<InputType>{std::move(queue.front())};
-    queue.pop_front();
-
-    return next_elem;
+    return next((std::chrono::steady_clock::time_point*) nullptr);
 }
 
 template<typename InputType>
-std::optional<InputType> Stream<InputType>::next(bool* is_eos) {
-    std::unique_lock<std::mutex> lock(mutex);
-
-    if (queue.empty()) {
-        *is_eos = eosFlag;
-        return {};
+std::optional<InputType> Stream<InputType>::next(std::chrono::steady_clock::time_point* added, uint32_t* tag,
+                                                 uint32_t* priority_class, uint32_t* tenant) {
+    std::optional<InputType> value;
+    std::vector<std::pair<InputType, uint32_t>> shed_elements;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (waitFront(lock)) value = take(added, tag, priority_class, tenant);
+        shed_elements = policy.takeDropped();
     }
-    *is_eos = false;
-    auto next_elem = std::optional<InputType>{std::move(queue.front())};
-    queue.pop_front();
+    if (value) notifyRoom();
+    policy.notifyShed(shed_elements);
+    return value;
+}
 
-    return next_elem;
+template<typename InputType>
+std::optional<InputType> Stream<InputType>::next(bool* is_eos, uint32_t* tag, uint32_t* priority_class,
+                                                 uint32_t* tenant) {
+    std::optional<InputType> value;
+    std::vector<std::pair<InputType, uint32_t>> shed_elements;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        admitFront();
+        *is_eos = queue.empty() && eosFlag && policy.drained();
+        if (!queue.empty()) value = take(nullptr, tag, priority_class, tenant);
+        shed_elements = policy.takeDropped();
+    }
+    if (value) notifyRoom();
+    policy.notifyShed(shed_elements);
+    return value;
 }
 
 #endif //STREAMQUEUE_H
@@ -0,0 +1,162 @@
+#ifndef AUTONOMICFARM_TASKPRIORITY_HPP
+#define AUTONOMICFARM_TASKPRIORITY_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * The priority of a task: its class and, optionally, its deadline.
+ *
+ * The tasks are dispatched earliest virtual deadline first. A task with a deadline is due at its arrival plus its
+ * deadline. A task without one is due at its arrival plus the aging period times its class, so that a task of class k
+ * goes after the tasks of the more urgent classes arrived up to k aging periods later, and never waits behind them more
+ * than that: the less urgent classes age instead of starving.
+ */
+struct task_priority {
+    // zero is the most urgent class
+    uint32_t priority_class = 0;
+    // time from the arrival within which the task should be dispatched (milliseconds), zero for none
+    double deadline_ms = 0;
+
+    /**
+     * @param added the point in time when the task arrived
+     * @param aging the aging period of the classes
+     * @return the point in time by which the task should be dispatched
+     */
+    std::chrono::steady_clock::time_point dispatchBy(std::chrono::steady_clock::time_point added,
+                                                     std::chrono::steady_clock::duration aging) const {
+        if (deadline_ms > 0) {
+            return added + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(deadline_ms));
+        }
+        return added + aging * priority_class;
+    }
+};
+
+/**
+ * The latencies of the tasks of a priority class, from their arrival to the end of their computation. The latencies are
+ * counted into a fixed set of buckets, so that the memory taken doesn't grow with the tasks: each power of two of
+ * microseconds is split into 32 buckets, hence a percentile is off by less than 1/32 of its value. The mean and the
+ * maximum are exact.
+ */
+struct class_latency {
+    /**
+     * Add the latency of a task.
+     * @param latency_ms the latency (milliseconds)
+     */
+    void add(double latency_ms);
+
+    /**
+     * Add the latencies of another set of tasks of the same class.
+     */
+    void merge(const class_latency &other);
+
+    /**
+     * @return the number of tasks whose latency was added
+     */
+    [[nodiscard]] size_t tasks() const {
+        return count;
+    }
+
+    [[nodiscard]] double mean() const {
+        return count == 0 ? 0:sum_ms / (double) count;
+    }
+
+    /**
+     * @param p the percentile, between 0 and 100
+     * @return the latency below which p percent of the tasks completed (milliseconds), zero without tasks
+     */
+    [[nodiscard]] double percentile(double p) const;
+
+    /**
+     * Record a latency into the latencies of a class, adding the classes up to it if missing.
+     * @param classes the latencies of each class
+     * @param priority_class the class of the task
+     * @param latency_ms the latency of the task
+     */
+    static void record(std::vector<class_latency> &classes, uint32_t priority_class, double latency_ms) {
+        if (classes.size() <= priority_class) classes.resize(priority_class + 1);
+        classes[priority_class].add(latency_ms);
+    }
+
+    /**
+     * Add the latencies of each class of a worker to the ones of the farm.
+     * @param classes the latencies of each class of the farm
+     * @param others the latencies of each class of the worker
+     */
+    static void merge(std::vector<class_latency> &classes, const std::vector<class_latency> &others) {
+        if (classes.size() < others.size()) classes.resize(others.size());
+        for (size_t i = 0; i < others.size(); ++i) classes[i].merge(others[i]);
+    }
+
+private:
+    // buckets of each power of two. The latencies below them have a bucket for each microsecond
+    static constexpr int sub_bucket_bits = 5;
+    static constexpr uint64_t sub_buckets = 1 << sub_bucket_bits;
+    // latencies up to 2^41 microseconds, about 25 days, longer ones are counted in the last bucket
+    static constexpr int max_power = 40;
+    static constexpr size_t num_buckets = (max_power - sub_bucket_bits + 2) * sub_buckets;
+
+    size_t count = 0;
+    double sum_ms = 0;
+    double max_ms = 0;
+    // allocated with the first latency, so that the classes without tasks take no memory
+    std::vector<uint64_t> buckets;
+
+    static size_t bucketOf(uint64_t latency_us);
+
+    /**
+     * @return the highest latency counted in a bucket (microseconds)
+     */
+    static uint64_t bucketUpperBound(size_t bucket);
+};
+
+size_t class_latency::bucketOf(uint64_t latency_us) {
+    if (latency_us < sub_buckets) return latency_us;
+    int power = std::min(63 - __builtin_clzll(latency_us), max_power);
+    // the bits below the highest one tell the bucket within the power of two
+    uint64_t sub_bucket = power == max_power && latency_us >> max_power > 1
+            ? sub_buckets - 1:(latency_us >> (power - sub_bucket_bits)) & (sub_buckets - 1);
+    return (size_t) (power - sub_bucket_bits + 1) * sub_buckets + sub_bucket;
+}
+
+uint64_t class_latency::bucketUpperBound(size_t bucket) {
+    if (bucket < sub_buckets) return bucket;
+    int power = (int) (bucket / sub_buckets) + sub_bucket_bits - 1;
+    uint64_t sub_bucket = bucket % sub_buckets;
+    return ((sub_buckets + sub_bucket + 1) << (power - sub_bucket_bits)) - 1;
+}
+
+void class_latency::add(double latency_ms) {
+    if (buckets.empty()) buckets.assign(num_buckets, 0);
+    buckets[bucketOf((uint64_t) std::llround(std::max(0.0, latency_ms) * 1000))]++;
+    count++;
+    sum_ms += latency_ms;
+    max_ms = std::max(max_ms, latency_ms);
+}
+
+void class_latency::merge(const class_latency &other) {
+    if (other.count == 0) return;
+    if (buckets.empty()) buckets.assign(num_buckets, 0);
+    for (size_t i = 0; i < num_buckets; ++i) buckets[i] += other.buckets[i];
+    count += other.count;
+    sum_ms += other.sum_ms;
+    max_ms = std::max(max_ms, other.max_ms);
+}
+
+double class_latency::percentile(double p) const {
+    if (count == 0) return 0;
+    auto rank = std::clamp<uint64_t>((uint64_t) std::ceil(p / 100 * (double) count), 1, count);
+    uint64_t below = 0;
+    for (size_t i = 0; i < num_buckets; ++i) {
+        below += buckets[i];
+        if (below < rank) continue;
+        // the highest latency of the bucket, but never above the highest latency seen. The last bucket has no bound
+        return i + 1 == num_buckets ? max_ms:std::min((double) bucketUpperBound(i) / 1000, max_ms);
+    }
+    return max_ms;
+}
+
+#endif //AUTONOMICFARM_TASKPRIORITY_HPP
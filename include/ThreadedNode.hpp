@@ -2,8 +2,14 @@
 #define THREADEDNODE_H
 
 #include <thread>
+#include <atomic>
+#include <memory>
 #include "Node.hpp"
 #include "Stream.hpp"
+#include "WorkerStats.hpp"
+#include "WorkerSpeeds.hpp"
+#include "PerfCounters.hpp"
+#include "EventTracer.hpp"
 
 /**
  * An implementation of the Node class that processes input items from an independent thread.
@@ -35,6 +41,8 @@ public:
      */
     void send(InputType& value) override;
 
+    void sendTagged(InputType& value, uint32_t tag) override;
+
     /**
      * Send many items to the node.
      * @tparam Iterator the iterator to iterate through the items to send
@@ -49,22 +57,163 @@ public:
      */
     void notify_eos() override;
 
+    /**
+     * @return the number of items completely processed by this node
+     */
+    size_t processed() const {
+        return processed_items;
+    }
+
+    /**
+     * The number of items sent and not processed yet, including the one being processed. It must be called by the
+     * thread that sends the items.
+     * @return the length of the queue of this node
+     */
+    size_t pending() const {
+        return sent_items.load(std::memory_order_relaxed) - processed_items;
+    }
+
+    /**
+     * Collect the statistics of this node: tasks, busy, idle and queue wait time. It must be called before running.
+     */
+    void enableStats() {
+        collect_stats = true;
+        inputStream.enableTimestamps();
+    }
+
+    /**
+     * @return the statistics of this node, complete once the node finished
+     */
+    const worker_stats& getStats() const {
+        return stats;
+    }
+
+    /**
+     * Report the service time of every item to the given estimates. It must be called before running.
+     * @param speeds the estimates of the service time of the workers
+     * @param index the index of this node in the estimates
+     */
+    void trackSpeed(WorkerSpeeds* speeds, size_t index) {
+        this->speeds = speeds;
+        speed_index = index;
+    }
+
+    /**
+     * Count the items processed by this node on a counter shared with other nodes, waking up a thread waiting on it
+     * after each one. It must be called before running.
+     * @param completions the counter of the items processed
+     */
+    void notifyCompletions(std::atomic<uint64_t>* completions) {
+        this->completions = completions;
+    }
+
+    /**
+     * Count the hardware events of the tasks, summed per window of time. It must be called before running.
+     * @param window_ms the length of the windows (milliseconds)
+     */
+    void enablePerfCounters(long window_ms) {
+        perf = std::make_unique<PerfCounters>(window_ms);
+    }
+
+    /**
+     * @return the counters of this node, complete once the node finished, or nullptr if not enabled
+     */
+    const PerfCounters* getPerfCounters() const {
+        return perf.get();
+    }
+
+    /**
+     * Set the name of this node's thread, shown by the event tracer. It must be called before running.
+     * @param name the name of the thread
+     */
+    void setName(const std::string &name) {
+        this->name = name;
+    }
+
+    /**
+     * Make the items sent wait while the given number of items wait for this node. It must be called before sending
+     * any item.
+     * @param capacity the maximum number of items waiting, zero for no bound
+     */
+    void setCapacity(size_t capacity) {
+        inputStream.setCapacity(capacity);
+    }
+
+    /**
+     * Keep the tags of the items sent. It must be called before sending any item.
+     */
+    void enableTags() {
+        inputStream.enableTags();
+    }
+
+    /**
+     * @return the tag of the item being computed by the calling thread, zero if it has none
+     */
+    static uint32_t currentTag() {
+        return current_tag;
+    }
+
 protected:
     // thread function
     virtual void node_fun();
     // function executed by the given thread to process an input item
     virtual void onValue(InputType& value);
+    /**
+     * Process an item taken from a stream, updating the statistics if enabled.
+     * @param value the item to process
+     * @param taken the point in time when the item was taken from the stream, after waiting for it since idle_from
+     * @param added the point in time when the item was added to the stream
+     * @param idle_from the point in time when the node began waiting for the item
+     * @return the point in time when the item was processed
+     */
+    std::chrono::steady_clock::time_point process(InputType& value, std::chrono::steady_clock::time_point taken,
+        std::chrono::steady_clock::time_point added, std::chrono::steady_clock::time_point idle_from);
+    /**
+     * @return true if the items are timed, for the statistics or the speed estimates
+     */
+    bool timed() const {
+        return collect_stats || speeds != nullptr || perf;
+    }
+    /**
+     * Count the items just processed, waking up the thread waiting for a completion if any.
+     * @param items the number of items processed
+     */
+    void completed(size_t items) {
+        processed_items += items;
+        if (completions == nullptr) return;
+        completions->fetch_add(items, std::memory_order_release);
+        completions->notify_one();
+    }
 
     std::thread thread;
     // store input items into an input stream
     Stream<InputType> inputStream;
     // function executed by the given thread to process an input item
     OnValueFun onValueFun;
+    // number of items for which onValue returned
+    std::atomic<size_t> processed_items = 0;
+    // number of items sent, by the threads sending to this node: every worker sends to the gatherer
+    std::atomic<size_t> sent_items = 0;
+    // counter of the items processed by a group of nodes, if any
+    std::atomic<uint64_t>* completions = nullptr;
+    bool collect_stats = false;
+    // only written by the thread of this node
+    worker_stats stats;
+    // estimates of the service time updated by this node, if any
+    WorkerSpeeds* speeds = nullptr;
+    size_t speed_index = 0;
+    // hardware counters of this node's thread, if enabled
+    std::unique_ptr<PerfCounters> perf;
+    // name of this node's thread in the traced events
+    std::string name = "node";
+    // tag of the item being computed by this thread
+    inline static thread_local uint32_t current_tag = 0;
 };
 
 template<typename InputType>
 template<typename Iterator>
 void ThreadedNode<InputType>::send(Iterator begin, Iterator end) {
+    sent_items.fetch_add(std::distance(begin, end), std::memory_order_relaxed);
     inputStream.add_all(begin, end);
 }
 
@@ -80,9 +229,16 @@ void ThreadedNode<InputType>::run() {
 
 template<typename InputType>
 void ThreadedNode<InputType>::send(InputType& value) {
+    sent_items.fetch_add(1, std::memory_order_relaxed);
     inputStream.add(value);
 }
 
+template<typename InputType>
+void ThreadedNode<InputType>::sendTagged(InputType& value, uint32_t tag) {
+    sent_items.fetch_add(1, std::memory_order_relaxed);
+    inputStream.add(value, tag);
+}
+
 template<typename InputType>
 void ThreadedNode<InputType>::notify_eos() {
     inputStream.eos();
@@ -90,14 +246,52 @@ void ThreadedNode<InputType>::notify_eos() {
 
 template<typename InputType>
 void ThreadedNode<InputType>::node_fun() {
+    std::chrono::steady_clock::time_point idle_from, added;
+    if (collect_stats) idle_from = std::chrono::steady_clock::now();
+    if (perf) perf->open();
+    EventTracer::nameThread(name);
     do {
-        auto next_opt = inputStream.next();
+        auto next_opt = inputStream.next(&added, &current_tag);
         if (next_opt.has_value()) {
-            onValue(next_opt.value());
+            EventTracer::record(trace_event::dequeue);
+            auto taken = timed() ? std::chrono::steady_clock::now():idle_from;
+            idle_from = process(next_opt.value(), taken, added, idle_from);
         } else {
+            EventTracer::record(trace_event::eos);
             break;
         }
     } while (true);
+    // waiting for the end-of-stream
+    if (collect_stats) worker_stats::lap(stats.idle_ns, idle_from);
+}
+
+template<typename InputType>
+std::chrono::steady_clock::time_point ThreadedNode<InputType>::process(InputType &value,
+    std::chrono::steady_clock::time_point taken, std::chrono::steady_clock::time_point added,
+    std::chrono::steady_clock::time_point idle_from) {
+    EventTracer::record(trace_event::task_start, (int32_t) processed_items.load(std::memory_order_relaxed));
+    if (!timed()) {
+        onValue(value);
+        EventTracer::record(trace_event::task_end);
+        completed(1);
+        return taken;
+    }
+    if (collect_stats) {
+        stats.idle_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(taken - idle_from).count();
+        stats.queue_wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(taken - added).count();
+    }
+    if (perf) perf->begin();
+    onValue(value);
+    if (perf) perf->end();
+    EventTracer::record(trace_event::task_end);
+    completed(1);
+    auto done = std::chrono::steady_clock::now();
+    if (collect_stats) {
+        stats.tasks++;
+        stats.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(done - taken).count();
+    }
+    if (speeds != nullptr) speeds->observe(speed_index, std::chrono::duration<double, std::milli>(done - taken).count());
+    return done;
 }
 
 template<typename InputType>
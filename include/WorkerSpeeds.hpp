@@ -0,0 +1,118 @@
+#ifndef AUTONOMICFARM_WORKERSPEEDS_HPP
+#define AUTONOMICFARM_WORKERSPEEDS_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+/**
+ * Estimates of the service time of each worker, for farms whose workers run at different speeds (hybrid cores, SMT
+ * siblings). Each worker updates an exponential moving average in its own slot, aligned to a cache line, while the
+ * controller and the dispatcher read them.
+ *
+ * The workers are also kept in an order, where the first positions are the running ones and the others are paused.
+ * Reordering puts the fastest workers first within both groups, so that the slowest running workers are paused first
+ * and the fastest paused workers are unpaused first.
+ */
+class WorkerSpeeds {
+public:
+    /**
+     * @param num_workers the number of workers
+     * @param smoothing weight of the newest observation on the service time of a worker
+     */
+    explicit WorkerSpeeds(size_t num_workers = 0, double smoothing = 0.2);
+
+    /**
+     * Add an observation of the service time of a worker. It must be called only by the thread of the worker.
+     * @param worker the index of the worker
+     * @param service_time the service time of the last task (milliseconds)
+     */
+    void observe(size_t worker, double service_time);
+
+    /**
+     * @param worker the index of the worker
+     * @return the estimated service time of the worker (milliseconds), negative if it wasn't observed yet
+     */
+    [[nodiscard]] double serviceTime(size_t worker) const {
+        return slots[worker].service_time.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * The service time of a single worker equivalent to the first running workers: their number over the sum of their
+     * speeds, so that dividing it by the number of workers gives the service time of the farm.
+     * @param num_running the number of running workers
+     * @return the equivalent service time (milliseconds), negative if no running worker was observed yet
+     */
+    [[nodiscard]] double combinedServiceTime(size_t num_running) const;
+
+    /**
+     * Sort the running workers and the paused ones from the fastest to the slowest. Never observed workers come first,
+     * so that they get observed.
+     * @param num_running the number of running workers, which are the first ones of the order
+     */
+    void reorder(size_t num_running);
+
+    /**
+     * @param position a position in the order of the workers
+     * @return the index of the worker at the given position
+     */
+    [[nodiscard]] size_t at(size_t position) const {
+        return order[position];
+    }
+
+    [[nodiscard]] size_t size() const {
+        return order.size();
+    }
+
+private:
+    struct alignas(64) slot {
+        std::atomic<double> service_time = -1;
+    };
+
+    std::unique_ptr<slot[]> slots;
+    std::vector<size_t> order; // index of the worker at each position
+    double smoothing;
+};
+
+WorkerSpeeds::WorkerSpeeds(size_t num_workers, double smoothing)
+: slots(new slot[num_workers]), order(num_workers), smoothing(smoothing) {
+    std::iota(order.begin(), order.end(), 0);
+}
+
+void WorkerSpeeds::observe(size_t worker, double service_time) {
+    auto &estimate = slots[worker].service_time;
+    double previous = estimate.load(std::memory_order_relaxed);
+    estimate.store(previous < 0 ? service_time:smoothing * service_time + (1 - smoothing) * previous,
+                   std::memory_order_relaxed);
+}
+
+double WorkerSpeeds::combinedServiceTime(size_t num_running) const {
+    double speed_sum = 0.0;
+    size_t observed = 0;
+    for (size_t position = 0; position < std::min(num_running, order.size()); ++position) {
+        double service_time = serviceTime(order[position]);
+        if (service_time <= 0) continue;
+        speed_sum += 1.0 / service_time;
+        observed++;
+    }
+    // the workers not observed yet are assumed as fast as the mean of the observed ones
+    return observed == 0 ? -1:(double) observed / speed_sum;
+}
+
+void WorkerSpeeds::reorder(size_t num_running) {
+    num_running = std::min(num_running, order.size());
+    // the workers keep updating their estimates, so the order is computed on a snapshot of them
+    std::vector<double> snapshot(order.size());
+    for (size_t worker = 0; worker < order.size(); ++worker) snapshot[worker] = serviceTime(worker);
+    auto faster = [&snapshot](size_t a, size_t b) {
+        double service_time_a = snapshot[a], service_time_b = snapshot[b];
+        if (service_time_a <= 0 || service_time_b <= 0) return service_time_a <= 0 && service_time_b > 0;
+        return service_time_a < service_time_b;
+    };
+    std::stable_sort(order.begin(), order.begin() + (long) num_running, faster);
+    std::stable_sort(order.begin() + (long) num_running, order.end(), faster);
+}
+
+#endif //AUTONOMICFARM_WORKERSPEEDS_HPP
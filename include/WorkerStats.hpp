@@ -0,0 +1,42 @@
+#ifndef AUTONOMICFARM_WORKERSTATS_HPP
+#define AUTONOMICFARM_WORKERSTATS_HPP
+
+#include <chrono>
+
+/**
+ * Counters of a single worker. Each worker only writes its own slot, which fills whole cache lines, so that the workers
+ * never write on the same line. The slots are read once the workers are done.
+ */
+struct alignas(64) worker_stats {
+    // tasks computed
+    size_t tasks = 0;
+    // time spent computing the tasks (nanoseconds)
+    long busy_ns = 0;
+    // time spent running but waiting for a task (nanoseconds)
+    long idle_ns = 0;
+    // time spent paused by the autonomic controller (nanoseconds)
+    long paused_ns = 0;
+    // sum of the time the tasks waited in a queue before the worker took them (nanoseconds)
+    long queue_wait_ns = 0;
+
+    /**
+     * @return the fraction of the running time spent computing tasks, paused time excluded
+     */
+    [[nodiscard]] double utilization() const {
+        return busy_ns + idle_ns > 0 ? (double) busy_ns / (double) (busy_ns + idle_ns):0.0;
+    }
+
+    /**
+     * Add the time elapsed from the given point in time to one of the counters.
+     * @param counter the counter to increase
+     * @param from the beginning of the interval
+     * @return the end of the interval
+     */
+    static std::chrono::steady_clock::time_point lap(long &counter, std::chrono::steady_clock::time_point from) {
+        auto now = std::chrono::steady_clock::now();
+        counter += std::chrono::duration_cast<std::chrono::nanoseconds>(now - from).count();
+        return now;
+    }
+};
+
+#endif //AUTONOMICFARM_WORKERSTATS_HPP
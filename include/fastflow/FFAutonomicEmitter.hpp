@@ -5,23 +5,111 @@
 #include "MonitoringGatherer.hpp"
 #include "ff/multinode.hpp"
 #include "Autonomic.hpp"
+#include "WorkerSpeeds.hpp"
+#include "AdmissionControl.hpp"
+#include "TaskPriority.hpp"
+#include "FairQueue.hpp"
 
 template<typename InputType, typename WorkerType>
-class FFAutonomicEmitter : public ff::ff_monode_t<InputType>, Autonomic {
+class FFAutonomicEmitter : public ff::ff_monode_t<InputType>, public Autonomic {
 public:
+    // function giving the priority of a task
+    using ClassifyFunType = std::function<task_priority(const InputType&)>;
+    // function giving the tenant of a task
+    using TenantFunType = std::function<uint32_t(const InputType&)>;
+
     FFAutonomicEmitter(size_t num_workers, size_t minNumWorkers, size_t maxNumWorkers, double target_service_time, farm_analytics *analytics)
-    : Autonomic(analytics, num_workers, minNumWorkers, maxNumWorkers, target_service_time) {
+    : Autonomic(analytics, num_workers, minNumWorkers, maxNumWorkers, target_service_time), speeds(maxNumWorkers) {
         // at the beginning every worker can already receive a new task
         for (size_t i = 0; i < num_workers; ++i) {
             ready_workers.insert(i);
         }
 
         arrival_time = 0;
-        worker_service_time = 0;
     }
 
     void addWorker(WorkerType* worker) {
         workers.push_back(worker);
+        queue_wait_ns.push_back(0);
+        computing.emplace_back();
+    }
+
+    /**
+     * @param worker_index the index of a worker
+     * @return the sum of the time the tasks sent to the worker waited in the buffer of the emitter (nanoseconds)
+     */
+    long getQueueWait(size_t worker_index) const {
+        return queue_wait_ns[worker_index];
+    }
+
+    /**
+     * Drop the tasks the farm cannot keep up with, as decided by the given admission control. It must be called before
+     * running the farm.
+     * @param admission the admission control
+     */
+    void setAdmission(const AdmissionControl &admission) {
+        this->admission.emplace(admission);
+    }
+
+    /**
+     * Dispatch the buffered tasks earliest virtual deadline first, as given by their priority, instead of in FIFO
+     * order. It must be called before running the farm.
+     * @param classify the function giving the priority of a task
+     * @param aging_ms the aging period of the classes (milliseconds)
+     */
+    void setPriorities(const ClassifyFunType &classify, double aging_ms) {
+        this->classify = classify;
+        aging = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(aging_ms));
+    }
+
+    /**
+     * Buffer the tasks of each tenant apart, and dispatch them by weighted deficit round robin over the tenants, each
+     * task costing the service time of the tasks of its tenant. The priorities only order the tasks of the same tenant.
+     * It must be called before running the farm.
+     * @param tenant_of the function giving the tenant of a task, numbered from zero
+     */
+    void setTenants(const TenantFunType &tenant_of) {
+        this->tenant_of = tenant_of;
+        fair.emplace();
+    }
+
+    /**
+     * Set the share of the workers given to a tenant, one by default. The tenants must be set.
+     */
+    void setTenantWeight(uint32_t tenant, double weight) {
+        fair->setWeight(tenant, weight);
+    }
+
+    /**
+     * Cap the workers computing the tasks of a tenant at once, zero for no cap. The tenants must be set.
+     */
+    void setTenantCap(uint32_t tenant, size_t max_workers) {
+        fair->setCap(tenant, max_workers);
+    }
+
+    /**
+     * @return what each tenant got from the farm, complete once the farm ended
+     */
+    std::vector<tenant_stats> tenantStats() const {
+        std::vector<tenant_stats> stats;
+        if (!fair) return stats;
+        tenant_stats::merge(stats, fair->stats());
+        tenant_stats::merge(stats, tenants);
+        return stats;
+    }
+
+    /**
+     * @return the latencies of the tasks by priority class, complete once the farm ended
+     */
+    const std::vector<class_latency>& classLatencies() const {
+        return latencies;
+    }
+
+    /**
+     * @return how many tasks were admitted and dropped, complete once the farm ended
+     */
+    shed_stats shedStats() const {
+        return admission ? admission->stats():shed_stats();
     }
 
     int svc_init() override;
@@ -36,8 +124,45 @@ private:
     std::vector<WorkerType*> workers;
 
     std::deque<InputType*> buffer;
+    // points in time when the tasks in the buffer were buffered
+    std::deque<std::chrono::steady_clock::time_point> buffered_at;
+    // time waited in the buffer by the tasks of each worker (nanoseconds)
+    std::vector<long> queue_wait_ns;
     std::set<size_t> ready_workers;
     std::set<size_t> paused_workers;
+    // service time of each worker, from their feedback
+    WorkerSpeeds speeds;
+    // admission control of the tasks, if enabled
+    std::optional<AdmissionControl> admission;
+
+    // priorities of the tasks, if enabled: the buffer is ordered by virtual deadline
+    ClassifyFunType classify;
+    std::chrono::steady_clock::duration aging{0};
+    std::deque<std::chrono::steady_clock::time_point> dispatch_times;
+    std::deque<uint32_t> buffered_classes;
+    // class, tenant and arrival of the task computed by each worker, to measure its latency
+    struct computed_task {
+        uint32_t priority_class = 0;
+        uint32_t tenant = 0;
+        std::chrono::steady_clock::time_point arrived;
+    };
+    std::vector<computed_task> computing;
+    std::vector<class_latency> latencies;
+    // moving average of the arrival time of the most urgent class, -1 until known
+    double priority_arrival_time = -1;
+    std::chrono::system_clock::time_point last_priority_arrival_timepoint;
+    // weight of the newest arrival on the arrival time of the most urgent class
+    const double priority_arrival_smoothing = 0.2;
+
+    // buffers of the tenants, if enabled, used instead of the single buffer
+    struct tenant_task {
+        InputType* task;
+        std::chrono::steady_clock::time_point buffered_at;
+        uint32_t priority_class;
+    };
+    TenantFunType tenant_of;
+    std::optional<FairQueue<tenant_task>> fair;
+    std::vector<tenant_stats> tenants;
 
     bool eos_flag = false;
     size_t emitted = 0;
@@ -48,7 +173,6 @@ private:
     long arrival_time;
     std::chrono::system_clock::time_point last_arrival_timepoint;
 
-    long worker_service_time;
 
     void pauseWorkers(size_t fromIndex, size_t toIndex) override;
 
@@ -59,16 +183,140 @@ private:
     }
 
     long getWorkerServiceTime() override {
-        return worker_service_time;
+        // the running workers may have different speeds, so their service times are combined
+        return std::max(0L, std::lround(speeds.combinedServiceTime(num_workers)));
+    }
+
+    /**
+     * @return the fastest worker ready to receive a task
+     */
+    size_t fastestReadyWorker() {
+        return *std::min_element(ready_workers.begin(), ready_workers.end(), [this](size_t a, size_t b) {
+            // never observed workers first, so that they get observed
+            return speeds.serviceTime(a) < speeds.serviceTime(b);
+        });
+    }
+
+    size_t getNumArrivals() override {
+        return emitted;
+    }
+
+    size_t getNumCompleted() override {
+        return gathered;
+    }
+
+    double getPriorityArrivalTime() override {
+        return priority_arrival_time;
+    }
+
+    size_t getUsefulNumWorkers() override {
+        return fair ? fair->usefulWorkers():std::numeric_limits<size_t>::max();
+    }
+
+    /**
+     * @return the number of tasks buffered
+     */
+    size_t waiting() const {
+        return buffer.size() + (fair ? fair->size():0);
+    }
+
+    /**
+     * Send the tasks of the tenants to the ready workers, by deficit round robin, as long as both are left.
+     */
+    void dispatchTenants();
+
+    /**
+     * Put a task into the buffer: at the end, or after the tasks due before it if the priorities are enabled.
+     */
+    void bufferTask(InputType* task, std::chrono::steady_clock::time_point now, const task_priority &priority);
+
+    /**
+     * Take the task at the front of the buffer.
+     */
+    void popFront() {
+        buffer.pop_front();
+        buffered_at.pop_front();
+        if (classify) {
+            dispatch_times.pop_front();
+            buffered_classes.pop_front();
+        }
+    }
+
+    /**
+     * Drop the task at the front of the buffer.
+     */
+    void shedFront(shed_reason reason) {
+        admission->onShed(reason);
+        popFront();
+    }
+
+    /**
+     * Drop the oldest task of the buffer to make room for a new one, or the one due last if the priorities are
+     * enabled: the front is then the most urgent task, which the priorities protect.
+     */
+    void shedOldest() {
+        if (!classify) {
+            shedFront(shed_reason::oldest);
+            return;
+        }
+        admission->onShed(shed_reason::oldest);
+        buffer.pop_back();
+        buffered_at.pop_back();
+        dispatch_times.pop_back();
+        buffered_classes.pop_back();
     }
 };
 
+template<typename InputType, typename WorkerType>
+void FFAutonomicEmitter<InputType, WorkerType>::bufferTask(InputType* task, std::chrono::steady_clock::time_point now,
+                                                           const task_priority &priority) {
+    if (!classify) {
+        buffer.push_back(task);
+        buffered_at.push_back(now);
+        return;
+    }
+    auto due = priority.dispatchBy(now, aging);
+    // after the tasks due at the same time, to keep their order
+    auto position = std::upper_bound(dispatch_times.begin(), dispatch_times.end(), due) - dispatch_times.begin();
+    dispatch_times.insert(dispatch_times.begin() + position, due);
+    buffered_classes.insert(buffered_classes.begin() + position, priority.priority_class);
+    buffer.insert(buffer.begin() + position, task);
+    buffered_at.insert(buffered_at.begin() + position, now);
+}
+
+template<typename InputType, typename WorkerType>
+void FFAutonomicEmitter<InputType, WorkerType>::dispatchTenants() {
+    uint32_t tenant;
+    while (!ready_workers.empty()) {
+        auto next = fair->pop(tenant);
+        if (!next) return;
+        auto now = std::chrono::steady_clock::now();
+        if (admission) {
+            if (admission->expired(next->buffered_at, now)) {
+                admission->onShed(shed_reason::expired);
+                fair->release(tenant);
+                continue;
+            }
+            admission->onDeparture(next->buffered_at, now);
+        }
+        size_t worker_index = fastestReadyWorker();
+        ready_workers.erase(worker_index);
+        worker_stats::lap(queue_wait_ns[worker_index], next->buffered_at);
+        computing[worker_index] = { next->priority_class, tenant, next->buffered_at };
+        this->lb->ff_send_out_to(new WorkerCommand<InputType>(next->task), worker_index);
+
+        onthefly++;
+    }
+}
+
 template<typename InputType, typename WorkerType>
 int FFAutonomicEmitter<InputType, WorkerType>::svc_init() {
     analytics->num_workers.emplace_back(this->num_workers, 0);
     // initialize the arrival time
     last_change = analytics->farm_start_time;
     last_arrival_timepoint = analytics->farm_start_time;
+    last_priority_arrival_timepoint = analytics->farm_start_time;
+    EventTracer::nameThread("emitter");
 
     return 0;
 }
@@ -84,34 +332,75 @@ InputType *FFAutonomicEmitter<InputType, WorkerType>::svc(InputType *in) {
         if (target_best_service_time) target_service_time = (double) arrival_time;
         last_arrival_timepoint = now;
 
+        EventTracer::record(trace_event::enqueue, (int32_t) emitted);
         emitted++;
 
-        if (ready_workers.empty()) {
-            buffer.push_back(in);
+        auto buffered_now = std::chrono::steady_clock::now();
+        task_priority priority;
+        if (classify) {
+            priority = classify(*in);
+            if (priority.priority_class == 0) {
+                auto elapsed = (double) ELAPSED(last_priority_arrival_timepoint, now, std::chrono::milliseconds);
+                priority_arrival_time = priority_arrival_time < 0 ? elapsed:priority_arrival_smoothing * elapsed + (1 - priority_arrival_smoothing) * priority_arrival_time;
+                last_priority_arrival_timepoint = now;
+            }
+        }
+        std::optional<shed_reason> shed;
+        if (admission) shed = admission->onArrival(waiting(), buffered_now);
+        if (shed && shed != shed_reason::oldest) {
+            // the task is owned by the source, dropping it is just not sending it
+            admission->onShed(*shed);
+        } else if (fair) {
+            // the tenant flooding the farm makes room for the task, and the task waits for its tenant's turn
+            uint32_t longest;
+            if (shed && fair->popLongest(longest, (bool) classify)) admission->onShed(shed_reason::oldest);
+            tenant_task task{ in, buffered_now, priority.priority_class };
+            fair->push(tenant_of(*in), task, classify ? priority.dispatchBy(buffered_now, aging):std::chrono::steady_clock::time_point());
+        } else if (ready_workers.empty()) {
+            if (shed && !buffer.empty()) shedOldest();
+            bufferTask(in, buffered_now, priority);
         } else {
-            size_t worker_index = *ready_workers.begin();
+            // the task doesn't wait: the queue has no delay
+            if (admission) admission->onDeparture(buffered_now, buffered_now);
+            size_t worker_index = fastestReadyWorker();
             ready_workers.erase(worker_index);
+            computing[worker_index] = { priority.priority_class, 0, buffered_now };
             this->lb->ff_send_out_to(new WorkerCommand<InputType>(in), worker_index);
 
             onthefly++;
         }
         //return this->GO_ON;
     } else if (channel < this->lb->get_num_outchannels()) {
-        // received feedback from worker
-        if (channel < num_workers) {
+        // received feedback from worker, which completed its task
+        auto *this_worker_service_time = reinterpret_cast<long*>(in);
+        auto &completed = computing[channel];
+        double latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - completed.arrived).count();
+        if (classify) class_latency::record(latencies, completed.priority_class, latency_ms);
+        if (fair) {
+            fair->done(completed.tenant, (double) *this_worker_service_time);
+            tenant_stats::record(tenants, completed.tenant, (double) *this_worker_service_time, latency_ms);
+            // the tasks of the tenants are sent to the ready workers below
+            if (paused_workers.count(channel) == 0) ready_workers.insert(channel);
+        } else if (paused_workers.count(channel) == 0) {
+            if (admission && !buffer.empty()) {
+                auto now = std::chrono::steady_clock::now();
+                while (!buffer.empty() && admission->expired(buffered_at.front(), now)) shedFront(shed_reason::expired);
+                if (!buffer.empty()) admission->onDeparture(buffered_at.front(), now);
+            }
             if (buffer.empty()) {
                 ready_workers.insert(channel);
             } else {
                 this->lb->ff_send_out_to(new WorkerCommand<InputType>(buffer.front()), channel);
-                buffer.pop_front();
+                worker_stats::lap(queue_wait_ns[channel], buffered_at.front());
+                computing[channel] = { classify ? buffered_classes.front():0, 0, buffered_at.front() };
+                popFront();
 
                 onthefly++;
             }
         }
 
         // update worker's service time
-        auto *this_worker_service_time = reinterpret_cast<long*>(in);
-        worker_service_time = *this_worker_service_time;
+        speeds.observe(channel, (double) *this_worker_service_time);
         delete this_worker_service_time;
         //return this->GO_ON;
     } else if (channel == this->lb->get_num_outchannels()) {
@@ -128,9 +417,12 @@ InputType *FFAutonomicEmitter<InputType, WorkerType>::svc(InputType *in) {
         //return this->GO_ON;
     }
 
-    TRACEF("channel %d, emitted %ld, gathered %ld, eos %d, onthefly %ld, buffer.empty %d, ready %ld, paused %ld",
-           channel, emitted, gathered, eos_flag, onthefly, buffer.empty(), ready_workers.size(), paused_workers.size());
-    if (eos_flag && buffer.empty() && onthefly <= 0) {
+    // a task arrived, a worker became ready or a tenant got below its cap
+    if (fair) dispatchTenants();
+
+    TRACEF("channel %d, emitted %ld, gathered %ld, eos %d, onthefly %ld, waiting %ld, ready %ld, paused %ld",
+           channel, emitted, gathered, eos_flag, onthefly, waiting(), ready_workers.size(), paused_workers.size());
+    if (eos_flag && waiting() == 0 && onthefly <= 0) {
         this->broadcast_task(this->EOS);
         unpauseWorkers(0, max_num_workers-1);
         return this->EOS;
@@ -148,9 +440,10 @@ template<typename InputType, typename WorkerType>
 void FFAutonomicEmitter<InputType, WorkerType>::eosnotify(ssize_t id) {
     if (id == -1) { // received EOS from input channel
         eos_flag = true;
-        TRACEF("Emitter eosnotify: emitted %ld, gathered %ld, eos %d, onthefly %ld, buffer.empty %d, ready %ld, paused %ld",
-               emitted, gathered, eos_flag, onthefly, buffer.empty(), ready_workers.size(), paused_workers.size());
-        if (buffer.empty() && onthefly <= 0) {
+        EventTracer::record(trace_event::eos);
+        TRACEF("Emitter eosnotify: emitted %ld, gathered %ld, eos %d, onthefly %ld, waiting %ld, ready %ld, paused %ld",
+               emitted, gathered, eos_flag, onthefly, waiting(), ready_workers.size(), paused_workers.size());
+        if (waiting() == 0 && onthefly <= 0) {
             this->broadcast_task(this->EOS);
             unpauseWorkers(0, max_num_workers-1);
         }
@@ -159,7 +452,10 @@ void FFAutonomicEmitter<InputType, WorkerType>::eosnotify(ssize_t id) {
 
 template<typename InputType, typename WorkerType>
 void FFAutonomicEmitter<InputType, WorkerType>::pauseWorkers(size_t fromIndex, size_t toIndex) {
-    for (size_t i = fromIndex; i <= toIndex; ++i) {
+    // the slowest running workers are paused first
+    speeds.reorder(num_workers);
+    for (size_t position = fromIndex; position <= toIndex; ++position) {
+        size_t i = speeds.at(position);
         TRACEF("%ld", i);
         //this->ff_send_out_to(this->GO_OUT, i);
         this->ff_send_out_to(new WorkerCommand<InputType>(), i);
@@ -170,7 +466,10 @@ void FFAutonomicEmitter<InputType, WorkerType>::pauseWorkers(size_t fromIndex, s
 
 template<typename InputType, typename WorkerType>
 void FFAutonomicEmitter<InputType, WorkerType>::unpauseWorkers(size_t fromIndex, size_t toIndex) {
-    for (size_t i = fromIndex; i <= toIndex; ++i) {
+    // the fastest paused workers are unpaused first
+    speeds.reorder(num_workers);
+    for (size_t position = fromIndex; position <= toIndex; ++position) {
+        size_t i = speeds.at(position);
         TRACEF("%ld", i);
         //this->lb->thaw(i, true);
         workers[i]->unpause();
@@ -24,6 +24,60 @@ public:
     void run(SourceNodeType &source);
     void wait();
 
+    /**
+     * @return the controller which changes the number of workers of this farm, to configure it before running the farm
+     */
+    Autonomic& autonomic() {
+        return *emitter;
+    }
+
+    /**
+     * Drop the tasks the farm cannot keep up with, as decided by the given admission control, instead of buffering
+     * every task in the emitter. It must be called before running the farm.
+     * @param admission the admission control
+     */
+    void setAdmission(const AdmissionControl &admission) {
+        emitter->setAdmission(admission);
+        shedding = true;
+    }
+
+    /**
+     * Dispatch the buffered tasks earliest virtual deadline first, as given by their priority, instead of in FIFO
+     * order, and record their latency by priority class. It must be called before running the farm.
+     * @param classify the function giving the priority of a task
+     * @param aging_ms the aging period of the classes (milliseconds)
+     */
+    void setPriorities(const typename FFAutonomicEmitter<InputType, FFAutonomicWorker<InputType, OutputType>>::ClassifyFunType &classify,
+                       double aging_ms) {
+        emitter->setPriorities(classify, aging_ms);
+        prioritized = true;
+    }
+
+    /**
+     * Share the farm among the tenants sending the tasks, by weighted deficit round robin over a buffer per tenant, and
+     * record what each tenant got. A tenant may be capped to some workers at once, and then the controller never runs
+     * more workers than the tenants with tasks can use. It must be called before running the farm.
+     * @param tenant_of the function giving the tenant of a task, numbered from zero
+     * @param weights the weight of each tenant, one for the missing ones
+     * @param caps the most workers of each tenant at once, zero or missing for no cap
+     */
+    void setTenants(const typename FFAutonomicEmitter<InputType, FFAutonomicWorker<InputType, OutputType>>::TenantFunType &tenant_of,
+                    const std::vector<double> &weights = {}, const std::vector<size_t> &caps = {}) {
+        emitter->setTenants(tenant_of);
+        for (size_t i = 0; i < weights.size(); ++i) emitter->setTenantWeight(i, weights[i]);
+        for (size_t i = 0; i < caps.size(); ++i) emitter->setTenantCap(i, caps[i]);
+        shared = true;
+    }
+
+    /**
+     * Count the hardware events of the tasks of each worker, summed per window of time. It must be called before
+     * running the farm.
+     * @param window_ms the length of the windows (milliseconds)
+     */
+    void setPerfCounters(long window_ms) {
+        for (auto worker: workers) worker->enablePerfCounters(window_ms);
+    }
+
     virtual ~FFAutonomicFarm();
 
 private:
@@ -31,21 +85,26 @@ private:
     farm_analytics *analytics;
     FFAutonomicEmitter<InputType, FFAutonomicWorker<InputType, OutputType>> *emitter;
     FFAutonomicGatherer<OutputType> *collector;
+    std::vector<FFAutonomicWorker<InputType, OutputType>*> workers;
     ff::ff_Pipe<InputType, OutputType>* running_pipe;
+    bool shedding = false;
+    bool prioritized = false;
+    bool shared = false;
 };
 
 template<typename InputType, typename OutputType>
 FFAutonomicFarm<InputType, OutputType>::FFAutonomicFarm(size_t num_workers, size_t minNumWorkers, size_t maxNumWorkers,
     double target_service_time, const WorkerFunType &fun, const SendOutFunType &sendOutFun, farm_analytics *analytics)
     : analytics(analytics) {
-    std::vector<ff::ff_node*> workers;
+    std::vector<ff::ff_node*> nodes;
     emitter = new FFAutonomicEmitter<InputType, FFAutonomicWorker<InputType, OutputType>>(num_workers, minNumWorkers, maxNumWorkers, target_service_time, analytics);
     for (auto i = 0; i < maxNumWorkers; i++) {
         auto worker = new FFAutonomicWorker<InputType, OutputType>(fun);
+        nodes.push_back(worker);
         workers.push_back(worker);
         emitter->addWorker(worker);
     }
-    farm = new ff::ff_farm(workers);
+    farm = new ff::ff_farm(nodes);
     farm->cleanup_workers();
     farm->remove_collector();
     farm->add_emitter(emitter);
@@ -70,6 +129,17 @@ template<typename InputType, typename OutputType>
 void FFAutonomicFarm<InputType, OutputType>::wait() {
     this->running_pipe->wait_freezing();
     this->running_pipe->wait();
+
+    long start_ms = std::chrono::duration_cast<std::chrono::milliseconds>(analytics->farm_start_time.time_since_epoch()).count();
+    analytics->workers.clear();
+    for (size_t i = 0; i < workers.size(); ++i) {
+        analytics->workers.push_back(workers[i]->getStats());
+        analytics->workers.back().queue_wait_ns = emitter->getQueueWait(i);
+        if (workers[i]->getPerfCounters() != nullptr) analytics->add_perf_counters(*workers[i]->getPerfCounters(), start_ms);
+    }
+    if (shedding) analytics->shedding = emitter->shedStats();
+    if (prioritized) class_latency::merge(analytics->latency_by_class, emitter->classLatencies());
+    if (shared) analytics->tenants = emitter->tenantStats();
 }
 
 template<typename InputType, typename OutputType>
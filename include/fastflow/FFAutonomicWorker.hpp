@@ -2,8 +2,12 @@
 #define AUTONOMICFARM_FFAUTONOMICWORKER_HPP
 
 
+#include <memory>
 #include <ff/ff.hpp>
 #include <ff/farm.hpp>
+#include "WorkerStats.hpp"
+#include "PerfCounters.hpp"
+#include "EventTracer.hpp"
 
 template <typename InputType>
 struct WorkerCommand {
@@ -30,9 +34,37 @@ public:
     void svc_end() override;
 
     void unpause();
+
+    /**
+     * @return the statistics of this worker, complete once the worker finished. The queue wait is measured by the
+     * emitter, which buffers the tasks
+     */
+    const worker_stats& getStats() const {
+        return stats;
+    }
+
+    /**
+     * Count the hardware events of the tasks, summed per window of time. It must be called before running.
+     * @param window_ms the length of the windows (milliseconds)
+     */
+    void enablePerfCounters(long window_ms) {
+        perf = std::make_unique<PerfCounters>(window_ms);
+    }
+
+    /**
+     * @return the counters of this worker, complete once the worker finished, or nullptr if not enabled
+     */
+    const PerfCounters* getPerfCounters() const {
+        return perf.get();
+    }
 private:
     WorkerFunType fun;
 
+    // only written by the thread of this worker
+    worker_stats stats;
+    std::chrono::steady_clock::time_point idle_from;
+    std::unique_ptr<PerfCounters> perf;
+
     std::mutex mutex;
     std::condition_variable cond_pause;
     bool is_paused = false;
@@ -41,6 +73,9 @@ private:
 template<typename InputType, typename OutputType>
 int FFAutonomicWorker<InputType, OutputType>::svc_init() {
     TRACEF("Worker %ld init", this->get_my_id());
+    idle_from = std::chrono::steady_clock::now();
+    if (perf) perf->open();
+    EventTracer::nameThread("worker " + std::to_string(this->get_my_id()));
     return 0;
 }
 
@@ -49,15 +84,26 @@ OutputType *FFAutonomicWorker<InputType, OutputType>::svc(WorkerCommand<InputTyp
     TRACEF("Worker %ld svc", this->get_my_id());
     if (cmd->pause) {
         TRACEF("Worker %ld going to sleep", this->get_my_id());
+        idle_from = worker_stats::lap(stats.idle_ns, idle_from);
+        EventTracer::record(trace_event::pause);
         std::unique_lock<std::mutex> lock(mutex);
         is_paused = true;
         cond_pause.wait(lock, [this] { return !this->is_paused; });
+        EventTracer::record(trace_event::unpause);
+        idle_from = worker_stats::lap(stats.paused_ns, idle_from);
         TRACEF("Worker %ld woke up", this->get_my_id());
     } else {
         auto task = cmd->task;
+        auto taken = worker_stats::lap(stats.idle_ns, idle_from);
         START(now);
+        EventTracer::record(trace_event::task_start, (int32_t) stats.tasks);
+        if (perf) perf->begin();
         auto result = fun(task);
+        if (perf) perf->end();
+        EventTracer::record(trace_event::task_end);
         STOP(now, service_time, std::chrono::milliseconds);
+        stats.tasks++;
+        idle_from = worker_stats::lap(stats.busy_ns, taken);
         this->ff_send_out_to(result, 1); // send to the gatherer
         this->ff_send_out_to(new long(service_time), 0); // send feedback to emitter
         TRACEF("Worker %ld svc end", this->get_my_id());
@@ -70,12 +116,14 @@ template<typename InputType, typename OutputType>
 void FFAutonomicWorker<InputType, OutputType>::eosnotify(ssize_t id) {
     if (id == -1) {
         TRACEF("Worker %ld eosnotify", this->get_my_id());
+        EventTracer::record(trace_event::eos);
     }
 }
 
 template<typename InputType, typename OutputType>
 void FFAutonomicWorker<InputType, OutputType>::svc_end() {
     TRACEF("Worker %ld end", this->get_my_id());
+    worker_stats::lap(stats.idle_ns, idle_from);
 }
 
 template<typename InputType, typename OutputType>
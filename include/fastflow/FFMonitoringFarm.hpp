@@ -21,22 +21,33 @@ public:
     void run(SourceNodeType &source);
     void wait();
 
+    /**
+     * Count the hardware events of the tasks of each worker, summed per window of time. It must be called before
+     * running the farm.
+     * @param window_ms the length of the windows (milliseconds)
+     */
+    void setPerfCounters(long window_ms) {
+        for (auto worker: workers) worker->enablePerfCounters(window_ms);
+    }
+
 private:
     ff::ff_farm *farm;
     farm_analytics *analytics;
     FFMonitoringGatherer<OutputType> *collector;
+    std::vector<FFWorker<InputType, OutputType>*> workers;
     ff::ff_Pipe<InputType, OutputType>* running_pipe;
 };
 
 template<typename InputType, typename OutputType>
 FFMonitoringFarm<InputType, OutputType>::FFMonitoringFarm(size_t num_workers, const WorkerFunType &fun, const SendOutFunType &sendOutFun,
                                                           farm_analytics *analytics) : analytics(analytics) {
-    std::vector<ff::ff_node *> workers;
+    std::vector<ff::ff_node *> nodes;
     for (auto i = 0; i < num_workers; i++) {
         workers.push_back(new FFWorker<InputType, OutputType>(fun));
+        nodes.push_back(workers.back());
     }
     farm = new ff::ff_farm();
-    farm->add_workers(workers);
+    farm->add_workers(nodes);
     collector = new FFMonitoringGatherer<OutputType>(sendOutFun, analytics);
     farm->add_collector(collector);
     // we already know the current number of workers
@@ -55,6 +66,14 @@ void FFMonitoringFarm<InputType, OutputType>::run(SourceNodeType &source) {
 template<typename InputType, typename OutputType>
 void FFMonitoringFarm<InputType, OutputType>::wait() {
     this->running_pipe->wait_freezing();
+
+    // the queues of the workers belong to FastFlow, hence the queue wait isn't measured
+    long start_ms = std::chrono::duration_cast<std::chrono::milliseconds>(analytics->farm_start_time.time_since_epoch()).count();
+    analytics->workers.clear();
+    for (auto worker: workers) {
+        analytics->workers.push_back(worker->getStats());
+        if (worker->getPerfCounters() != nullptr) analytics->add_perf_counters(*worker->getPerfCounters(), start_ms);
+    }
 }
 
 
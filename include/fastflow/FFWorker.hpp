@@ -1,8 +1,12 @@
 #ifndef AUTONOMICFARM_FFWORKER_HPP
 #define AUTONOMICFARM_FFWORKER_HPP
 
+#include <memory>
 #include <ff/ff.hpp>
 #include <ff/farm.hpp>
+#include "WorkerStats.hpp"
+#include "PerfCounters.hpp"
+#include "EventTracer.hpp"
 
 template <typename InputType, typename OutputType>
 class FFWorker : public ff::ff_node_t<InputType, OutputType> {
@@ -11,16 +15,66 @@ public:
 
     explicit FFWorker(const WorkerFunType &fun) : fun(fun) {}
 
+    int svc_init() override;
+
     OutputType *svc(InputType *task) override;
 
+    void svc_end() override;
+
+    /**
+     * @return the statistics of this worker, complete once the worker finished
+     */
+    const worker_stats& getStats() const {
+        return stats;
+    }
+
+    /**
+     * Count the hardware events of the tasks, summed per window of time. It must be called before running.
+     * @param window_ms the length of the windows (milliseconds)
+     */
+    void enablePerfCounters(long window_ms) {
+        perf = std::make_unique<PerfCounters>(window_ms);
+    }
+
+    /**
+     * @return the counters of this worker, complete once the worker finished, or nullptr if not enabled
+     */
+    const PerfCounters* getPerfCounters() const {
+        return perf.get();
+    }
+
 private:
     WorkerFunType fun;
 
+    // only written by the thread of this worker
+    worker_stats stats;
+    std::chrono::steady_clock::time_point idle_from;
+    std::unique_ptr<PerfCounters> perf;
 };
 
+template<typename InputType, typename OutputType>
+int FFWorker<InputType, OutputType>::svc_init() {
+    idle_from = std::chrono::steady_clock::now();
+    if (perf) perf->open();
+    EventTracer::nameThread("worker " + std::to_string(this->get_my_id()));
+    return 0;
+}
+
+template<typename InputType, typename OutputType>
+void FFWorker<InputType, OutputType>::svc_end() {
+    worker_stats::lap(stats.idle_ns, idle_from);
+}
+
 template<typename InputType, typename OutputType>
 OutputType *FFWorker<InputType, OutputType>::svc(InputType *task) {
+    auto taken = worker_stats::lap(stats.idle_ns, idle_from);
+    EventTracer::record(trace_event::task_start, (int32_t) stats.tasks);
+    if (perf) perf->begin();
     auto result = fun(task);
+    if (perf) perf->end();
+    EventTracer::record(trace_event::task_end);
+    stats.tasks++;
+    idle_from = worker_stats::lap(stats.busy_ns, taken);
     this->ff_send_out(result);
     return this->GO_ON;
 }
@@ -0,0 +1,284 @@
+#ifndef AUTONOMICFARM_FARMSIMULATOR_HPP
+#define AUTONOMICFARM_FARMSIMULATOR_HPP
+
+#include <queue>
+#include <deque>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "MonitoredFarm.hpp"
+#include "Autonomic.hpp"
+
+/**
+ * An item of a trace replayed by the simulator.
+ */
+struct trace_item {
+    // point in time when the item arrives, relative to the beginning of the stream
+    std::chrono::nanoseconds arrival_offset;
+    // time needed by a worker to compute the item (milliseconds)
+    double service_time_ms;
+};
+
+/**
+ * Load a trace from a csv file with a header and two columns: the arrival time of each item relative to the beginning
+ * of the stream and its service time, both in milliseconds.
+ * @param path the path of the csv file
+ * @return the items of the trace, in arrival order
+ */
+std::vector<trace_item> load_trace(const std::string &path) {
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("cannot open trace " + path);
+    std::vector<trace_item> trace;
+    std::string line;
+    std::getline(file, line); // skip the header
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+        std::istringstream row(line);
+        std::string arrival, service;
+        std::getline(row, arrival, ',');
+        std::getline(row, service, ',');
+        trace.push_back({ std::chrono::nanoseconds((long long) (std::stod(arrival) * 1e6)), std::stod(service) });
+    }
+    return trace;
+}
+
+/**
+ * The clock of a simulation. Time only moves forward when the simulator processes the next event.
+ */
+struct virtual_clock {
+    std::chrono::system_clock::time_point now;
+};
+
+/**
+ * Monitoring gatherer whose measurements are timestamped with a virtual clock. It is never run as a thread: the
+ * simulator calls onValue directly when a task completes.
+ */
+class SimulatedGatherer : public MonitoringGatherer<size_t> {
+public:
+    SimulatedGatherer(farm_analytics *analytics, virtual_clock *clock)
+    : MonitoringGatherer<size_t>([](size_t&) {}, analytics), clock(clock) {}
+
+protected:
+    std::chrono::system_clock::time_point currentTime() override {
+        return clock->now;
+    }
+
+private:
+    virtual_clock *clock;
+};
+
+template <typename PolicyType>
+class FarmSimulator;
+
+/**
+ * Adapts an autonomic policy to the simulator. Pausing and unpausing workers changes the simulated workers, while the
+ * arrival time and the worker's service time are the ones of the simulated stream.
+ * @tparam PolicyType the policy under evaluation. It must derive from Autonomic and have the same constructor
+ */
+template <typename PolicyType>
+class SimulatedPolicy : public PolicyType {
+public:
+    SimulatedPolicy(FarmSimulator<PolicyType> *simulator, farm_analytics *analytics, size_t num_workers,
+                    size_t min_num_workers, size_t max_num_workers, double target_service_time)
+    : PolicyType(analytics, num_workers, min_num_workers, max_num_workers, target_service_time), simulator(simulator) {
+        this->last_change = analytics->farm_start_time;
+    }
+
+    /**
+     * Notify a new arrival, by giving the time elapsed from the previous one.
+     * @param new_arrival_time the time elapsed from the previous arrival (milliseconds)
+     */
+    void onArrival(long new_arrival_time) {
+        arrival_time = new_arrival_time;
+        num_arrivals++;
+        if (this->target_best_service_time) this->target_service_time = (double) new_arrival_time;
+    }
+
+    /**
+     * Notify the service time of the last task computed by the reference worker.
+     * @param service_time the service time (milliseconds)
+     */
+    void onWorkerServiceTime(long service_time) {
+        worker_service_time = service_time;
+    }
+
+    /**
+     * Notify that a worker completed its task.
+     */
+    void onCompletion() {
+        num_completed++;
+    }
+
+protected:
+    void pauseWorkers(size_t fromIndex, size_t toIndex) override {
+        simulator->setPaused(fromIndex, toIndex, true);
+    }
+
+    void unpauseWorkers(size_t fromIndex, size_t toIndex) override {
+        simulator->setPaused(fromIndex, toIndex, false);
+    }
+
+    long getArrivalTime() override {
+        return arrival_time;
+    }
+
+    long getWorkerServiceTime() override {
+        return worker_service_time;
+    }
+
+    size_t getNumArrivals() override {
+        return num_arrivals;
+    }
+
+    size_t getNumCompleted() override {
+        return num_completed;
+    }
+
+    std::chrono::system_clock::time_point currentTime() override {
+        return simulator->clock.now;
+    }
+
+private:
+    FarmSimulator<PolicyType> *simulator;
+    long arrival_time = 0;
+    long worker_service_time = 0;
+    size_t num_arrivals = 0;
+    size_t num_completed = 0;
+};
+
+/**
+ * Discrete-event simulation of an autonomic farm. The farm is modelled as the autonomic worker pool: a central FIFO
+ * queue from which every unpaused worker pulls the next task as soon as it is free. A paused worker completes its
+ * current task and then stops pulling. Completed tasks are monitored by a gatherer and the newest service time is
+ * notified to the policy, exactly as done by the AutonomicGatherer, but every timestamp comes from a virtual clock, so
+ * that a stream is simulated much faster than real time. The produced analytics have the same format of a real run.
+ * @tparam PolicyType the autonomic policy under evaluation
+ */
+template <typename PolicyType = Autonomic>
+class FarmSimulator {
+public:
+    FarmSimulator(size_t num_workers, size_t min_num_workers, size_t max_num_workers, double target_service_time);
+
+    /**
+     * Replay the given trace until every item is computed.
+     * @param trace the items to send to the simulated farm, in arrival order
+     * @return the analytics of the simulated run
+     */
+    farm_analytics run(const std::vector<trace_item> &trace);
+
+    /**
+     * Set a function called on the policy before every run, to configure it as a real farm would.
+     * @param fun the function that configures the policy
+     */
+    void configure(const std::function<void(PolicyType&)> &fun) {
+        configure_policy = fun;
+    }
+
+private:
+    friend class SimulatedPolicy<PolicyType>;
+
+    struct simulated_worker {
+        bool busy = false;
+        bool paused = false;
+        std::chrono::system_clock::time_point started;
+    };
+
+    // pending completions, ordered by time. Pair <completion time, worker index>
+    using completion_event = std::pair<std::chrono::system_clock::time_point, size_t>;
+
+    size_t num_workers;
+    size_t min_num_workers;
+    size_t max_num_workers;
+    double target_service_time;
+    std::function<void(PolicyType&)> configure_policy;
+
+    virtual_clock clock;
+    farm_analytics analytics;
+    std::vector<simulated_worker> workers;
+    std::deque<size_t> queue; // indexes of the items waiting for a worker
+    std::priority_queue<completion_event, std::vector<completion_event>, std::greater<>> completions;
+
+    void setPaused(size_t fromIndex, size_t toIndex, bool paused);
+    void dispatch(const std::vector<trace_item> &trace);
+};
+
+template<typename PolicyType>
+FarmSimulator<PolicyType>::FarmSimulator(size_t num_workers, size_t min_num_workers, size_t max_num_workers,
+                                         double target_service_time)
+: num_workers(num_workers), min_num_workers(min_num_workers), max_num_workers(max_num_workers),
+  target_service_time(target_service_time) {}
+
+template<typename PolicyType>
+void FarmSimulator<PolicyType>::setPaused(size_t fromIndex, size_t toIndex, bool paused) {
+    for (size_t i = fromIndex; i <= toIndex; ++i) {
+        workers[i].paused = paused;
+    }
+}
+
+template<typename PolicyType>
+void FarmSimulator<PolicyType>::dispatch(const std::vector<trace_item> &trace) {
+    for (size_t i = 0; i < workers.size() && !queue.empty(); ++i) {
+        if (workers[i].busy || workers[i].paused) continue;
+        auto item = queue.front();
+        queue.pop_front();
+        workers[i].busy = true;
+        workers[i].started = clock.now;
+        auto service_time = std::chrono::nanoseconds((long long) (trace[item].service_time_ms * 1e6));
+        completions.emplace(clock.now + std::chrono::duration_cast<std::chrono::system_clock::duration>(service_time), i);
+    }
+}
+
+template<typename PolicyType>
+farm_analytics FarmSimulator<PolicyType>::run(const std::vector<trace_item> &trace) {
+    // the virtual time starts from the real one, so the csv files of different runs have different names
+    clock.now = std::chrono::system_clock::now();
+    analytics = farm_analytics();
+    analytics.farm_start_time = clock.now;
+    analytics.num_workers.emplace_back(num_workers, 0);
+    workers.assign(max_num_workers, simulated_worker());
+    setPaused(num_workers, max_num_workers - 1, true);
+    queue.clear();
+    completions = {};
+
+    SimulatedGatherer gatherer(&analytics, &clock);
+    SimulatedPolicy<PolicyType> policy(this, &analytics, num_workers, min_num_workers, max_num_workers, target_service_time);
+    if (configure_policy) configure_policy(policy);
+
+    size_t next_arrival = 0;
+    auto last_arrival = clock.now;
+    while (next_arrival < trace.size() || !completions.empty()) {
+        auto arrival_time = analytics.farm_start_time + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                next_arrival < trace.size() ? trace[next_arrival].arrival_offset:std::chrono::nanoseconds::max() / 2);
+        if (completions.empty() || arrival_time < completions.top().first) {
+            // next event: an item arrives
+            clock.now = arrival_time;
+            policy.onArrival(ELAPSED(last_arrival, clock.now, std::chrono::milliseconds));
+            last_arrival = clock.now;
+            analytics.arrival_time.emplace_back(ELAPSED(analytics.farm_start_time, clock.now, std::chrono::milliseconds));
+            queue.push_back(next_arrival++);
+        } else {
+            // next event: a worker completes its task
+            auto [completion_time, worker_index] = completions.top();
+            completions.pop();
+            clock.now = completion_time;
+            workers[worker_index].busy = false;
+            policy.onCompletion();
+            // the simulated workers are equally fast, so the first one gives the service time of any of them
+            if (worker_index == 0) {
+                policy.onWorkerServiceTime(ELAPSED(workers[0].started, clock.now, std::chrono::milliseconds));
+            }
+            auto prev_size = analytics.service_time.size();
+            size_t value = worker_index;
+            gatherer.onValue(value);
+            if (analytics.service_time.size() != prev_size) {
+                policy.onNewServiceTime(analytics.service_time.back().first);
+            }
+        }
+        dispatch(trace);
+    }
+    return analytics;
+}
+
+#endif //AUTONOMICFARM_FARMSIMULATOR_HPP
@@ -0,0 +1,224 @@
+#include <array>
+#include <thread>
+#include <benchmark/benchmark.h>
+#include "Stream.hpp"
+#include "ThreadedNode.hpp"
+#include "NodePool.hpp"
+#include "MonitoredFarm.hpp"
+#include "Autonomic.hpp"
+#include "EventTracer.hpp"
+
+// number of items sent through the nodes by each iteration of the multi-threaded benchmarks
+#define ITEMS_PER_ITERATION 16384
+
+template<size_t Size>
+using payload = std::array<char, Size>;
+
+/**
+ * Cost of one add followed by one next on the same thread, without any contention.
+ */
+template<typename PayloadType>
+static void BM_StreamAddNext(benchmark::State& state) {
+    Stream<PayloadType> stream;
+    PayloadType value{};
+    for (auto _ : state) {
+        stream.add(value);
+        benchmark::DoNotOptimize(stream.next());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * sizeof(PayloadType));
+}
+BENCHMARK(BM_StreamAddNext<payload<8>>);
+BENCHMARK(BM_StreamAddNext<payload<64>>);
+BENCHMARK(BM_StreamAddNext<payload<1024>>);
+
+/**
+ * Cost per item of a stream shared by many producers and consumers. The first argument is the number of producers,
+ * the second one the number of consumers.
+ */
+template<typename PayloadType>
+static void BM_StreamProducersConsumers(benchmark::State& state) {
+    auto producers = (size_t) state.range(0);
+    auto consumers = (size_t) state.range(1);
+    for (auto _ : state) {
+        Stream<PayloadType> stream;
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < consumers; ++i) {
+            threads.emplace_back([&stream]() {
+                while (stream.next().has_value());
+            });
+        }
+        std::vector<std::thread> producer_threads;
+        for (size_t i = 0; i < producers; ++i) {
+            producer_threads.emplace_back([&stream, producers]() {
+                PayloadType value{};
+                for (size_t item = 0; item < ITEMS_PER_ITERATION / producers; ++item) {
+                    stream.add(value);
+                }
+            });
+        }
+        for (auto &thread: producer_threads) thread.join();
+        stream.eos();
+        for (auto &thread: threads) thread.join();
+    }
+    state.SetItemsProcessed(state.iterations() * ITEMS_PER_ITERATION);
+    state.SetBytesProcessed(state.iterations() * ITEMS_PER_ITERATION * sizeof(PayloadType));
+}
+BENCHMARK(BM_StreamProducersConsumers<payload<8>>)->ArgsProduct({{1, 2, 4}, {1, 2, 4}})->UseRealTime();
+BENCHMARK(BM_StreamProducersConsumers<payload<1024>>)->ArgsProduct({{1, 4}, {1, 4}})->UseRealTime();
+
+/**
+ * Cost per item of crossing a chain of threaded nodes. The argument is the number of hops.
+ */
+static void BM_ThreadedNodeHops(benchmark::State& state) {
+    auto hops = (size_t) state.range(0);
+    for (auto _ : state) {
+        std::vector<std::unique_ptr<ThreadedNode<size_t>>> chain;
+        size_t received = 0;
+        chain.reserve(hops);
+        for (size_t i = 0; i < hops; ++i) {
+            if (i == hops - 1) {
+                chain.push_back(std::make_unique<ThreadedNode<size_t>>([&received](size_t&) { received++; }));
+            } else {
+                chain.push_back(std::make_unique<ThreadedNode<size_t>>([&chain, i](size_t& value) {
+                    chain[i + 1]->send(value);
+                }));
+            }
+        }
+        for (auto &node: chain) node->run();
+        for (size_t item = 0; item < ITEMS_PER_ITERATION; ++item) {
+            chain.front()->send(item);
+        }
+        // each node forwards every item before reaching the end-of-stream
+        for (auto &node: chain) {
+            node->notify_eos();
+            node->wait();
+        }
+        benchmark::DoNotOptimize(received);
+    }
+    state.SetItemsProcessed(state.iterations() * ITEMS_PER_ITERATION);
+}
+BENCHMARK(BM_ThreadedNodeHops)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+/**
+ * Cost per item of a node pool dispatching round-robin to its nodes. The argument is the number of nodes.
+ */
+static void BM_NodePoolSend(benchmark::State& state) {
+    auto num_nodes = (size_t) state.range(0);
+    for (auto _ : state) {
+        NodePool<size_t, ThreadedNode<size_t>> pool(num_nodes, [](size_t& value) { benchmark::DoNotOptimize(value); });
+        pool.run();
+        for (size_t item = 0; item < ITEMS_PER_ITERATION; ++item) {
+            pool.send(item);
+        }
+        pool.notify_eos();
+        pool.wait();
+    }
+    state.SetItemsProcessed(state.iterations() * ITEMS_PER_ITERATION);
+}
+BENCHMARK(BM_NodePoolSend)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+/**
+ * Cost per item of a node pool dispatching with a load-aware policy to 4 nodes. The argument is the dispatch policy.
+ */
+static void BM_NodePoolDispatch(benchmark::State& state) {
+    auto policy = (dispatch_policy) state.range(0);
+    for (auto _ : state) {
+        NodePool<size_t, ThreadedNode<size_t>> pool(4, [](size_t& value) { benchmark::DoNotOptimize(value); });
+        pool.setDispatchPolicy(policy, 2);
+        pool.run();
+        for (size_t item = 0; item < ITEMS_PER_ITERATION; ++item) {
+            pool.send(item);
+        }
+        pool.notify_eos();
+        pool.wait();
+    }
+    state.SetItemsProcessed(state.iterations() * ITEMS_PER_ITERATION);
+}
+BENCHMARK(BM_NodePoolDispatch)->DenseRange(0, 3)->UseRealTime();
+
+/**
+ * Cost of the monitoring computed by the gatherer for each item, called directly on the benchmark thread.
+ */
+static void BM_MonitoringGathererOnValue(benchmark::State& state) {
+    farm_analytics analytics;
+    analytics.farm_start_time = std::chrono::system_clock::now();
+    MonitoringGatherer<size_t> gatherer([](size_t&) {}, &analytics);
+    size_t value = 0;
+    for (auto _ : state) {
+        gatherer.onValue(value);
+        // avoid measuring the growth of the analytics
+        if (analytics.throughput_points.size() >= ITEMS_PER_ITERATION) {
+            state.PauseTiming();
+            analytics.throughput_points.erase(analytics.throughput_points.begin(), analytics.throughput_points.end() - 8);
+            analytics.service_time_points.erase(analytics.service_time_points.begin(), analytics.service_time_points.end() - 8);
+            analytics.throughput.clear();
+            analytics.service_time.clear();
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MonitoringGathererOnValue);
+
+/**
+ * Cost of recording an event, with the tracer disabled (0) and enabled (1).
+ */
+static void BM_EventTracerRecord(benchmark::State& state) {
+    if (state.range(0)) EventTracer::enable();
+    int32_t value = 0;
+    for (auto _ : state) {
+        EventTracer::record(trace_event::task_start, value++);
+    }
+    EventTracer::disable();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EventTracerRecord)->Arg(0)->Arg(1);
+
+/**
+ * Autonomic controller that doesn't pause or unpause anything, to measure the cost of the decisions only.
+ */
+class NoopAutonomic : public Autonomic {
+public:
+    NoopAutonomic(farm_analytics *analytics, size_t max_num_workers)
+    : Autonomic(analytics, 1, 1, max_num_workers, 8) {}
+
+    /**
+     * Pretend the last change happened when the farm started, so that the reaction time doesn't prevent the next
+     * decision.
+     */
+    void forgetLastChange() {
+        last_change = analytics->farm_start_time;
+    }
+
+protected:
+    void pauseWorkers(size_t, size_t) override {}
+    void unpauseWorkers(size_t, size_t) override {}
+    long getArrivalTime() override { return 5; }
+    long getWorkerServiceTime() override { return 8; }
+    size_t getNumArrivals() override { return 0; }
+    size_t getNumCompleted() override { return 0; }
+};
+
+/**
+ * Cost of notifying a new service time to the autonomic controller. The argument is the maximum number of workers.
+ */
+static void BM_AutonomicOnNewServiceTime(benchmark::State& state) {
+    farm_analytics analytics;
+    // the farm started long ago and every decision sets the last change to now: it is forgotten before each
+    // notification, a single store, so that the reaction time never prevents a decision
+    analytics.farm_start_time = std::chrono::system_clock::now() - std::chrono::hours(1);
+    NoopAutonomic autonomic(&analytics, (size_t) state.range(0));
+    size_t item = 0;
+    for (auto _ : state) {
+        autonomic.forgetLastChange();
+        autonomic.onNewServiceTime((item++ % 7) + 4.0);
+        if (analytics.num_workers.size() >= ITEMS_PER_ITERATION) {
+            state.PauseTiming();
+            analytics.num_workers.clear();
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AutonomicOnNewServiceTime)->Arg(4)->Arg(32);
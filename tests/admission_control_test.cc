@@ -0,0 +1,89 @@
+#include <thread>
+#include <vector>
+#include "AutonomicFarm.hpp"
+#include <gtest/gtest.h>
+
+TEST(AdmissionControlTest, givenDropNewest_whenQueueIsFull_thenArrivingElementsAreDroppedWithTheirTags) {
+    Stream<int> stream;
+    std::vector<uint32_t> dropped;
+    stream.enableTags();
+    stream.enableAdmission(AdmissionControl(shed_policy::drop_newest, 3), [&dropped](int &, uint32_t tag) { dropped.push_back(tag); });
+    for (int i = 0; i < 5; ++i) stream.add(i, i + 1);
+    stream.eos();
+
+    for (int i = 0; i < 3; ++i) EXPECT_EQ(stream.next().value(), i);
+    EXPECT_FALSE(stream.next().has_value());
+    EXPECT_EQ(dropped, (std::vector<uint32_t>{ 4, 5 }));
+    auto stats = stream.shedStats();
+    EXPECT_EQ(stats.admitted, 3);
+    EXPECT_EQ(stats.dropped_newest, 2);
+}
+
+TEST(AdmissionControlTest, givenDropOldest_whenQueueIsFull_thenNewestElementsAreKept) {
+    Stream<int> stream;
+    stream.enableAdmission(AdmissionControl(shed_policy::drop_oldest, 3), {});
+    for (int i = 0; i < 5; ++i) stream.add(i);
+    stream.eos();
+
+    for (int i = 2; i < 5; ++i) EXPECT_EQ(stream.next().value(), i);
+    EXPECT_FALSE(stream.next().has_value());
+    EXPECT_EQ(stream.shedStats().dropped_oldest, 2);
+}
+
+TEST(AdmissionControlTest, givenDelayAboveTarget_whenTasksArrive_thenTheyAreDroppedWithTheExcessProbability) {
+    AdmissionControl admission(shed_policy::early_drop);
+    admission.setDelayTarget(5, 100);
+    auto now = std::chrono::steady_clock::now();
+    admission.onDeparture(now - std::chrono::milliseconds(20), now);
+    // the delay is above the target, but not for an interval yet
+    EXPECT_FALSE(admission.onArrival(10, now + std::chrono::milliseconds(50)).has_value());
+
+    size_t dropped = 0;
+    for (int i = 0; i < 1000; ++i) {
+        if (admission.onArrival(10, now + std::chrono::milliseconds(200)) == shed_reason::early) dropped++;
+    }
+    // 1 - 5 / 20 of the tasks
+    EXPECT_NEAR((double) dropped / 1000, 0.75, 0.05);
+    // an empty queue has no delay
+    EXPECT_FALSE(admission.onArrival(0, now + std::chrono::milliseconds(200)).has_value());
+}
+
+TEST(AdmissionControlTest, givenTimeToLive_whenSubmittedTasksExpire_thenTheirFuturesFail) {
+    AutonomicFarm<int, int> farm(1, 1, 1, 0, [](int &item) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return item;
+    }, [](int &) {});
+    AdmissionControl admission;
+    admission.setTimeToLive(5);
+    farm.setAdmission(admission);
+    farm.setSubmitCapacity(8);
+    farm.run();
+
+    std::vector<completion_future<int>> futures;
+    for (int i = 0; i < 4; ++i) futures.push_back(farm.submit(i));
+    // the first task is taken at once, the others wait for it longer than they may
+    EXPECT_EQ(futures[0].get(), 0);
+    for (int i = 1; i < 4; ++i) EXPECT_THROW(futures[i].get(), std::runtime_error);
+    farm.notify_eos();
+    auto analytics = farm.wait_and_analytics();
+    EXPECT_EQ(analytics.shedding.expired, 3);
+}
+
+TEST(AdmissionControlTest, givenShedFunctionUsingTheStream_whenElementsDropped_thenCalledWithoutTheLock) {
+    Stream<int> stream;
+    std::vector<size_t> admitted_when_dropped;
+    AdmissionControl admission(shed_policy::drop_newest, 2);
+    admission.setTimeToLive(5);
+    // the statistics lock the stream, which would deadlock under the lock of the stream
+    stream.enableAdmission(admission, [&](int &, uint32_t) { admitted_when_dropped.push_back(stream.shedStats().admitted); });
+    for (int i = 0; i < 3; ++i) stream.add(i);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int fresh = 3;
+    stream.add(fresh);
+    stream.eos();
+
+    // the elements left expired while waiting, and the fresh one was dropped since the queue was full
+    EXPECT_FALSE(stream.next().has_value());
+    EXPECT_EQ(admitted_when_dropped.size(), 4);
+    EXPECT_EQ(stream.shedStats().expired, 2);
+}
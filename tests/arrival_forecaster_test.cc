@@ -0,0 +1,36 @@
+#include "ArrivalForecaster.hpp"
+#include <gtest/gtest.h>
+#include <cmath>
+
+TEST(ArrivalForecasterTest, givenConstantRate_whenObserve_thenForecastIsTheRate) {
+    ArrivalForecaster forecaster;
+    EXPECT_LT(forecaster.observe(0.2, 0), 0);
+    EXPECT_FALSE(forecaster.isReady());
+    for (int i = 0; i < 10; ++i) EXPECT_DOUBLE_EQ(forecaster.observe(0.2, 50), 0.2);
+    EXPECT_TRUE(forecaster.isReady());
+    EXPECT_DOUBLE_EQ(forecaster.getTrend(), 0);
+    EXPECT_DOUBLE_EQ(forecaster.forecast(1000), 0.2);
+}
+
+TEST(ArrivalForecasterTest, givenLinearRamp_whenObserve_thenTrendIsLearnedAndForecastLeadsTheRate) {
+    ArrivalForecaster forecaster;
+    // the rate grows by 0.001 tasks per millisecond every millisecond, observed every 50 ms
+    auto rate = [](double time) { return 0.1 + 0.001 * time; };
+    double first_error = -1, last_error = -1;
+    for (int i = 0; i < 60; ++i) {
+        double predicted = forecaster.observe(rate(50.0 * i), i == 0 ? 0:50);
+        if (i == 2) first_error = std::abs(predicted - rate(50.0 * i));
+        if (i > 2) last_error = std::abs(predicted - rate(50.0 * i));
+    }
+    EXPECT_NEAR(forecaster.getTrend(), 0.001, 1e-5);
+    EXPECT_NEAR(forecaster.forecast(200), rate(50.0 * 59 + 200), 1e-3);
+    EXPECT_LT(last_error, first_error / 100);
+}
+
+TEST(ArrivalForecasterTest, givenFallingRate_whenForecastFarAhead_thenNeverNegative) {
+    ArrivalForecaster forecaster;
+    for (int i = 0; i < 20; ++i) forecaster.observe(1.0 - 0.0002 * 50.0 * i, i == 0 ? 0:50);
+    EXPECT_LT(forecaster.getTrend(), 0);
+    EXPECT_GT(forecaster.forecast(0), 0);
+    EXPECT_DOUBLE_EQ(forecaster.forecast(100000), 0);
+}
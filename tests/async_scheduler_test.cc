@@ -0,0 +1,80 @@
+#include "AsyncScheduler.hpp"
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+static async_task<int> doubleAfter(std::chrono::milliseconds delay, int value) {
+    co_await sleep_for(delay);
+    co_return 2 * value;
+}
+
+static async_task<> store(int value, int* into) {
+    *into = co_await doubleAfter(std::chrono::milliseconds(50), value);
+}
+
+TEST(AsyncSchedulerTest, givenSleepingTasks_whenPoll_thenTheyWaitTogether) {
+    AsyncScheduler scheduler;
+    int results[8] = {};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 8; ++i) scheduler.spawn(store(i, &results[i]));
+    EXPECT_EQ(scheduler.inFlight(), 8);
+    size_t completed = 0;
+    while (scheduler.inFlight() > 0) completed += scheduler.poll(std::chrono::microseconds(-1));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(completed, 8);
+    for (int i = 0; i < 8; ++i) EXPECT_EQ(results[i], 2 * i);
+    // the tasks waited at once, not one after the other
+    EXPECT_LT(elapsed, std::chrono::milliseconds(8 * 50));
+    EXPECT_GE(scheduler.blockedTime(), 8 * 40 * 1000000L);
+}
+
+TEST(AsyncSchedulerTest, givenPipe_whenWrittenLater_thenReaderResumed) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    auto reader = [](int read_fd, int write_fd) -> async_task<char> {
+        // the writer runs while the reader waits for the pipe
+        AsyncScheduler::current()->spawn([](int fd) -> async_task<> {
+            co_await sleep_for(std::chrono::milliseconds(10));
+            EXPECT_EQ(write(fd, "x", 1), 1);
+        }(write_fd));
+        auto events = co_await readable(read_fd);
+        EXPECT_TRUE(events & EPOLLIN);
+        char byte = 0;
+        EXPECT_EQ(read(read_fd, &byte, 1), 1);
+        co_return byte;
+    };
+    EXPECT_EQ(AsyncScheduler::run(reader(fds[0], fds[1])), 'x');
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(AsyncSchedulerTest, givenFailingTask_whenPoll_thenItsFailureIsCounted) {
+    AsyncScheduler scheduler;
+    scheduler.spawn([]() -> async_task<> {
+        co_await sleep_for(std::chrono::milliseconds(1));
+        throw std::runtime_error("failing task");
+    }());
+    while (scheduler.inFlight() > 0) scheduler.poll(std::chrono::microseconds(-1));
+
+    EXPECT_EQ(scheduler.failed(), 1);
+}
+
+TEST(AsyncSchedulerTest, givenSuspendedTasks_whenSchedulerDestroyed_thenTheirFramesAreDestroyed) {
+    int destroyed = 0;
+    struct on_destroy {
+        int* count;
+        ~on_destroy() { (*count)++; }
+    };
+    auto waiting = [](int* count) -> async_task<> {
+        on_destroy guard{ count };
+        co_await doubleAfter(std::chrono::hours(1), 0);
+    };
+    {
+        AsyncScheduler scheduler;
+        for (int i = 0; i < 3; ++i) scheduler.spawn(waiting(&destroyed));
+        scheduler.poll(std::chrono::microseconds(0));
+        EXPECT_EQ(scheduler.inFlight(), 3);
+        EXPECT_EQ(destroyed, 0);
+    }
+    EXPECT_EQ(destroyed, 3);
+}
@@ -0,0 +1,199 @@
+#include "Autonomic.hpp"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+/**
+ * Controller of a farm that doesn't exist, with the measures set by the test and a virtual clock.
+ */
+class FakeAutonomic : public Autonomic {
+public:
+    long arrival_time = 0;
+    long worker_service_time = 16;
+    size_t arrivals = 0;
+    size_t completed = 0;
+    size_t backlog = 0;
+    std::chrono::system_clock::time_point now;
+
+    FakeAutonomic(farm_analytics *analytics, size_t num_workers, size_t max_num_workers, double target_service_time)
+    : Autonomic(analytics, num_workers, 1, max_num_workers, target_service_time), now(analytics->farm_start_time) {}
+
+    size_t numWorkers() const {
+        return num_workers;
+    }
+
+    int backlogWorkers() {
+        return backlogNumWorkers();
+    }
+
+    /**
+     * Notify the same service time many times, moving the clock forward by the given period each time.
+     */
+    void notify(double service_time, size_t times, long period_ms) {
+        for (size_t i = 0; i < times; ++i) {
+            now += std::chrono::milliseconds(period_ms);
+            onNewServiceTime(service_time);
+        }
+    }
+
+protected:
+    void pauseWorkers(size_t, size_t) override {}
+    void unpauseWorkers(size_t, size_t) override {}
+    long getArrivalTime() override { return arrival_time; }
+    long getWorkerServiceTime() override { return worker_service_time; }
+    size_t getNumArrivals() override { return arrivals; }
+    size_t getNumCompleted() override { return completed; }
+    size_t getBacklog() override { return backlog; }
+    std::chrono::system_clock::time_point currentTime() override { return now; }
+};
+
+TEST(AutonomicTest, givenBacklog_whenBacklogNumWorkers_thenKeepUpWithArrivalsAndDrainTheBacklog) {
+    farm_analytics analytics;
+    FakeAutonomic autonomic(&analytics, 2, 64, 4);
+    EXPECT_EQ(autonomic.backlogWorkers(), -1);
+    // 0.25 tasks per millisecond arriving, plus 2000 tasks to drain in a second, each one taking 16 ms
+    autonomic.arrival_time = 4;
+    autonomic.backlog = 2000;
+    EXPECT_EQ(autonomic.backlogWorkers(), 36);
+    autonomic.backlog = 1000000;
+    EXPECT_EQ(autonomic.backlogWorkers(), 64);
+}
+
+TEST(AutonomicTest, givenBacklog_whenServiceTimeMeetsTarget_thenScaleUpToDrainIt) {
+    farm_analytics analytics;
+    FakeAutonomic autonomic(&analytics, 2, 64, 4);
+    autonomic.arrival_time = 4;
+    autonomic.backlog = 2000;
+    autonomic.notify(4, 8, 50);
+    EXPECT_EQ(autonomic.numWorkers(), 36);
+}
+
+TEST(AutonomicTest, givenBacklog_whenServiceTimeBelowTarget_thenNeverScaleBelowTheBacklogWorkers) {
+    farm_analytics analytics, backlogged_analytics;
+    FakeAutonomic autonomic(&analytics, 8, 64, 4), backlogged(&backlogged_analytics, 8, 64, 4);
+    // draining 500 tasks in a second takes 8 workers of 16 ms
+    backlogged.backlog = 500;
+    ASSERT_EQ(backlogged.backlogWorkers(), 8);
+
+    // a service time far below the target would remove workers
+    autonomic.notify(0.5, 8, 50);
+    backlogged.notify(0.5, 8, 50);
+    EXPECT_LT(autonomic.numWorkers(), 8);
+    EXPECT_EQ(backlogged.numWorkers(), 8);
+    EXPECT_TRUE(backlogged_analytics.num_workers.empty());
+}
+
+TEST(AutonomicTest, givenCalibration_whenWorkersCompleteTheTasks_thenNumberOfWorkersSetInOneStep) {
+    farm_analytics analytics;
+    FakeAutonomic autonomic(&analytics, 1, 16, 0);
+    autonomic.setCalibration(10);
+    autonomic.arrivals = 20;
+    autonomic.completed = 4;
+    // more notifications than tasks to measure, but the workers completed only some of them
+    autonomic.notify(16, 11, 10);
+    EXPECT_EQ(autonomic.numWorkers(), 1);
+    EXPECT_EQ(analytics.controller.calibration.end_time, -1);
+
+    // a task every 4 ms, each one taking 16 ms
+    autonomic.arrivals = 30;
+    autonomic.completed = 10;
+    autonomic.notify(16, 1, 10);
+    EXPECT_EQ(autonomic.numWorkers(), 4);
+    EXPECT_EQ(analytics.controller.calibration.end_time, 120);
+    EXPECT_DOUBLE_EQ(analytics.controller.calibration.worker_service_time, 16);
+    EXPECT_DOUBLE_EQ(analytics.controller.calibration.arrival_time, 4);
+    EXPECT_EQ(analytics.controller.calibration.saved_time, 70);
+    EXPECT_EQ(analytics.num_workers.size(), 1);
+}
+
+TEST(AutonomicTest, givenSlowCalibration_whenRegularLoopCouldDecideFirst_thenNoTimeSaved) {
+    farm_analytics analytics;
+    FakeAutonomic autonomic(&analytics, 1, 16, 0);
+    autonomic.setCalibration(10);
+    autonomic.arrivals = 20;
+    autonomic.completed = 4;
+    // the regular loop could decide at 210 ms, long before the workers complete the tasks to measure
+    autonomic.notify(16, 11, 30);
+    autonomic.arrivals = 90;
+    autonomic.completed = 10;
+    autonomic.notify(16, 1, 30);
+    EXPECT_EQ(analytics.controller.calibration.end_time, 360);
+    EXPECT_EQ(analytics.controller.calibration.saved_time, 0);
+}
+
+static std::string read_file(const std::string &path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+TEST(AutonomicTest, givenSavedState_whenLoaded_thenSameStateAndFirstDecisionIsTheStableNumberOfWorkers) {
+    auto path = testing::TempDir() + "autonomic_state.txt", copy_path = testing::TempDir() + "autonomic_state_copy.txt";
+    farm_analytics analytics, warm_analytics, other_target_analytics;
+    FakeAutonomic autonomic(&analytics, 6, 16, 4);
+    autonomic.arrival_time = 4;
+    // the target is met with 6 workers
+    autonomic.notify(4, 8, 50);
+    autonomic.saveState(path);
+
+    FakeAutonomic warm(&warm_analytics, 2, 16, 4);
+    ASSERT_TRUE(warm.loadState(path));
+    warm.saveState(copy_path);
+    EXPECT_EQ(read_file(copy_path), read_file(path));
+    EXPECT_NE(read_file(path).find("stable "), std::string::npos);
+    warm.arrival_time = 4;
+    warm.arrivals = 2;
+    warm.notify(10, 1, 50);
+    EXPECT_EQ(warm.numWorkers(), 6);
+
+    // with another target the stable numbers of workers don't apply
+    FakeAutonomic other_target(&other_target_analytics, 2, 16, 8);
+    ASSERT_TRUE(other_target.loadState(path));
+    other_target.arrival_time = 4;
+    other_target.arrivals = 2;
+    other_target.notify(10, 1, 50);
+    EXPECT_EQ(other_target.numWorkers(), 2);
+    std::remove(path.c_str());
+    std::remove(copy_path.c_str());
+}
+
+TEST(AutonomicTest, givenMissingStateFile_whenSetStateFile_thenLearnedFromScratchAndSavedAtTheEnd) {
+    auto path = testing::TempDir() + "autonomic_missing_state.txt";
+    std::remove(path.c_str());
+    farm_analytics analytics;
+    {
+        FakeAutonomic autonomic(&analytics, 2, 16, 4);
+        EXPECT_FALSE(autonomic.loadState(path));
+        autonomic.setStateFile(path);
+        autonomic.arrivals = 2;
+        autonomic.notify(10, 1, 50);
+        EXPECT_EQ(autonomic.numWorkers(), 2);
+    }
+    EXPECT_EQ(read_file(path).find("autonomic-state 1\ntarget 4\n"), 0);
+    std::remove(path.c_str());
+}
+
+TEST(AutonomicTest, givenStableNumberBeyondTheBounds_whenWarmStartClampsToTheCurrent_thenNoReconfiguration) {
+    auto path = testing::TempDir() + "autonomic_clamped_state.txt";
+    farm_analytics analytics, warm_analytics;
+    {
+        FakeAutonomic autonomic(&analytics, 12, 16, 4);
+        autonomic.arrival_time = 4;
+        // the target is met with 12 workers
+        autonomic.notify(4, 8, 50);
+        autonomic.saveState(path);
+    }
+
+    // at most 8 workers now, which the warm started controller already runs
+    FakeAutonomic warm(&warm_analytics, 8, 8, 4);
+    ASSERT_TRUE(warm.loadState(path));
+    warm.arrival_time = 4;
+    warm.arrivals = 2;
+    warm.notify(10, 1, 50);
+    EXPECT_EQ(warm.numWorkers(), 8);
+    EXPECT_TRUE(warm_analytics.num_workers.empty());
+    EXPECT_EQ(warm_analytics.controller.reconfigurations, 0);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,72 @@
+#include <fstream>
+#include <sstream>
+#include "BufferedFileSink.hpp"
+#include <gtest/gtest.h>
+
+/**
+ * Sink of numbers into a temporary file, with buffers much smaller than the results written.
+ */
+class BufferedFileSinkTest : public ::testing::TestWithParam<bool> {
+protected:
+    // a file per test, since ctest may run them at once
+    std::string path = ::testing::TempDir() + "buffered_sink_" + std::to_string(std::hash<std::string>()(
+            ::testing::UnitTest::GetInstance()->current_test_info()->name())) + ".txt";
+
+    void TearDown() override {
+        std::remove(path.c_str());
+    }
+
+    std::string content() {
+        std::ifstream file(path);
+        std::stringstream read;
+        read << file.rdbuf();
+        return read.str();
+    }
+};
+
+TEST_P(BufferedFileSinkTest, givenManyResults_whenClosed_thenFileHoldsEveryResultInOrder) {
+    BufferedFileSink<size_t> sink(path, 4096, GetParam());
+    auto send_out = sink.sendOut();
+    std::string expected;
+    for (size_t i = 0; i < 20000; ++i) {
+        send_out(i);
+        expected += std::to_string(i) + "\n";
+    }
+    sink.close();
+
+    EXPECT_EQ(content(), expected);
+    EXPECT_EQ(sink.stats().bytes, expected.size());
+    EXPECT_GT(sink.stats().writes, 1);
+}
+
+TEST_P(BufferedFileSinkTest, givenResultsLargerThanTheBuffers_whenClosed_thenFileHoldsThemWhole) {
+    BufferedFileSink<std::string> sink(path, 4096, GetParam(), [](const std::string &value, char* out, size_t room) {
+        if (value.size() <= room) std::memcpy(out, value.data(), value.size());
+        return value.size();
+    });
+    std::string expected;
+    for (size_t i = 0; i < 10; ++i) {
+        std::string value = i % 2 == 0 ? std::string(20000 + i, 'a' + (char) i):std::to_string(i);
+        sink.write(value);
+        expected += value;
+    }
+    sink.close();
+
+    EXPECT_EQ(content(), expected);
+}
+
+INSTANTIATE_TEST_SUITE_P(DirectAndBuffered, BufferedFileSinkTest, ::testing::Bool());
+
+TEST_F(BufferedFileSinkTest, givenSerializer_whenWriting_thenResultsAreSerializedWithIt) {
+    BufferedFileSink<std::string> sink(path, 4096, false, [](const std::string &value, char* out, size_t room) {
+        if (value.size() + 1 <= room) {
+            std::memcpy(out, value.data(), value.size());
+            out[value.size()] = ';';
+        }
+        return value.size() + 1;
+    });
+    for (auto &word: { "a", "bb", "ccc" }) sink.write(word);
+    sink.close();
+
+    EXPECT_EQ(content(), "a;bb;ccc;");
+}
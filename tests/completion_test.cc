@@ -0,0 +1,73 @@
+#include <future>
+#include <vector>
+#include <numeric>
+#include "Farm.hpp"
+#include <gtest/gtest.h>
+
+/**
+ * Farm doubling the items, whose workers block on the item 0 until released.
+ */
+class CompletionTest : public ::testing::Test {
+protected:
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    Farm<int, int> farm = Farm<int, int>(2, [this](int &item) {
+        if (item == 0) released.wait();
+        return item * 2;
+    }, [](int &) {});
+
+    void SetUp() override {
+        farm.setSubmitCapacity(16);
+        farm.run();
+    }
+
+    void TearDown() override {
+        if (!unblocked) release.set_value();
+        farm.notify_eos();
+        farm.wait();
+    }
+
+    void unblock() {
+        release.set_value();
+        unblocked = true;
+    }
+
+private:
+    bool unblocked = false;
+};
+
+TEST_F(CompletionTest, givenBatchSubmit_whenGet_thenEachResultIsItsItemComputed) {
+    std::vector<int> items(10);
+    std::iota(items.begin(), items.end(), 1);
+    std::vector<completion_future<int>> futures;
+    farm.submit(items.begin(), items.end(), std::back_inserter(futures));
+
+    ASSERT_EQ(futures.size(), 10);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(futures[i].get(), (i + 1) * 2);
+        EXPECT_FALSE(futures[i].valid());
+    }
+}
+
+TEST_F(CompletionTest, givenBlockedItem_whenWaitAny_thenTheOtherItemIsReady) {
+    int blocked = 0, quick = 21;
+    std::vector<completion_future<int>> futures;
+    futures.push_back(farm.submit(blocked));
+    futures.push_back(farm.submit(quick));
+
+    EXPECT_EQ(completion_future<int>::waitAny(futures), 1);
+    EXPECT_EQ(futures[1].get(), 42);
+    EXPECT_FALSE(futures[0].ready());
+    unblock();
+    EXPECT_EQ(futures[0].get(), 0);
+}
+
+TEST_F(CompletionTest, givenDroppedFutures_whenSubmittingMoreThanCapacity_thenSlotsAreReused) {
+    for (int i = 1; i <= 100; ++i) {
+        auto future = farm.submit(i);
+        if (i % 2 == 0) {
+            EXPECT_EQ(future.get(), i * 2);
+        }
+    }
+}
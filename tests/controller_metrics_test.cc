@@ -0,0 +1,48 @@
+#include "ControllerMetrics.hpp"
+#include <gtest/gtest.h>
+
+static std::vector<long> arrivals(const std::vector<std::pair<size_t, long>> &loads) {
+    std::vector<long> times;
+    long time = 0;
+    for (auto [count, arrival_time]: loads) {
+        for (size_t i = 0; i < count; ++i) {
+            times.push_back(time);
+            time += arrival_time;
+        }
+    }
+    return times;
+}
+
+TEST(ControllerMetricsTest, givenStepsOfArrivalTime_whenFindLoadChanges_thenEveryStepIsFound) {
+    auto changes = controller_metrics::findLoadChanges(arrivals({{500, 8}, {500, 4}, {500, 8}}));
+    ASSERT_EQ(changes.size(), 3);
+    EXPECT_EQ(changes[0].time, 0);
+    EXPECT_EQ(changes[1].time, 500 * 8);
+    EXPECT_EQ(changes[2].time, 500 * 8 + 500 * 4);
+    EXPECT_DOUBLE_EQ(changes[1].arrival_time, 4);
+}
+
+TEST(ControllerMetricsTest, givenUpAndDownReconfigurations_whenOnReconfiguration_thenOscillationsAreCounted) {
+    controller_metrics metrics;
+    metrics.onReconfiguration(2, 4, 1000);
+    metrics.onReconfiguration(4, 6, 1000);
+    metrics.onReconfiguration(6, 3, 1000);
+    metrics.onReconfiguration(3, 5, 1000);
+    EXPECT_EQ(metrics.reconfigurations, 4);
+    EXPECT_EQ(metrics.oscillations, 2);
+    EXPECT_DOUBLE_EQ(metrics.worker_seconds, 2 + 4 + 6 + 3);
+}
+
+TEST(ControllerMetricsTest, givenServiceTimeReachingTarget_whenComplete_thenSettlingTimeAndOvershoot) {
+    controller_metrics metrics;
+    std::vector<std::pair<double, long>> service_time = {{8, 0}, {6, 100}, {2, 200}, {4, 300}, {4.5, 400}, {4, 500}};
+    std::vector<std::pair<size_t, long>> num_workers = {{2, 0}, {4, 250}};
+    metrics.onReconfiguration(2, 4, 250);
+    metrics.complete(service_time, num_workers, arrivals({{200, 4}}), 4, 600);
+    ASSERT_EQ(metrics.load_changes.size(), 1);
+    EXPECT_EQ(metrics.load_changes[0].settling_time, 300);
+    EXPECT_DOUBLE_EQ(metrics.overshoot, 1);
+    EXPECT_DOUBLE_EQ(metrics.undershoot, 3);
+    EXPECT_EQ(metrics.time_outside_band, 300);
+    EXPECT_DOUBLE_EQ(metrics.worker_seconds, 2 * 0.25 + 4 * 0.35);
+}
@@ -0,0 +1,90 @@
+#include "EventTracer.hpp"
+#include <gtest/gtest.h>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <csignal>
+#include <cstdio>
+
+static size_t count(const std::string &text, const std::string &pattern) {
+    size_t found = 0;
+    for (auto at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) found++;
+    return found;
+}
+
+TEST(EventTracerTest, givenFullRings_whenDump_thenNewestEventsOfEachThread) {
+    EventTracer::record(trace_event::eos); // disabled, not recorded
+    EventTracer::enable(4);
+    std::thread worker([]() {
+        EventTracer::nameThread("traced worker");
+        for (int32_t task = 0; task < 3; ++task) {
+            EventTracer::record(trace_event::task_start, task);
+            EventTracer::record(trace_event::task_end);
+        }
+    });
+    worker.join();
+    EventTracer::record(trace_event::decision, 7);
+    EventTracer::disable();
+    EventTracer::record(trace_event::eos);
+
+    auto path = testing::TempDir() + "event_tracer_test.json";
+    ASSERT_TRUE(EventTracer::dump(path));
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    auto trace = content.str();
+
+    EXPECT_EQ(trace.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0);
+    EXPECT_NE(trace.find("\"name\":\"traced worker\""), std::string::npos);
+    // the ring of the worker keeps its last two tasks
+    EXPECT_EQ(count(trace, "\"ph\":\"B\""), 2);
+    EXPECT_EQ(count(trace, "\"ph\":\"E\""), 2);
+    EXPECT_EQ(count(trace, "\"computed\":0"), 0);
+    EXPECT_EQ(count(trace, "\"computed\":2"), 1);
+    EXPECT_EQ(count(trace, "\"workers\":7"), 1);
+    EXPECT_EQ(count(trace, "eos"), 0);
+}
+
+TEST(EventTracerTest, givenUnmatchedSlicesAndQuotedName_whenDump_thenSlicesLeftOutAndNameEscaped) {
+    EventTracer::enable(8);
+    std::thread worker([]() {
+        EventTracer::nameThread("worker \"one\"\n");
+        // the pause before the first one was overwritten, the last one has not ended yet
+        EventTracer::record(trace_event::unpause);
+        EventTracer::record(trace_event::pause);
+        EventTracer::record(trace_event::unpause);
+        EventTracer::record(trace_event::pause);
+    });
+    worker.join();
+
+    auto path = testing::TempDir() + "event_tracer_unmatched_test.json";
+    ASSERT_TRUE(EventTracer::dump(path));
+    // the dump stops the recording
+    EXPECT_FALSE(EventTracer::enabled());
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    auto trace = content.str();
+
+    EXPECT_NE(trace.find("\"name\":\"worker \\\"one\\\"\\n\""), std::string::npos);
+    EXPECT_EQ(count(trace, "\"ph\":\"B\",\"name\":\"paused\""), 1);
+    EXPECT_EQ(count(trace, "\"ph\":\"E\",\"name\":\"paused\""), 1);
+    std::remove(path.c_str());
+}
+
+TEST(EventTracerTest, givenDumpOnSignal_whenSigterm_thenEventsDumpedAndProcessTerminated) {
+    auto path = testing::TempDir() + "event_tracer_signal_test.json";
+    std::remove(path.c_str());
+    EXPECT_EXIT({
+        EventTracer::enable(4);
+        EventTracer::record(trace_event::decision, 5);
+        EventTracer::dumpOnSignal(path);
+        std::raise(SIGTERM);
+        // the dump happens on the thread of the tracer
+        std::this_thread::sleep_for(std::chrono::seconds(10));
+    }, testing::ExitedWithCode(128 + SIGTERM), "");
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    EXPECT_EQ(count(content.str(), "\"workers\":5"), 1);
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "AutonomicFarm.hpp"
+#include <gtest/gtest.h>
+
+TEST(FairQueueTest, givenWeights_whenPop_thenTenantsAreServedInProportion) {
+    FairQueue<int> queue;
+    queue.setWeight(0, 2);
+    for (int i = 0; i < 6; ++i) {
+        int first = 0, second = 1;
+        queue.push(0, first);
+        queue.push(1, second);
+    }
+
+    std::vector<uint32_t> tenants;
+    uint32_t tenant;
+    while (queue.pop(tenant)) tenants.push_back(tenant);
+    EXPECT_EQ(tenants, (std::vector<uint32_t>{ 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 1, 1 }));
+}
+
+TEST(FairQueueTest, givenCappedTenant_whenItHasTooManyInFlight_thenItsElementsWait) {
+    FairQueue<int> queue;
+    queue.setCap(0, 1);
+    for (int i = 0; i < 3; ++i) queue.push(0, i);
+    int other = 10;
+    queue.push(1, other);
+
+    uint32_t tenant;
+    EXPECT_EQ(queue.pop(tenant).value(), 0);
+    EXPECT_EQ(queue.pop(tenant).value(), 10);
+    EXPECT_EQ(tenant, 1);
+    EXPECT_FALSE(queue.pop(tenant).has_value());
+    queue.done(1, 5);
+    // only the capped tenant has elements waiting or in flight, so one worker is enough
+    EXPECT_EQ(queue.usefulWorkers(), 1);
+
+    queue.done(0, 5);
+    EXPECT_EQ(queue.pop(tenant).value(), 1);
+    EXPECT_EQ(queue.stats()[0].max_in_flight, 1);
+}
+
+TEST(FairQueueTest, givenTenantsAndPriorities_whenNext_thenEachTenantIsOrderedByDeadline) {
+    Stream<int> stream;
+    stream.enablePriorities(1000);
+    stream.enableTenants([](const int &) { return 0u; });
+    int classes[] = { 1, 1, 0 };
+    for (int i = 0; i < 3; ++i) {
+        int value = i == 2 ? 100:i + 1;
+        stream.add(value, 0, task_priority{ (uint32_t) classes[i] });
+    }
+    stream.eos();
+
+    uint32_t tenant = 0;
+    std::chrono::steady_clock::time_point added;
+    for (int expected: { 100, 1, 2 }) {
+        EXPECT_EQ(stream.next(&added, nullptr, nullptr, &tenant).value(), expected);
+        stream.done(tenant, 1);
+    }
+    EXPECT_FALSE(stream.next().has_value());
+}
+
+TEST(FairQueueTest, givenWeightedTenants_whenBothAreBacklogged_thenTheWorkerIsSharedByWeight) {
+    std::vector<int> completed;
+    AutonomicFarm<int, int> farm(1, 1, 1, 0, [&completed](int &item) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        completed.push_back(item % 2);
+        return item;
+    }, [](int &) {});
+    farm.setTenants([](const int &item) { return (uint32_t) (item % 2); }, { 2, 1 });
+    farm.run();
+
+    for (int i = 0; i < 60; ++i) farm.send(i);
+    farm.notify_eos();
+    auto analytics = farm.wait_and_analytics();
+
+    // while both tenants have tasks waiting, the first one gets two thirds of the worker
+    auto first = std::count(completed.begin(), completed.begin() + 30, 0);
+    EXPECT_NEAR(first, 20, 2);
+    ASSERT_EQ(analytics.tenants.size(), 2);
+    EXPECT_EQ(analytics.tenants[0].tasks, 30);
+    EXPECT_EQ(analytics.tenants[1].tasks, 30);
+    EXPECT_GT(analytics.tenants[0].busy_ms, 30 * 2);
+}
+
+TEST(FairQueueTest, givenCappedTenant_whenItFloodsTheFarm_thenItNeverUsesMoreWorkersThanItsCap) {
+    std::atomic<int> running[2] = { 0, 0 };
+    std::atomic<int> most_running[2] = { 0, 0 };
+    AutonomicFarm<int, int> farm(4, 4, 4, 0, [&running, &most_running](int &item) {
+        int tenant = item % 2;
+        int now = ++running[tenant];
+        int most = most_running[tenant];
+        while (now > most && !most_running[tenant].compare_exchange_weak(most, now)) {}
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        --running[tenant];
+        return item;
+    }, [](int &) {});
+    farm.setTenants([](const int &item) { return (uint32_t) (item % 2); }, {}, { 1 });
+    farm.run();
+
+    for (int i = 0; i < 40; ++i) farm.send(i);
+    farm.notify_eos();
+    auto analytics = farm.wait_and_analytics();
+
+    EXPECT_EQ(most_running[0], 1);
+    EXPECT_GT(most_running[1], 1);
+    EXPECT_EQ(analytics.tenants[0].max_in_flight, 1);
+    EXPECT_EQ(analytics.tenants[0].tasks, 20);
+}
+
+TEST(FairQueueTest, givenCappedTenant_whenAsyncWorkersFloodTheFarm_thenItNeverHasMoreItemsInFlightThanItsCap) {
+    std::atomic<int> running[2] = { 0, 0 };
+    std::atomic<int> most_running[2] = { 0, 0 };
+    AutonomicFarm<int, int> farm(2, 2, 2, 0, [](int &item) { return item; }, [](int &) {});
+    farm.setAsyncWorker([&running, &most_running](int item) -> async_task<int> {
+        int tenant = item % 2;
+        int now = ++running[tenant];
+        int most = most_running[tenant];
+        while (now > most && !most_running[tenant].compare_exchange_weak(most, now)) {}
+        co_await sleep_for(std::chrono::milliseconds(5));
+        --running[tenant];
+        co_return item;
+    }, 4);
+    farm.setTenants([](const int &item) { return (uint32_t) (item % 2); }, {}, { 1 });
+    farm.run();
+
+    for (int i = 0; i < 40; ++i) farm.send(i);
+    farm.notify_eos();
+    auto analytics = farm.wait_and_analytics();
+
+    EXPECT_EQ(most_running[0], 1);
+    EXPECT_GT(most_running[1], 1);
+    EXPECT_EQ(analytics.tenants[0].max_in_flight, 1);
+}
@@ -0,0 +1,67 @@
+#include "AutonomicFarm.hpp"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+static void busy_wait(std::chrono::microseconds duration) {
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end);
+}
+
+/**
+ * Send the items one by one, a millisecond apart, so that the tiny tasks can be computed inline.
+ */
+template<typename FarmType>
+static void send_slowly(FarmType &farm, size_t items) {
+    for (size_t i = 0; i < items; ++i) {
+        farm.send(i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    farm.notify_eos();
+}
+
+class InlineExecutionTest : public ::testing::TestWithParam<bool> {};
+
+TEST_P(InlineExecutionTest, givenTasksGrowingAndShrinking_whenSwitchingMode_thenOrderIsKeptAndSwitchesAreReported) {
+    std::vector<size_t> results;
+    // a single worker keeps the order of the threaded items, so any swap comes from a switch
+    MonitoredFarm<size_t, size_t> farm(1, [](size_t &item) {
+        // the tasks in the middle are too long to be computed inline
+        if (item >= 100 && item < 120) busy_wait(std::chrono::microseconds(1000));
+        return item;
+    }, [&results](size_t &result) { results.push_back(result); });
+    farm.setInlineExecution(true, GetParam());
+    farm.run();
+    send_slowly(farm, 300);
+    auto analytics = farm.wait_and_analytics();
+
+    ASSERT_EQ(results.size(), 300);
+    for (size_t i = 0; i < results.size(); ++i) EXPECT_EQ(results[i], i);
+    EXPECT_GT(analytics.inline_tasks, 0);
+    EXPECT_LT(analytics.inline_tasks, 280);
+    // inline, threaded for the long tasks, then inline again
+    EXPECT_GE(analytics.inline_mode_switches, 3);
+}
+
+INSTANTIATE_TEST_SUITE_P(SinkOnSendingThread, InlineExecutionTest, ::testing::Bool());
+
+TEST(AutonomicInlineExecutionTest, givenTasksGrowing_whenAutonomicFarmInline_thenBackToTheWorkers) {
+    auto sender = std::this_thread::get_id();
+    // a byte per item: the workers and the sending thread write them at once
+    std::vector<char> computed_inline(200, 0);
+    AutonomicFarm<size_t, size_t> farm(1, 1, 4, 0, [&](size_t &item) {
+        computed_inline[item] = std::this_thread::get_id() == sender;
+        if (item >= 100) busy_wait(std::chrono::microseconds(2000));
+        return item;
+    }, [](size_t &) {});
+    farm.setInlineExecution(true, false);
+    farm.run();
+    send_slowly(farm, 200);
+    auto analytics = farm.wait_and_analytics();
+
+    EXPECT_GT(std::count(computed_inline.begin(), computed_inline.begin() + 100, 1), 50);
+    // the first long task tells that the tasks grew, the following ones go to the workers
+    EXPECT_EQ(std::count(computed_inline.begin() + 101, computed_inline.end(), 1), 0);
+    EXPECT_EQ(analytics.inline_tasks, (size_t) std::count(computed_inline.begin(), computed_inline.end(), 1));
+}
@@ -0,0 +1,66 @@
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include "MappedFileSource.hpp"
+#include "Farm.hpp"
+#include <gtest/gtest.h>
+
+/**
+ * Two files of records, the first one of newline records and the second one of 4-byte records.
+ */
+class MappedFileSourceTest : public ::testing::Test {
+protected:
+    std::string lines_path = ::testing::TempDir() + "mapped_lines.txt";
+    std::string fixed_path = ::testing::TempDir() + "mapped_fixed.bin";
+    std::string lines;
+
+    void SetUp() override {
+        for (int i = 0; i < 200; ++i) lines += "record " + std::to_string(i) + "\n";
+        std::ofstream(lines_path) << lines;
+        std::ofstream(fixed_path) << std::string(4 * 25, 'x');
+    }
+
+    void TearDown() override {
+        std::remove(lines_path.c_str());
+        std::remove(fixed_path.c_str());
+    }
+};
+
+TEST_F(MappedFileSourceTest, givenNewlineRecords_whenSplitting_thenChunksEndAtANewlineAndCoverTheFile) {
+    MappedFileSource source({ lines_path }, record_format::newline, 64);
+    std::string joined;
+    while (auto chunk = source.next()) {
+        EXPECT_EQ(chunk->view().back(), '\n');
+        EXPECT_EQ(chunk->offset, joined.size());
+        joined += chunk->view();
+    }
+    EXPECT_EQ(joined, lines);
+}
+
+TEST_F(MappedFileSourceTest, givenFixedRecords_whenSplitting_thenChunksHoldWholeRecords) {
+    MappedFileSource source({ fixed_path }, record_format::fixed, 10, 4);
+    size_t total = 0;
+    while (auto chunk = source.next()) {
+        EXPECT_EQ(chunk->size % 4, 0);
+        EXPECT_EQ(chunk->file, 0);
+        total += chunk->size;
+    }
+    EXPECT_EQ(total, 100);
+}
+
+TEST_F(MappedFileSourceTest, givenFarm_whenSendingChunks_thenWorkersReadEveryRecordFromTheMapping) {
+    MappedFileSource source({ lines_path, fixed_path }, record_format::newline, 100);
+    std::atomic<size_t> records = 0;
+    Farm<file_chunk, size_t> farm(2, [](file_chunk &chunk) {
+        return (size_t) std::count(chunk.data, chunk.data + chunk.size, '\n');
+    }, [&records](size_t &count) { records += count; });
+    farm.run();
+    EXPECT_GT(source.sendTo(farm), 2);
+    farm.notify_eos();
+    farm.wait();
+    EXPECT_EQ(records, 200);
+}
+
+TEST(MappedFileSourceErrorTest, givenMissingFile_whenMapping_thenRuntimeError) {
+    EXPECT_THROW(MappedFileSource({ "/nonexistent/file" }, record_format::newline, 64), std::runtime_error);
+}
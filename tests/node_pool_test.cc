@@ -0,0 +1,151 @@
+#include <future>
+#include <map>
+#include <condition_variable>
+#include "NodePool.hpp"
+#include "ThreadedNode.hpp"
+#include <gtest/gtest.h>
+
+/**
+ * Pool of nodes recording the thread computing each item. The item 0 blocks its node until released.
+ */
+class NodePoolTest : public ::testing::Test {
+protected:
+    static constexpr size_t num_nodes = 3;
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::mutex mutex;
+    std::condition_variable computed_cv;
+    std::map<size_t, std::thread::id> computed_by;
+
+    NodePool<size_t, ThreadedNode<size_t>> pool = NodePool<size_t, ThreadedNode<size_t>>(num_nodes, [this](size_t& item) {
+        {
+            std::lock_guard lock(mutex);
+            computed_by[item] = std::this_thread::get_id();
+        }
+        computed_cv.notify_all();
+        if (item == 0) released.wait();
+    });
+
+    void waitComputed(size_t item) {
+        std::unique_lock lock(mutex);
+        computed_cv.wait(lock, [this, item]() { return computed_by.count(item) > 0; });
+    }
+
+    /**
+     * Wait for the nodes to process every item but the blocking one, so that the node of the blocking item is the only
+     * one loaded.
+     */
+    void waitOnlyBlockingItem() {
+        for (size_t pending = num_nodes; pending > 1; std::this_thread::yield()) {
+            pending = 0;
+            for (auto &node: pool.getNodes()) pending += node.pending();
+        }
+    }
+
+    void TearDown() override {
+        release.set_value();
+        pool.notify_eos();
+        pool.wait();
+    }
+};
+
+TEST_F(NodePoolTest, givenOnDemandPolicy_whenANodeIsFull_thenSkipsIt) {
+    pool.setDispatchPolicy(dispatch_policy::on_demand, 2);
+    pool.run();
+    // the node of the blocking item gets a second item in turn, then it is full
+    for (size_t item = 0; item <= num_nodes; ++item) pool.send(item);
+    waitComputed(0);
+
+    for (size_t item = num_nodes + 1; item <= 3 * num_nodes; ++item) {
+        pool.send(item);
+        waitComputed(item);
+        EXPECT_NE(computed_by[item], computed_by[0]);
+    }
+}
+
+TEST_F(NodePoolTest, givenJoinShortestQueuePolicy_whenANodeIsBusy_thenAvoidsIt) {
+    pool.setDispatchPolicy(dispatch_policy::join_shortest_queue);
+    pool.run();
+    size_t first = 0;
+    pool.send(first);
+    waitComputed(first);
+    // round-robin would send one every three items to the busy node
+    for (size_t item = 1; item <= 2 * num_nodes; ++item) {
+        pool.send(item);
+        waitComputed(item);
+        EXPECT_NE(computed_by[item], computed_by[first]);
+    }
+}
+
+TEST_F(NodePoolTest, givenPowerOfTwoChoicesPolicy_whenANodeIsBusy_thenAvoidsIt) {
+    pool.setDispatchPolicy(dispatch_policy::power_of_two_choices);
+    pool.run();
+    size_t first = 0;
+    pool.send(first);
+    waitComputed(first);
+    for (size_t item = 1; item <= 10 * num_nodes; ++item) {
+        pool.send(item);
+        waitComputed(item);
+        waitOnlyBlockingItem();
+        EXPECT_NE(computed_by[item], computed_by[first]);
+    }
+}
+
+TEST_F(NodePoolTest, givenShortestExpectedDelayPolicy_whenANodeIsBusy_thenAvoidsIt) {
+    pool.setDispatchPolicy(dispatch_policy::shortest_expected_delay);
+    pool.run();
+    size_t first = 0;
+    pool.send(first);
+    waitComputed(first);
+    // the busy node was never observed, so its speed is guessed from the others
+    for (size_t item = 1; item <= 2 * num_nodes; ++item) {
+        pool.send(item);
+        waitComputed(item);
+        waitOnlyBlockingItem();
+        EXPECT_NE(computed_by[item], computed_by[first]);
+    }
+}
+
+/**
+ * Pool whose choices are looked at without running its nodes.
+ */
+class IdleNodePool : public NodePool<size_t, ThreadedNode<size_t>> {
+public:
+    explicit IdleNodePool(size_t num_nodes) : NodePool(num_nodes, [](size_t&) {}) {}
+
+    using NodePool::nextNode;
+    using NodePool::speeds;
+};
+
+TEST(NodePoolSpeedsTest, givenShortestExpectedDelayPolicy_whenNodesNotObserved_thenAsFastAsTheMeanOfTheOthers) {
+    IdleNodePool pool(3);
+    pool.setDispatchPolicy(dispatch_policy::shortest_expected_delay);
+    // nothing observed, the nodes are equally fast and chosen in turn
+    EXPECT_EQ(pool.nextNode(), 0);
+    EXPECT_EQ(pool.nextNode(), 1);
+
+    // the node not observed is guessed as fast as 3 ms, the mean of the others
+    pool.speeds.observe(0, 4);
+    pool.speeds.observe(1, 2);
+    EXPECT_EQ(pool.nextNode(), 1);
+    size_t item = 0;
+    pool.getNodes()[1].send(item);
+    EXPECT_EQ(pool.nextNode(), 2);
+    pool.getNodes()[2].send(item);
+    EXPECT_EQ(pool.nextNode(), 0);
+}
+
+TEST_F(NodePoolTest, givenOnDemandPolicy_whenEveryNodeIsFull_thenWaitsForACompletion) {
+    pool.setDispatchPolicy(dispatch_policy::on_demand, 1);
+    pool.run();
+    size_t first = 0;
+    pool.send(first);
+    waitComputed(first);
+    // the other nodes are filled faster than they compute, so the items wait for them to complete one
+    for (size_t item = 1; item <= 100; ++item) pool.send(item);
+    for (size_t item = 1; item <= 100; ++item) {
+        waitComputed(item);
+        EXPECT_NE(computed_by[item], computed_by[first]);
+    }
+}
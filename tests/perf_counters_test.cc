@@ -0,0 +1,72 @@
+#include "PerfCounters.hpp"
+#include <gtest/gtest.h>
+#include <ctime>
+
+static perf_window window(long time, uint64_t cycles, uint64_t task_clock_ns) {
+    perf_window result;
+    result.time = time;
+    result.workers = 1;
+    result.cycles = cycles;
+    result.instructions = 2 * cycles;
+    result.task_clock_ns = task_clock_ns;
+    return result;
+}
+
+TEST(PerfCountersTest, givenWindowsOfTwoWorkers_whenMerge_thenSameWindowsSummedAndSortedFromTheStart) {
+    long start_ms = 1000000;
+    std::vector<perf_window> farm;
+    PerfCounters::merge(farm, { window(start_ms - 50, 1, 10), window(start_ms + 100, 2, 20) }, start_ms);
+    PerfCounters::merge(farm, { window(start_ms, 4, 40), window(start_ms + 50, 8, 80), window(start_ms + 100, 16, 160) },
+                        start_ms);
+
+    ASSERT_EQ(farm.size(), 3);
+    // the window beginning before the farm counts from its start
+    EXPECT_EQ(farm[0].time, 0);
+    EXPECT_EQ(farm[0].workers, 2);
+    EXPECT_EQ(farm[0].cycles, 5);
+    EXPECT_EQ(farm[0].instructions, 10);
+    EXPECT_EQ(farm[0].task_clock_ns, 50);
+    EXPECT_EQ(farm[1].time, 50);
+    EXPECT_EQ(farm[1].workers, 1);
+    EXPECT_EQ(farm[1].cycles, 8);
+    EXPECT_EQ(farm[2].time, 100);
+    EXPECT_EQ(farm[2].workers, 2);
+    EXPECT_EQ(farm[2].cycles, 18);
+    EXPECT_EQ(farm[2].task_clock_ns, 180);
+}
+
+class PerfCountersSourceTest : public ::testing::TestWithParam<perf_source> {};
+
+TEST_P(PerfCountersSourceTest, givenBestSource_whenTaskComputed_thenCpuTimeCountedFromThatSourceOrAWeakerOne) {
+    PerfCounters counters(1000);
+    auto source = counters.open(GetParam());
+    // the sources are ordered from the best one, and getrusage is always available
+    EXPECT_NE(source, perf_source::none);
+    EXPECT_GE(source, GetParam());
+    EXPECT_EQ(counters.source(), source);
+
+    counters.begin();
+    // spin for 20 ms of CPU time, however long the thread waits to be scheduled
+    timespec start{}, now{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    do {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000000L + (now.tv_nsec - start.tv_nsec) < 20000000L);
+    counters.end();
+
+    ASSERT_FALSE(counters.windows().empty());
+    uint64_t task_clock_ns = 0, cycles = 0;
+    for (auto &measured: counters.windows()) {
+        task_clock_ns += measured.task_clock_ns;
+        cycles += measured.cycles;
+    }
+    EXPECT_GT(task_clock_ns, 5000000);
+    if (source == perf_source::hardware) {
+        EXPECT_GT(cycles, 0);
+    } else {
+        EXPECT_EQ(cycles, 0);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(EverySource, PerfCountersSourceTest,
+                         ::testing::Values(perf_source::hardware, perf_source::software, perf_source::rusage));
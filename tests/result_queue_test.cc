@@ -0,0 +1,110 @@
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "AutonomicFarm.hpp"
+#include <gtest/gtest.h>
+
+TEST(ResultQueueTest, givenPulledResults_whenFarmEnds_thenConsumerTakesEveryResult) {
+    Farm<int, int> farm(2, [](int &item) { return item * 2; }, [](int &) { FAIL() << "the sink is replaced by the queue"; });
+    farm.setResultsCapacity(4);
+    farm.run();
+
+    std::vector<int> results;
+    std::thread consumer([&farm, &results]() {
+        for (auto &res: farm.results()) results.push_back(res);
+    });
+    for (int i = 0; i < 100; ++i) farm.send(i);
+    farm.notify_eos();
+    farm.wait();
+    consumer.join();
+
+    ASSERT_EQ(results.size(), 100);
+    std::sort(results.begin(), results.end());
+    for (int i = 0; i < 100; ++i) EXPECT_EQ(results[i], i * 2);
+    EXPECT_TRUE(farm.results().done());
+}
+
+TEST(ResultQueueTest, givenSlowConsumer_whenQueueIsFull_thenConsumerTimeIsCountedApart) {
+    MonitoredFarm<int, int> farm(2, [](int &item) { return item; }, [](int &) {});
+    farm.setResultsCapacity(1);
+    farm.run();
+
+    std::thread consumer([&farm]() {
+        while (auto res = farm.results().pop()) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    });
+    for (int i = 0; i < 20; ++i) farm.send(i);
+    farm.notify_eos();
+    auto analytics = farm.wait_and_analytics();
+    consumer.join();
+
+    EXPECT_GT(analytics.consumer_blocked_ms, 10);
+}
+
+/**
+ * Gatherer on a virtual clock, taking the given time to output each result, as if held by a consumer.
+ */
+class HeldGatherer : public MonitoringGatherer<int> {
+public:
+    std::chrono::system_clock::time_point now;
+    std::chrono::milliseconds output_time;
+
+    HeldGatherer(farm_analytics *analytics, std::chrono::milliseconds output_time)
+    : MonitoringGatherer<int>([this](int &) { now += this->output_time; }, analytics), now(analytics->farm_start_time),
+      output_time(output_time) {}
+
+    /**
+     * Gather the given results, one produced every period.
+     */
+    void gather(int results, std::chrono::milliseconds period) {
+        for (int i = 0; i < results; ++i) {
+            now += period;
+            onValue(i);
+        }
+    }
+
+protected:
+    std::chrono::system_clock::time_point currentTime() override {
+        return now;
+    }
+};
+
+TEST(ResultQueueTest, givenSlowConsumer_whenMeasuringProduction_thenTimeHeldByTheConsumerIsLeftOut) {
+    farm_analytics analytics, held_analytics, measured_analytics;
+    HeldGatherer fast(&analytics, std::chrono::milliseconds(0));
+    HeldGatherer held(&held_analytics, std::chrono::milliseconds(100));
+    HeldGatherer measured(&measured_analytics, std::chrono::milliseconds(100));
+    measured.measureProduction();
+    fast.gather(50, std::chrono::milliseconds(2));
+    held.gather(50, std::chrono::milliseconds(2));
+    measured.gather(50, std::chrono::milliseconds(2));
+
+    ASSERT_FALSE(analytics.service_time.empty());
+    EXPECT_NEAR(analytics.service_time.back().first, 2, 0.01);
+    // measured when gathered, the farm looks as slow as the consumer
+    ASSERT_FALSE(held_analytics.service_time.empty());
+    EXPECT_NEAR(held_analytics.service_time.back().first, 102, 0.01);
+    EXPECT_EQ(measured_analytics.service_time, analytics.service_time);
+}
+
+TEST(ResultQueueTest, givenSlowConsumer_whenResultsArePulled_thenResultsWaitingForTheGathererAreBounded) {
+    std::atomic<size_t> computed = 0;
+    Farm<int, int> farm(2, [&computed](int &item) {
+        computed++;
+        return item;
+    }, [](int &) {});
+    farm.setResultsCapacity(2);
+    farm.run();
+    for (int i = 0; i < 100; ++i) farm.send(i);
+    farm.notify_eos();
+
+    // two results in the queue, two waiting for the gatherer, one being output and one held by each worker
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_LE(computed, 7);
+    size_t pulled = 0;
+    std::thread consumer([&farm, &pulled]() {
+        for (auto &res: farm.results()) pulled++;
+    });
+    farm.wait();
+    consumer.join();
+    EXPECT_EQ(pulled, 100);
+}
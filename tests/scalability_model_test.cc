@@ -0,0 +1,41 @@
+#include "ScalabilityModel.hpp"
+#include <gtest/gtest.h>
+
+TEST(ScalabilityModelTest, givenSingleObservation_whenPredict_thenLinearScaling) {
+    ScalabilityModel model(8);
+    model.observe(2, 16);
+    EXPECT_DOUBLE_EQ(model.throughput(2), 0.125);
+    EXPECT_DOUBLE_EQ(model.throughput(4), 0.25);
+    EXPECT_DOUBLE_EQ(model.throughput(1), 0.0625);
+    EXPECT_FALSE(model.isReady());
+}
+
+TEST(ScalabilityModelTest, givenLinearCurve_whenTargetReachable_thenSmallestNumberOfWorkers) {
+    ScalabilityModel model(16);
+    model.observe(2, 16);
+    model.observe(4, 16);
+    EXPECT_TRUE(model.isReady());
+    EXPECT_EQ(model.workersFor(1.0 / 3, 1, 16), 6);
+    EXPECT_EQ(model.knee(), 16);
+}
+
+TEST(ScalabilityModelTest, givenSaturatedCurve_whenTargetUnreachable_thenKnee) {
+    // the service time of a worker grows with the workers, so that the throughput stops growing after 4 workers
+    ScalabilityModel model(16);
+    model.observe(1, 10);
+    model.observe(2, 10);
+    model.observe(4, 12.5);
+    model.observe(8, 25);
+    EXPECT_DOUBLE_EQ(model.throughput(12), model.throughput(8));
+    EXPECT_EQ(model.knee(), 4);
+    EXPECT_EQ(model.workersFor(1.0, 1, 16), 4);
+    EXPECT_EQ(model.workersFor(0.15, 1, 16), 2);
+}
+
+TEST(ScalabilityModelTest, givenNegativeScaling_whenTargetUnreachable_thenFewerWorkers) {
+    ScalabilityModel model(8);
+    model.observe(2, 10);
+    model.observe(4, 10);
+    model.observe(8, 40);
+    EXPECT_EQ(model.workersFor(1.0, 1, 8), 4);
+}
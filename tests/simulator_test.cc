@@ -0,0 +1,40 @@
+#include "simulation/FarmSimulator.hpp"
+#include <gtest/gtest.h>
+
+static std::vector<trace_item> constant_trace(size_t size, double arrival_ms, double service_ms) {
+    std::vector<trace_item> trace;
+    for (size_t i = 0; i < size; ++i) {
+        trace.push_back({ std::chrono::nanoseconds((long long) (i * arrival_ms * 1e6)), service_ms });
+    }
+    return trace;
+}
+
+TEST(FarmSimulatorTest, givenTrace_whenRun_thenEveryItemIsGathered) {
+    FarmSimulator<> simulator(2, 1, 4, 0);
+    auto analytics = simulator.run(constant_trace(200, 5, 8));
+    EXPECT_EQ(analytics.arrival_time.size(), 200);
+    EXPECT_FALSE(analytics.service_time.empty());
+    EXPECT_EQ(analytics.num_workers.front().first, 2);
+}
+
+TEST(FarmSimulatorTest, givenTooFewWorkers_whenRun_thenWorkersAreAdded) {
+    FarmSimulator<> simulator(1, 1, 8, 4);
+    auto analytics = simulator.run(constant_trace(2000, 4, 16));
+    EXPECT_GT(analytics.num_workers.size(), 1);
+    EXPECT_GE(analytics.num_workers.back().first, 3);
+}
+
+TEST(FarmSimulatorTest, givenTooManyWorkers_whenRun_thenWorkersAreRemoved) {
+    FarmSimulator<> simulator(8, 1, 8, 0);
+    auto analytics = simulator.run(constant_trace(2000, 8, 16));
+    EXPECT_GT(analytics.num_workers.size(), 1);
+    EXPECT_LT(analytics.num_workers.back().first, 8);
+}
+
+TEST(FarmSimulatorTest, givenSameTrace_whenRunTwice_thenSameDecisions) {
+    auto trace = constant_trace(1000, 4, 16);
+    FarmSimulator<> first(2, 1, 8, 0), second(2, 1, 8, 0);
+    auto first_analytics = first.run(trace);
+    auto second_analytics = second.run(trace);
+    EXPECT_EQ(first_analytics.num_workers, second_analytics.num_workers);
+}
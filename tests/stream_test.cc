@@ -52,4 +52,28 @@ TEST(StreamTest, givenEOS_whenAdd_thenReturnsFalse) {
     intstream.eos();
     EXPECT_FALSE(intstream.add(myval));
     EXPECT_FALSE(intstream.next().has_value());
-}
\ No newline at end of file
+}
+
+TEST(StreamTest, givenSpillEnabled_whenAddingBeyondMemory_thenElementsComeBackInOrderWithTheirTags) {
+    Stream<size_t> stream;
+    stream.enableTags();
+    // segments of 512 bytes hold a dozen elements, with their arrival time, tag and priority, so that many segments are
+    // created and deleted
+    stream.enableSpill(8, ::testing::TempDir(), 512);
+    for (size_t i = 0; i < 1000; ++i) EXPECT_TRUE(stream.add(i, (uint32_t) i + 1));
+    EXPECT_EQ(stream.spilled(), 992);
+    stream.eos();
+
+    std::chrono::steady_clock::time_point added;
+    uint32_t tag = 0;
+    for (size_t i = 0; i < 1000; ++i) {
+        auto next = stream.next(&added, &tag);
+        ASSERT_TRUE(next.has_value());
+        EXPECT_EQ(next.value(), i);
+        EXPECT_EQ(tag, i + 1);
+    }
+    EXPECT_FALSE(stream.next().has_value());
+    EXPECT_EQ(stream.spilled(), 0);
+    EXPECT_EQ(stream.spillStats().max_backlog, 992);
+    EXPECT_GT(stream.spillStats().segments, 1);
+}
@@ -0,0 +1,121 @@
+#include <thread>
+#include <vector>
+#include "AutonomicFarm.hpp"
+#include <gtest/gtest.h>
+
+TEST(TaskPriorityTest, givenBulkBeforeInteractive_whenNext_thenInteractiveComesFirst) {
+    Stream<int> stream;
+    stream.enablePriorities(1000);
+    for (int i = 0; i < 3; ++i) stream.add(i, 0, task_priority{ 1 });
+    int interactive = 10;
+    stream.add(interactive, 0, task_priority{ 0 });
+    stream.eos();
+
+    std::chrono::steady_clock::time_point added;
+    uint32_t priority_class = 7;
+    EXPECT_EQ(stream.next(&added, nullptr, &priority_class).value(), 10);
+    EXPECT_EQ(priority_class, 0);
+    for (int i = 0; i < 3; ++i) EXPECT_EQ(stream.next().value(), i);
+}
+
+TEST(TaskPriorityTest, givenBulkOlderThanAging_whenInteractiveArrives_thenBulkComesFirst) {
+    Stream<int> stream;
+    stream.enablePriorities(10);
+    int bulk = 1, interactive = 0;
+    stream.add(bulk, 0, task_priority{ 1 });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    stream.add(interactive, 0, task_priority{ 0 });
+
+    EXPECT_EQ(stream.next().value(), 1);
+    EXPECT_EQ(stream.next().value(), 0);
+}
+
+TEST(TaskPriorityTest, givenDeadlines_whenNext_thenEarliestDeadlineComesFirst) {
+    Stream<int> stream;
+    stream.enablePriorities(1000);
+    for (int deadline: { 30, 10, 20 }) stream.add(deadline, 0, task_priority{ 1, (double) deadline });
+
+    EXPECT_EQ(stream.next().value(), 10);
+    EXPECT_EQ(stream.next().value(), 20);
+    EXPECT_EQ(stream.next().value(), 30);
+}
+
+TEST(TaskPriorityTest, givenPrioritizedFarm_whenBulkBurstArrives_thenInteractiveLatencyStaysLow) {
+    AutonomicFarm<int, int> farm(1, 1, 1, 0, [](int &item) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        return item;
+    }, [](int &) {});
+    farm.setPriorities([](const int &item) { return task_priority{ item < 0 ? 0u:1u }; }, 10000);
+    farm.run();
+
+    for (int i = 0; i < 20; ++i) farm.send(i);
+    for (int i = 1; i <= 2; ++i) {
+        int interactive = -i;
+        farm.send(interactive);
+    }
+    farm.notify_eos();
+    auto analytics = farm.wait_and_analytics();
+
+    ASSERT_EQ(analytics.latency_by_class.size(), 2);
+    EXPECT_EQ(analytics.latency_by_class[0].tasks(), 2);
+    EXPECT_EQ(analytics.latency_by_class[1].tasks(), 20);
+    // the interactive tasks wait at most for the bulk task being computed, not for the whole burst
+    EXPECT_LT(analytics.latency_by_class[0].percentile(100), analytics.latency_by_class[1].percentile(50));
+}
+
+TEST(TaskPriorityTest, givenDropOldest_whenQueueIsFull_thenTheElementDueLastIsDropped) {
+    Stream<int> stream;
+    stream.enablePriorities(1000);
+    std::vector<int> dropped;
+    stream.enableAdmission(AdmissionControl(shed_policy::drop_oldest, 3), [&dropped](int &value, uint32_t) { dropped.push_back(value); });
+    int classes[] = { 1, 1, 0, 1 };
+    for (int i = 0; i < 4; ++i) stream.add(i, 0, task_priority{ (uint32_t) classes[i] });
+    stream.eos();
+
+    // the urgent element is kept, the bulk one due last makes room
+    EXPECT_EQ(dropped, std::vector<int>{ 1 });
+    EXPECT_EQ(stream.next().value(), 2);
+    EXPECT_EQ(stream.next().value(), 0);
+    EXPECT_EQ(stream.next().value(), 3);
+}
+
+TEST(TaskPriorityTest, givenSpilledBacklog_whenUrgentElementArrives_thenItStaysInMemoryAndComesFirst) {
+    Stream<size_t> stream;
+    stream.enablePriorities(1000);
+    stream.enableSpill(2, ::testing::TempDir());
+    for (size_t i = 0; i < 10; ++i) stream.add(i, 0, task_priority{ 1 });
+    EXPECT_EQ(stream.spilled(), 8);
+    size_t urgent = 100;
+    stream.add(urgent, 0, task_priority{ 0 });
+    EXPECT_EQ(stream.spilled(), 8);
+    stream.eos();
+
+    EXPECT_EQ(stream.next().value(), 100);
+    for (size_t i = 0; i < 10; ++i) EXPECT_EQ(stream.next().value(), i);
+}
+
+TEST(TaskPriorityTest, givenLatenciesOfTwoWorkers_whenMerged_thenPercentilesWithinTheBucketPrecision) {
+    class_latency first, second, empty;
+    EXPECT_EQ(empty.percentile(50), 0);
+    EXPECT_EQ(empty.mean(), 0);
+    // a latency every 10 microseconds up to 10 seconds, split among the workers
+    for (int i = 1; i <= 1000000; ++i) (i % 2 ? first:second).add(i / 100.0);
+    first.merge(second);
+    first.merge(empty);
+
+    EXPECT_EQ(first.tasks(), 1000000);
+    EXPECT_NEAR(first.mean(), 5000.005, 1e-6);
+    EXPECT_DOUBLE_EQ(first.percentile(100), 10000);
+    for (double p: { 0.01, 1.0, 50.0, 95.0, 99.0, 99.9 }) {
+        double exact = p / 100 * 10000;
+        EXPECT_GE(first.percentile(p), exact) << p;
+        EXPECT_LE(first.percentile(p), exact * (1 + 1.0 / 32)) << p;
+    }
+
+    // the latencies too long for the buckets are still counted
+    class_latency longest;
+    longest.add(1e12);
+    longest.add(1);
+    EXPECT_NEAR(longest.percentile(50), 1, 1.0 / 32);
+    EXPECT_DOUBLE_EQ(longest.percentile(100), 1e12);
+}
@@ -0,0 +1,28 @@
+#include "WorkerSpeeds.hpp"
+#include <gtest/gtest.h>
+
+TEST(WorkerSpeedsTest, givenWorkersOfDifferentSpeeds_whenCombine_thenHarmonicMean) {
+    WorkerSpeeds speeds(4);
+    speeds.observe(0, 4);
+    speeds.observe(1, 12);
+    // two workers completing 1/4 + 1/12 = 1/3 tasks per millisecond, as two workers of 6 milliseconds each
+    EXPECT_DOUBLE_EQ(speeds.combinedServiceTime(2), 6);
+    // the paused workers don't count
+    speeds.observe(2, 1);
+    EXPECT_DOUBLE_EQ(speeds.combinedServiceTime(2), 6);
+    EXPECT_LT(WorkerSpeeds(4).combinedServiceTime(4), 0);
+}
+
+TEST(WorkerSpeedsTest, givenObservedWorkers_whenReorder_thenSlowestRunningLastAndFastestPausedFirst) {
+    WorkerSpeeds speeds(5);
+    speeds.observe(0, 9);
+    speeds.observe(1, 3);
+    speeds.observe(2, 6);
+    speeds.observe(3, 8);
+    speeds.observe(4, 2);
+    speeds.reorder(3);
+    // running: 1 (3ms), 2 (6ms), 0 (9ms). Paused: 4 (2ms), 3 (8ms)
+    std::vector<size_t> order;
+    for (size_t position = 0; position < speeds.size(); ++position) order.push_back(speeds.at(position));
+    EXPECT_EQ(order, std::vector<size_t>({ 1, 2, 0, 4, 3 }));
+}
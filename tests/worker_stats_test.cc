@@ -0,0 +1,52 @@
+#include "MonitoredFarm.hpp"
+#include "WorkerStats.hpp"
+#include <gtest/gtest.h>
+#include <thread>
+
+static_assert(alignof(worker_stats) == 64 && sizeof(worker_stats) % 64 == 0, "a slot fills whole cache lines");
+
+TEST(WorkerStatsTest, givenBusyIdleAndPausedTime_whenUtilization_thenPausedTimeExcluded) {
+    worker_stats stats;
+    EXPECT_DOUBLE_EQ(stats.utilization(), 0);
+    stats.busy_ns = 300;
+    stats.idle_ns = 100;
+    stats.paused_ns = 10000;
+    EXPECT_DOUBLE_EQ(stats.utilization(), 0.75);
+}
+
+TEST(WorkerStatsTest, givenLaps_whenLap_thenCounterSumsTheIntervals) {
+    long counter = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto middle = worker_stats::lap(counter, start);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    auto end = worker_stats::lap(counter, middle);
+    EXPECT_EQ(counter, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    EXPECT_GE(counter, 2000000);
+}
+
+TEST(WorkerStatsTest, givenBurstOfTasks_whenFarmEnds_thenEachWorkerCountsItsTasksAndTimes) {
+    MonitoredFarm<int, int> farm(2, [](int &item) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return item;
+    }, [](int &) {});
+    farm.run();
+    for (int i = 0; i < 100; ++i) farm.send(i);
+    farm.notify_eos();
+    auto analytics = farm.wait_and_analytics();
+
+    ASSERT_EQ(analytics.workers.size(), 2);
+    size_t tasks = 0;
+    long busy_ns = 0;
+    for (auto &worker: analytics.workers) {
+        tasks += worker.tasks;
+        busy_ns += worker.busy_ns;
+        EXPECT_GT(worker.tasks, 0);
+        EXPECT_GT(worker.utilization(), 0.5);
+        EXPECT_LE(worker.utilization(), 1);
+        EXPECT_EQ(worker.paused_ns, 0);
+        // the burst waits in the queues: the last tasks wait for the ones before them
+        EXPECT_GT(worker.queue_wait_ns, (long) worker.tasks * 1000000);
+    }
+    EXPECT_EQ(tasks, 100);
+    EXPECT_GE(busy_ns, 100 * 1000000L);
+}